@@ -0,0 +1,291 @@
+#include "stdafx.h"
+
+#include "txbase/math/transform.h"
+#include "txbase/image/film.h"
+#include "txbase/scene/camera.h"
+
+#include "Core/Scene.h"
+#include "Core/RendererConfig.h"
+#include "Core/RenderQueue.h"
+#include "Core/ImageWriter.h"
+#include "Core/MeshBlob.h"
+#include "Core/ParallelObjLoader.h"
+#include "Scenes/Scenes.h"
+#include "Network/RenderService.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace TX;
+
+namespace {
+	typedef chrono::steady_clock Clock;
+
+	/// <summary>
+	/// Camera placement, the one of the scene if not custom.
+	/// </summary>
+	struct View {
+		bool custom = false;
+		int scene_view = 0;		// camera of the scene description
+		Vec3 position;
+		Vec3 rotation;		// euler angles in degrees
+	};
+
+	struct Options {
+		RendererConfig config;
+		string scene = "teapots";
+		string output = "render";
+		string convert_in, convert_out;
+		int serve_port = 0;
+		vector<View> views;
+		int frames = 1;
+		float exposure = 1.f;
+		bool quiet = false;
+	};
+
+	void PrintUsage() {
+		fprintf(stderr,
+			"Usage: RenderCLI [options]\n"
+			"  --scene <name>          scene to render, teapots or a .scene file\n"
+			"  --output <name>         base name of the images, <name>.hdr & <name>.png\n"
+			"  --size <w> <h>          image size\n"
+			"  --spp <n>               samples per pixel\n"
+			"  --depth <n>             maximum path depth\n"
+			"  --method <m>            integrator: path, wavefront, direct or restir\n"
+			"  --ris-candidates <n>    light samples resampled per shading point by restir\n"
+			"  --ris-reuse <n>         neighboring pixels whose samples restir reuses, 0 for none\n"
+			"  --no-shading-sort       wavefront shades the hits in path order instead of grouped by BSDF\n"
+			"  --sampler <s>           sample generator: random, sobol, halton or bluenoise\n"
+			"  --dispatch <d>          render loop: static (specialized on the method) or dynamic\n"
+			"  --tile <n>              tile size\n"
+			"  --seed <n>              seed of the first frame\n"
+			"  --frames <n>            frames to render per camera, each with the next seed\n"
+			"  --camera <x y z rx ry rz>  adds a camera at the position & euler angles in degrees\n"
+			"  --exposure <f>          exposure of the png\n"
+			"  --shared-film <name>    publishes every pass to a shared memory segment, suffixed like the images if there are several\n"
+			"  --shared-raw            publishes the raw accumulation instead of the resolved colors\n"
+			"  --quiet                 no progress output\n"
+			"  --convert <obj> <mesh>  writes the shapes of an obj file as a binary mesh & exits\n"
+			"  --serve <port>          renders the requests of a local HTTP service instead, the options are the defaults of the jobs\n"
+			"                          except --shared-film, given per job by the shared parameter\n");
+	}
+
+	bool ParseArgs(int argc, char *argv[], Options& opt) {
+		RendererConfig& config = opt.config;
+		for (int i = 1; i < argc; i++) {
+			string arg = argv[i];
+			auto has = [&](int n) { return i + n < argc; };
+			if (arg == "--scene" && has(1)) opt.scene = argv[++i];
+			else if (arg == "--output" && has(1)) opt.output = argv[++i];
+			else if (arg == "--size" && has(2)) {
+				config.width = atoi(argv[++i]);
+				config.height = atoi(argv[++i]);
+			}
+			else if (arg == "--spp" && has(1)) config.samples_per_pixel = atoi(argv[++i]);
+			else if (arg == "--depth" && has(1)) config.tracer_maxdepth = atoi(argv[++i]);
+			else if (arg == "--method" && has(1)) {
+				string method = argv[++i];
+				if (method == "path") config.tracer_t = RenderMethod::PathTracing;
+				else if (method == "wavefront") config.tracer_t = RenderMethod::WavefrontPathTracing;
+				else if (method == "direct") config.tracer_t = RenderMethod::DirectLighting;
+				else if (method == "restir") config.tracer_t = RenderMethod::ResampledDirectLighting;
+				else return false;
+			}
+			else if (arg == "--ris-candidates" && has(1)) config.ris_candidates = atoi(argv[++i]);
+			else if (arg == "--ris-reuse" && has(1)) config.ris_neighbors = atoi(argv[++i]);
+			else if (arg == "--no-shading-sort") config.sort_shading = false;
+			else if (arg == "--sampler" && has(1)) {
+				string sampler = argv[++i];
+				if (sampler == "random") config.sampler_t = SamplerType::Random;
+				else if (sampler == "sobol") config.sampler_t = SamplerType::Sobol;
+				else if (sampler == "halton") config.sampler_t = SamplerType::Halton;
+				else if (sampler == "bluenoise") config.sampler_t = SamplerType::BlueNoise;
+				else return false;
+			}
+			else if (arg == "--dispatch" && has(1)) {
+				string dispatch = argv[++i];
+				if (dispatch == "static") config.static_dispatch = true;
+				else if (dispatch == "dynamic") config.static_dispatch = false;
+				else return false;
+			}
+			else if (arg == "--tile" && has(1)) config.tile_size = atoi(argv[++i]);
+			else if (arg == "--seed" && has(1)) config.seed = strtoull(argv[++i], nullptr, 10);
+			else if (arg == "--frames" && has(1)) opt.frames = atoi(argv[++i]);
+			else if (arg == "--camera" && has(6)) {
+				View view;
+				view.custom = true;
+				for (int k = 0; k < 3; k++) view.position[k] = float(atof(argv[++i]));
+				for (int k = 0; k < 3; k++) view.rotation[k] = float(atof(argv[++i]));
+				opt.views.push_back(view);
+			}
+			else if (arg == "--exposure" && has(1)) opt.exposure = float(atof(argv[++i]));
+			else if (arg == "--shared-film" && has(1)) config.shared_film = argv[++i];
+			else if (arg == "--shared-raw") config.shared_film_raw = true;
+			else if (arg == "--quiet") opt.quiet = true;
+			else if (arg == "--serve" && has(1)) opt.serve_port = atoi(argv[++i]);
+			else if (arg == "--convert" && has(2)) {
+				opt.convert_in = argv[++i];
+				opt.convert_out = argv[++i];
+			}
+			else return false;
+		}
+		return config.width > 0 && config.height > 0 && config.samples_per_pixel > 0 &&
+			config.tile_size > 0 && opt.frames > 0 && opt.serve_port >= 0 && opt.serve_port < 65536;
+	}
+
+	float Seconds(Clock::time_point since) {
+		return chrono::duration<float>(Clock::now() - since).count();
+	}
+
+	/// <summary>
+	/// Merges all the shapes of an obj file into one mesh blob.
+	/// </summary>
+	int Convert(const string& in, const string& out) {
+		auto start = Clock::now();
+		Mesh mesh;
+		ParallelObjLoader::Load(in, mesh);
+		if (mesh.vertices.empty() || !MeshBlob::Write(out, mesh)) {
+			fprintf(stderr, "Failed to convert %s\n", in.c_str());
+			return 1;
+		}
+		printf("%s: %d vertices, %d triangles -> %s in %.2fs\n",
+			in.c_str(), int(mesh.vertices.size()), int(mesh.indices.size() / 3), out.c_str(), Seconds(start));
+		return 0;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	Options opt;
+	opt.config.width = 800;
+	opt.config.height = 600;
+	opt.config.samples_per_pixel = 100;
+	opt.config.tracer_maxdepth = 12;
+	if (!ParseArgs(argc, argv, opt)) {
+		PrintUsage();
+		return 1;
+	}
+	RendererConfig& config = opt.config;
+
+	try {
+		if (!opt.convert_in.empty())
+			return Convert(opt.convert_in, opt.convert_out);
+
+		// the scene is built once for all the cameras & frames
+		auto start = Clock::now();
+		Camera camera(config.width, config.height);
+		vector<Transform> sceneViews;
+		shared_ptr<Scene> scene = Scenes::Load(opt.scene, camera, &sceneViews);
+		if (!scene) {
+			fprintf(stderr, "Unknown scene: %s\n", opt.scene.c_str());
+			return 1;
+		}
+		printf("Scene '%s' built in %.2fs\n", opt.scene.c_str(), Seconds(start));
+		const Scene::ConstructTimings& timings = scene->Timings();
+		printf("  construct %.2fs: transform %.2fs, gather %.2fs, light samplers %.2fs (cpu), accelerator %.2fs, light bvh %.2fs\n",
+			timings.total, timings.transform, timings.gather, timings.samplers, timings.build, timings.lights);
+		if (sceneViews.empty())
+			sceneViews.push_back(camera.transform);
+		// without custom cameras every camera of the scene is rendered
+		if (opt.views.empty()) {
+			for (size_t v = 0; v < sceneViews.size(); v++) {
+				View view;
+				view.scene_view = int(v);
+				opt.views.push_back(view);
+			}
+		}
+
+		if (opt.serve_port > 0) {
+			RenderQueue queue(*scene);
+			Net::RenderService service(queue, config, sceneViews);
+			printf("Serving on http://127.0.0.1:%d with %d threads\n", opt.serve_port, queue.ThreadCount());
+			fflush(stdout);
+			if (!service.Run(uint16_t(opt.serve_port))) {
+				fprintf(stderr, "Cannot listen on port %d\n", opt.serve_port);
+				return 1;
+			}
+			return 0;
+		}
+
+		// every camera & frame is a job of the same queue, so the workers move on to the next one
+		// while the last tiles of a pass are being rendered
+		RenderQueue queue(*scene);
+		struct Output {
+			string name;
+			unique_ptr<Film> film;
+			shared_ptr<RenderJob> job;
+			bool written = false;
+		};
+		vector<Output> outputs;
+		const uint64_t firstSeed = config.seed;
+		const string sharedFilm = config.shared_film;
+		const bool multiple = opt.views.size() > 1 || opt.frames > 1;
+		for (size_t v = 0; v < opt.views.size(); v++) {
+			const View& view = opt.views[v];
+			Transform transform = sceneViews[view.scene_view];
+			if (view.custom) {
+				transform.SetPosition(view.position);
+				transform.SetRotation(Quaternion::Euler(
+					view.rotation.x * Math::PI / 180.f,
+					view.rotation.y * Math::PI / 180.f,
+					view.rotation.z * Math::PI / 180.f));
+			}
+			for (int f = 0; f < opt.frames; f++) {
+				config.seed = firstSeed + f;
+				Output out;
+				out.name = opt.output;
+				config.shared_film = sharedFilm;
+				if (multiple) {
+					out.name += "_" + to_string(v) + "_" + to_string(f);
+					if (!sharedFilm.empty())
+						config.shared_film += "_" + to_string(v) + "_" + to_string(f);
+				}
+				out.film = make_unique<Film>(FilterType::GaussianFilter);
+				out.job = queue.Submit(transform, config, *out.film);
+				outputs.push_back(move(out));
+			}
+		}
+		printf("Rendering %d image(s) of %dx%d at %d spp on %d threads\n",
+			int(outputs.size()), config.width, config.height, config.samples_per_pixel, queue.ThreadCount());
+
+		auto renderStart = Clock::now();
+		size_t remaining = outputs.size();
+		while (remaining > 0) {
+			this_thread::sleep_for(chrono::milliseconds(500));
+			float progress = 0.f;
+			for (auto& out : outputs) {
+				progress += out.job->Progress();
+				if (out.written || !out.job->Done())
+					continue;
+				Film& film = *out.film;
+				bool written = ImageWriter::WriteHDR(out.name + ".hdr", film.Pixels(), film.Width(), film.Height()) &&
+					ImageWriter::WritePNG(out.name + ".png", film.Pixels(), film.Width(), film.Height(), opt.exposure);
+				out.written = true;
+				remaining--;
+				printf("\rJob %d done after %.2fs -> %s%s\n",
+					int(out.job->Id()), Seconds(renderStart), out.name.c_str(), written ? "" : " (failed to write)");
+			}
+			if (!opt.quiet && remaining > 0) {
+				progress /= outputs.size();
+				float elapsed = Seconds(renderStart);
+				printf("\r  %5.1f%% | ETA %.0fs   ", progress * 100.f, progress > 0.f ? elapsed * (1.f - progress) / progress : 0.f);
+				fflush(stdout);
+			}
+		}
+		float seconds = Seconds(renderStart);
+		double samples = double(outputs.size()) * config.width * config.height * config.samples_per_pixel;
+		printf("Total: %.2fs, %.2f Msamples/s\n", seconds, samples / seconds * 1e-6);
+	}
+	catch (char const *ex) {
+		fprintf(stderr, "Error: %s\n", ex);
+		return 1;
+	}
+	catch (const std::exception& ex) {
+		fprintf(stderr, "Error: %s\n", ex.what());
+		return 1;
+	}
+	return 0;
+}
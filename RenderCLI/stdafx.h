@@ -0,0 +1,25 @@
+#pragma once
+// Same as the renderer's precompiled header without any OpenGL or window headers
+#pragma warning(disable: 4800)
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <utility>
+
+#include "txbase/sys/memory.h"
+#include "txbase/sys/thread.h"
+#include "txbase/sys/tools.h"
+
+#include "txbase/math/color.h"
+#include "txbase/image/image.h"
+#include "txbase/image/filter.h"
+
+#include "txbase/math/base.h"
+#include "txbase/math/bbox.h"
+#include "txbase/math/matrix.h"
+#include "txbase/math/random.h"
+#include "txbase/math/ray.h"
+#include "txbase/math/geometry.h"
+#include "txbase/math/vector.h"
@@ -3,9 +3,13 @@
 #include "Core/Primitive.h"
 #include "txbase/shape/mesh.h"
 #include "txbase/math/bbox.h"
+#include "Core/TaskSystem.h"
 #include <algorithm>
 
 namespace TX {
+	// nodes with less triangles are built by the thread that reached them
+	static const uint ParallelBuildThreshold = 4096;
+
 	static inline bool IntersectBounds(const BBox& bounds, const Ray& ray, const Vec3& invDir, const Vec3u& dirSign) {
 		// check for intersection against x, y slabs
 		float t_min = (bounds[1 - dirSign.x].x - ray.origin.x) * invDir.x;
@@ -127,33 +131,67 @@ namespace TX {
 		return false;
 	}
 
-	void BVH::Build() {
-		RefineGeometry();
-
-		if (buildTris.size() == 0) {
-			root = nullptr;
-			return;
+	void BVH::Prepare() {
+		// Offsets of the primitives in the arrays
+		vertOffsets.resize(prims_->size());
+		triOffsets.resize(prims_->size());
+		uint vertCount = 0;
+		uint triCount = 0;
+		for (uint primId = 0; primId < prims_->size(); primId++) {
+			const Mesh *mesh = (*prims_)[primId]->GetMesh();
+			vertOffsets[primId] = vertCount;
+			triOffsets[primId] = triCount;
+			vertCount += mesh->VertexCount();
+			triCount += mesh->TriangleCount();
 		}
 
-		// Initialize build data - array of bounding boxes
-		std::vector<BuildData> buildData;
-		buildData.reserve(buildTris.size());
-		for (uint id = 0; id < buildTris.size(); id++) {
-			const BuildTri& tri = buildTris[id];
+		// Allocate memory, every primitive writes its own ranges
+		buildVerts.clear();
+		buildTris.clear();
+		buildData.clear();
+		buildVerts.resize(vertCount);
+		buildTris.resize(triCount);
+		buildData.resize(triCount, BuildData(0, BBox()));
+	}
+
+	void BVH::PrimitiveReady(uint primId) {
+		const Mesh *mesh = (*prims_)[primId]->GetMesh();
+		const uint vertOffset = vertOffsets[primId];
+		const uint triOffset = triOffsets[primId];
+		assert(triOffset + mesh->TriangleCount() <= buildTris.size());
+
+		// Vertices
+		std::copy(mesh->vertices.begin(), mesh->vertices.end(), buildVerts.begin() + vertOffset);
+
+		// Triangles & their bounding boxes
+		const uint *indices = mesh->indices.data();
+		for (uint triId = 0, i = 0; triId < mesh->TriangleCount(); i = 3*(++triId)) {
+			const BuildTri tri(
+				vertOffset + indices[i],
+				vertOffset + indices[i + 1],
+				vertOffset + indices[i + 2],
+				primId,
+				triId);
 			BBox bbox(
 				buildVerts[tri.idx0].pos,
 				buildVerts[tri.idx1].pos);
 			bbox = Math::Union(bbox, buildVerts[tri.idx2].pos);
-			buildData.emplace_back(id, bbox);
+			buildTris[triOffset + triId] = tri;
+			buildData[triOffset + triId] = BuildData(triOffset + triId, bbox);
+		}
+	}
+
+	void BVH::Build() {
+		if (buildTris.size() == 0) {
+			root = nullptr;
+			return;
 		}
 
 		// Recursively build BVH tree
-		MemoryArena buildMem;
-		uint nodeCount = 0;
-		std::vector<uint> orderedTris;
-		orderedTris.reserve(buildTris.size());
-		treeSize = 0;
-		BuildNode *buildRoot = RecursiveBuild(buildData, 0, buildTris.size(), buildMem);
+		BuildContext context;
+		BuildNode *buildRoot = RecursiveBuild(context, 0, buildTris.size(), context.NewArena());
+		treeSize = context.nodeCount;
+		primCount = context.tri4Count;
 
 		// Flatten the tree into an array
 		root = AllocAligned<LinearNode>(treeSize, 64);
@@ -163,51 +201,10 @@ namespace TX {
 		FlattenTree(buildRoot, &nodeOffset, &triOffset);
 		assert(nodeOffset == treeSize);
 		assert(triOffset == primCount);
+		std::vector<BuildData>().swap(buildData);
 	}
 
-	void BVH::RefineGeometry() {
-		// Allocate memory
-		buildVerts.clear();
-		buildTris.clear();
-		uint vertCount = 0;
-		uint triCount = 0;
-		for (auto& prim : *prims_) {
-			const Mesh *mesh = static_cast<const Mesh *>(prim->GetMesh());
-			vertCount += mesh->VertexCount();
-			triCount += mesh->TriangleCount();
-		}
-		buildVerts.reserve(vertCount);
-		buildTris.reserve(triCount);
-
-		// Fetch triangles and vertices from primitives
-		vertCount = triCount = 0;
-		for (uint primId = 0; primId < prims_->size(); primId++) {
-			const Mesh *mesh = (*prims_)[primId]->GetMesh();
-
-			// Triangles
-			const uint *indices = mesh->indices.data();
-			for (uint triId = 0, i = 0; triId < mesh->TriangleCount(); i = 3*(++triId)) {
-				buildTris.emplace_back(
-					vertCount + indices[i],
-					vertCount + indices[i + 1],
-					vertCount + indices[i + 2],
-					primId,
-					triId);
-				triCount++;
-			}
-			// Vertices
-			for (auto& vert : mesh->vertices) {
-				buildVerts.push_back(vert);
-			}
-			vertCount += mesh->VertexCount();
-		}
-
-		assert(buildVerts.size() == vertCount);
-		assert(buildTris.size() == triCount);
-	}
-
-
-	BVH::BuildNode* BVH::RecursiveBuild(std::vector<BuildData>& buildData, uint start, uint end, MemoryArena& buildMem) {
+	BVH::BuildNode* BVH::RecursiveBuild(BuildContext& context, uint start, uint end, MemoryArena& buildMem) {
 		struct CompareToMid {
 			int dim;
 			float mid;
@@ -225,7 +222,7 @@ namespace TX {
 		};
 
 		assert(start != end);
-		treeSize++;
+		context.nodeCount++;
 		const uint triCount = end - start;
 		const uint tri4Count = (triCount + 3) / 4;
 		BuildNode *node = buildMem.Alloc<BuildNode>();
@@ -252,7 +249,23 @@ namespace TX {
 				tri4Array[i].Pack(vertices, triangles, count);
 			}
 			node->InitLeaf(tri4Array, tri4Count, bounds);
-			primCount += tri4Count;
+			context.tri4Count += tri4Count;
+		};
+
+		// Both halves of a large node are independent, the first one becomes a task with its own arena
+		auto BuildInterior = [&](int dim, uint mid) {
+			BuildNode *children[2];
+			if (triCount >= ParallelBuildThreshold) {
+				TaskGroup group;
+				group.Run([&] { children[0] = RecursiveBuild(context, start, mid, context.NewArena()); });
+				children[1] = RecursiveBuild(context, mid, end, buildMem);
+				group.Wait();
+			}
+			else {
+				children[0] = RecursiveBuild(context, start, mid, buildMem);
+				children[1] = RecursiveBuild(context, mid, end, buildMem);
+			}
+			node->InitInterior(dim, children[0], children[1]);
 		};
 
 		if (tri4Count == 1) {
@@ -272,17 +285,14 @@ namespace TX {
 			uint mid = (start + end) / 2;
 			// All bounding boxes are concentric
 			if (centroidBounds.max[dim] == centroidBounds.min[dim]) {
-				if (primCount <= MaxTrisPerNode) {
+				if (triCount <= MaxTrisPerNode) {
 					// All the triangles can be stored in one node
 					BuildLeaf();
 					return node;
 				}
 				else {
 					// Need to split it furthur
-					node->InitInterior(
-						dim,
-						RecursiveBuild(buildData, start, mid, buildMem),
-						RecursiveBuild(buildData, mid, end, buildMem));
+					BuildInterior(dim, mid);
 					return node;
 				}
 			}
@@ -311,10 +321,7 @@ namespace TX {
 			case SplitMethod::SAH:
 				break;
 			}
-			node->InitInterior(
-				dim,
-				RecursiveBuild(buildData, start, mid, buildMem),
-				RecursiveBuild(buildData, mid, end, buildMem));
+			BuildInterior(dim, mid);
 			return node;
 		}
 	}
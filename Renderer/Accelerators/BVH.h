@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "Core/PrimitiveManager.h"
 #include "Common.h"
 
@@ -46,6 +49,23 @@ namespace TX {
 			}
 		};
 
+		/// <summary>
+		/// State shared by the tasks building the subtrees.
+		/// </summary>
+		struct BuildContext {
+			std::atomic<uint> nodeCount;
+			std::atomic<uint> tri4Count;
+			std::mutex arenaLock;
+			std::vector<std::unique_ptr<MemoryArena>> arenas;	// one per task, the nodes live until the tree is flattened
+
+			BuildContext() : nodeCount(0), tri4Count(0) {}
+			MemoryArena& NewArena() {
+				std::lock_guard<std::mutex> lock(arenaLock);
+				arenas.push_back(std::unique_ptr<MemoryArena>(new MemoryArena));
+				return *arenas.back();
+			}
+		};
+
 		/// <summary>
 		/// Flattened BVH tree node stored in depth-first order,
 		/// where the first child of an elem is the elem immediately next to it.
@@ -73,6 +93,9 @@ namespace TX {
 		std::vector<BuildVertex>	buildVerts;
 		// Vector of triangles
 		std::vector<BuildTri>		buildTris;
+		std::vector<BuildData>		buildData;
+		std::vector<uint>			vertOffsets;	// where the geometry of each primitive starts in the arrays above
+		std::vector<uint>			triOffsets;
 
 		// Flattened BVH tree
 		LinearNode*					root;
@@ -90,20 +113,25 @@ namespace TX {
 
 		bool Intersect(const Ray& ray, Intersection& isect) const;
 		bool Occlude(const Ray& ray) const;
-	protected:
-		void Build();
-	private:
+
 		/// <summary>
-		/// Fetch mesh info from primitive into buildVerts and buildTris.
+		/// Fetch mesh info of one primitive into buildVerts, buildTris and buildData.
 		/// Assumes the underlying shape of all primitives are meshes.
 		/// </summary>
-		void RefineGeometry();
+		void PrimitiveReady(uint primId);
+		void Build();
+	protected:
+		/// <summary>
+		/// Allocates the build arrays and assigns every primitive its ranges.
+		/// </summary>
+		void Prepare();
+	private:
 
 		/// <summary>
-		/// Build BVH tree.
+		/// Build BVH tree, the subtrees of large nodes are built in parallel.
 		/// </summary>
 		/// <returns> The root </returns>
-		BuildNode* RecursiveBuild(std::vector<BuildData>& buildData, uint start, uint end, MemoryArena& buildMem);
+		BuildNode* RecursiveBuild(BuildContext& context, uint start, uint end, MemoryArena& buildMem);
 
 		/// <summary>
 		/// Convert the BVH tree into a linear array in depth-first order.
@@ -0,0 +1,326 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstdlib>
+#include "txbase/shape/mesh.h"
+
+#include "LightBVH.h"
+#include "Core/Primitive.h"
+
+namespace TX
+{
+	namespace {
+		const int BucketCount = 12;
+		const int MedianSplitDepth = 32;	// below, nodes are split in halves so that the trails fit in 64 bits
+
+		inline float SafeSqrt(float v) { return Math::Sqrt(Math::Max(0.f, v)); }
+		inline float SafeAcos(float v) { return Math::Acos(Math::Clamp(v, -1.f, 1.f)); }
+		// cos & sin of max(0, a - b) given the cos & sin of a and b
+		inline float CosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+			return cosA > cosB ? 1.f : cosA * cosB + sinA * sinB;
+		}
+		inline float SinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+			return cosA > cosB ? 0.f : sinA * cosB - cosA * sinB;
+		}
+		inline float Diagonal(const BBox& b) { return Math::Length(b.max - b.min); }
+		inline float SurfaceArea(const BBox& b) {
+			Vec3 d = b.max - b.min;
+			return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+
+		/// <summary>
+		/// Smallest cone (axis, cos of the half angle) containing the two others.
+		/// </summary>
+		void UnionCones(const Vec3& axisA, float cosA, const Vec3& axisB, float cosB, Vec3 *axis, float *cosTheta) {
+			float thetaA = SafeAcos(cosA), thetaB = SafeAcos(cosB);
+			float thetaD = SafeAcos(Math::Dot(axisA, axisB));
+			// one cone contains the other
+			if (Math::Min(thetaD + thetaB, Math::PI) <= thetaA) { *axis = axisA; *cosTheta = cosA; return; }
+			if (Math::Min(thetaD + thetaA, Math::PI) <= thetaB) { *axis = axisB; *cosTheta = cosB; return; }
+			float thetaO = (thetaA + thetaD + thetaB) / 2.f;
+			Vec3 normal = Math::Cross(axisA, axisB);
+			if (thetaO >= Math::PI || Math::Dot(normal, normal) == 0.f) { *axis = axisA; *cosTheta = -1.f; return; }
+			// rotate axisA towards axisB
+			float thetaR = thetaO - thetaA;
+			normal = Math::Normalize(normal);
+			Vec3 ortho = Math::Cross(normal, axisA);
+			*axis = Math::Normalize(axisA * Math::Cos(thetaR) + ortho * Math::Sin(thetaR));
+			*cosTheta = Math::Cos(thetaO);
+		}
+	}
+
+	float LightBVH::LightBounds::Importance(const Vec3& p, const Vec3& n) const {
+		if (power == 0.f)
+			return 0.f;
+		const Vec3 center = bounds.Centroid();
+		const float radius = Diagonal(bounds) / 2.f;
+		const float dist2 = Math::DistSqr(p, center);
+		const float d2 = Math::Max(dist2, radius);		// no singularity close to the lights
+
+		// angle between the axis and the direction to p
+		const Vec3 wi = dist2 > 0.f ? (center - p) / Math::Sqrt(dist2) : Vec3::ZERO;
+		float cosTheta_w = -Math::Dot(axis, wi);
+		float sinTheta_w = SafeSqrt(1.f - cosTheta_w * cosTheta_w);
+
+		// angle subtended by the bounds seen from p
+		float cosTheta_b, sinTheta_b;
+		if (dist2 < radius * radius) {
+			cosTheta_b = -1.f;
+			sinTheta_b = 0.f;
+		}
+		else {
+			float sin2 = radius * radius / dist2;
+			cosTheta_b = SafeSqrt(1.f - sin2);
+			sinTheta_b = SafeSqrt(sin2);
+		}
+
+		// minimum angle between the normals & the direction to p
+		float sinTheta_o = SafeSqrt(1.f - cosTheta_o * cosTheta_o);
+		float cosTheta_x = CosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+		float sinTheta_x = SinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+		float cosThetap = CosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+		if (cosThetap <= cosTheta_e)
+			return 0.f;
+		float importance = power * cosThetap / d2;
+
+		// minimum angle of incidence at p
+		if (n != Vec3::ZERO) {
+			float cosTheta_i = Math::AbsDot(wi, n);
+			float sinTheta_i = SafeSqrt(1.f - cosTheta_i * cosTheta_i);
+			importance *= CosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+		}
+		return Math::Max(importance, 0.f);
+	}
+
+	LightBVH::LightBounds LightBVH::LightBounds::Union(const LightBounds& a, const LightBounds& b) {
+		if (a.power == 0.f) return b;
+		if (b.power == 0.f) return a;
+		LightBounds u;
+		u.bounds = Math::Union(a.bounds, b.bounds);
+		UnionCones(a.axis, a.cosTheta_o, b.axis, b.cosTheta_o, &u.axis, &u.cosTheta_o);
+		u.cosTheta_e = Math::Min(a.cosTheta_e, b.cosTheta_e);
+		u.power = a.power + b.power;
+		return u;
+	}
+
+	LightBVH::LightBounds LightBVH::Bounds(const Light& light) {
+		LightBounds lb;
+		const Vec4 pos = light.Position();
+		const float luminance = light.Intensity().Luminance();
+		const AreaLight *area = dynamic_cast<const AreaLight *>(&light);
+		if (area) {
+			// one sided lambertian emitters, the cone bounds the normals of the mesh
+			const Mesh *mesh = area->primitive->GetMesh();
+			lb.bounds = mesh->Bounds();
+			float surface = 0.f;
+			for (uint i = 0; i + 2 < mesh->indices.size(); i += 3) {
+				const Vec3& a = mesh->vertices[mesh->indices[i]];
+				const Vec3& b = mesh->vertices[mesh->indices[i + 1]];
+				const Vec3& c = mesh->vertices[mesh->indices[i + 2]];
+				surface += 0.5f * Math::Length(Math::Cross(b - a, c - a));
+			}
+			lb.power = luminance * surface * Math::PI;
+			lb.cosTheta_e = 0.f;
+			if (mesh->normals.size() == mesh->vertices.size() && !mesh->normals.empty()) {
+				Vec3 sum;
+				for (auto& normal : mesh->normals) sum += normal;
+				if (Math::Length(sum) > 1e-4f) {
+					lb.axis = Math::Normalize(sum);
+					lb.cosTheta_o = 1.f;
+					for (auto& normal : mesh->normals)
+						lb.cosTheta_o = Math::Min(lb.cosTheta_o, Math::Dot(lb.axis, Math::Normalize(normal)));
+				}
+				else {
+					lb.axis = Vec3(0.f, 0.f, 1.f);
+					lb.cosTheta_o = -1.f;
+				}
+			}
+			else {
+				lb.axis = Vec3(0.f, 0.f, 1.f);
+				lb.cosTheta_o = -1.f;
+			}
+		}
+		else {
+			// point lights emit in all directions
+			Vec3 p(pos.x, pos.y, pos.z);
+			lb.bounds = BBox(p, p);
+			lb.axis = Vec3(0.f, 0.f, 1.f);
+			lb.cosTheta_o = -1.f;
+			lb.cosTheta_e = 0.f;
+			lb.power = 4.f * Math::PI * luminance;
+		}
+		return lb;
+	}
+
+	void LightBVH::Build(const std::vector<std::shared_ptr<Light>>& lights) {
+		bounded_.clear();
+		infinite_.clear();
+		nodes_.clear();
+		trails_.clear();
+
+		std::vector<BuildLight> buildLights;
+		for (auto& light : lights) {
+			if (light->Position().w == 0.f) {
+				infinite_.push_back(light.get());
+				continue;
+			}
+			LightBounds lb = Bounds(*light);
+			if (lb.power <= 0.f)
+				continue;		// never picked
+			buildLights.push_back(BuildLight{ uint(bounded_.size()), lb, lb.bounds.Centroid() });
+			bounded_.push_back(light.get());
+		}
+		if (!buildLights.empty())
+			RecursiveBuild(buildLights, 0, uint(buildLights.size()), 0, 0);
+	}
+
+	float LightBVH::Cost(const LightBounds& b, const BBox& parent, int dim) {
+		// orientation & surface area heuristic
+		float theta_o = SafeAcos(b.cosTheta_o), theta_e = SafeAcos(b.cosTheta_e);
+		float theta_w = Math::Min(theta_o + theta_e, Math::PI);
+		float sinTheta_o = SafeSqrt(1.f - b.cosTheta_o * b.cosTheta_o);
+		float M_omega = 2.f * Math::PI * (1.f - b.cosTheta_o) +
+			Math::PI / 2.f * (2.f * theta_w * sinTheta_o - Math::Cos(theta_o - 2.f * theta_w) - 2.f * theta_o * sinTheta_o + b.cosTheta_o);
+		// long & thin regions are penalized
+		Vec3 d = parent.max - parent.min;
+		float maxExtent = Math::Max(d.x, Math::Max(d.y, d.z));
+		float Kr = d[dim] > 0.f ? maxExtent / d[dim] : 1.f;
+		return b.power * M_omega * Kr * SurfaceArea(b.bounds);
+	}
+
+	uint LightBVH::RecursiveBuild(std::vector<BuildLight>& buildLights, uint start, uint end, uint64_t trail, int depth) {
+		const uint nodeIndex = uint(nodes_.size());
+		nodes_.emplace_back();
+		if (end - start == 1) {
+			const BuildLight& light = buildLights[start];
+			nodes_[nodeIndex].bounds = light.bounds;
+			nodes_[nodeIndex].index = light.light;
+			nodes_[nodeIndex].leaf = true;
+			trails_[bounded_[light.light]] = trail;
+			return nodeIndex;
+		}
+
+		LightBounds bounds;
+		BBox centroidBounds(buildLights[start].centroid, buildLights[start].centroid);
+		for (uint i = start; i < end; i++) {
+			bounds = LightBounds::Union(bounds, buildLights[i].bounds);
+			centroidBounds = Math::Union(centroidBounds, buildLights[i].centroid);
+		}
+
+		// cheapest bucket boundary over the three axes
+		float minCost = Math::INF;
+		int minDim = -1, minBucket = -1;
+		for (int dim = 0; dim < 3; dim++) {
+			const float lo = centroidBounds.min[dim], hi = centroidBounds.max[dim];
+			if (hi == lo) continue;
+			LightBounds buckets[BucketCount];
+			for (uint i = start; i < end; i++) {
+				int b = Math::Min(BucketCount - 1, int(BucketCount * (buildLights[i].centroid[dim] - lo) / (hi - lo)));
+				buckets[b] = LightBounds::Union(buckets[b], buildLights[i].bounds);
+			}
+			for (int split = 0; split < BucketCount - 1; split++) {
+				LightBounds below, above;
+				for (int b = 0; b <= split; b++) below = LightBounds::Union(below, buckets[b]);
+				for (int b = split + 1; b < BucketCount; b++) above = LightBounds::Union(above, buckets[b]);
+				float cost = Cost(below, bounds.bounds, dim) + Cost(above, bounds.bounds, dim);
+				// ties (e.g. between point lights, which have no area) go to the most balanced split
+				bool better = cost < minCost || (cost == minCost && std::abs(split - BucketCount / 2) < std::abs(minBucket - BucketCount / 2));
+				if (below.power > 0.f && above.power > 0.f && better) {
+					minCost = cost;
+					minDim = dim;
+					minBucket = split;
+				}
+			}
+		}
+
+		uint mid;
+		if (minDim == -1 || depth >= MedianSplitDepth) {
+			// all centroids at the same place, split in halves
+			mid = (start + end) / 2;
+		}
+		else {
+			const float lo = centroidBounds.min[minDim], hi = centroidBounds.max[minDim];
+			auto midPtr = std::partition(&buildLights[start], &buildLights[end - 1] + 1, [=](const BuildLight& l) {
+				int b = Math::Min(BucketCount - 1, int(BucketCount * (l.centroid[minDim] - lo) / (hi - lo)));
+				return b <= minBucket;
+			});
+			mid = uint(midPtr - &buildLights[0]);
+			if (mid == start || mid == end) mid = (start + end) / 2;
+		}
+		RecursiveBuild(buildLights, start, mid, trail, depth + 1);
+		uint second = RecursiveBuild(buildLights, mid, end, trail | (uint64_t(1) << depth), depth + 1);
+		nodes_[nodeIndex].bounds = bounds;
+		nodes_[nodeIndex].index = second;
+		nodes_[nodeIndex].leaf = false;
+		return nodeIndex;
+	}
+
+	const Light* LightBVH::Sample(const Vec3& p, const Vec3& n, float u, float *pmf, float *remapped) const {
+		const float OneMinusEpsilon = 0.99999994f;
+		*pmf = 0.f;
+		// lights without position are picked uniformly, the tree counts as one of them
+		const float pInfinite = nodes_.empty() ? 1.f : float(infinite_.size()) / float(infinite_.size() + 1);
+		if (u < pInfinite) {
+			if (infinite_.empty()) return nullptr;
+			u = u / pInfinite * infinite_.size();
+			size_t index = Math::Min(size_t(u), infinite_.size() - 1);
+			*pmf = pInfinite / infinite_.size();
+			if (remapped) *remapped = Math::Min(u - index, OneMinusEpsilon);
+			return infinite_[index];
+		}
+		u = Math::Min((u - pInfinite) / (1.f - pInfinite), OneMinusEpsilon);
+
+		float nodePmf = 1.f - pInfinite;
+		uint index = 0;
+		if (nodes_[0].bounds.Importance(p, n) == 0.f)
+			return nullptr;
+		while (!nodes_[index].leaf) {
+			const float ci[2] = {
+				nodes_[index + 1].bounds.Importance(p, n),
+				nodes_[nodes_[index].index].bounds.Importance(p, n) };
+			if (ci[0] == 0.f && ci[1] == 0.f)
+				return nullptr;
+			const float p0 = ci[0] / (ci[0] + ci[1]);
+			if (u < p0) {
+				nodePmf *= p0;
+				u = Math::Min(u / p0, OneMinusEpsilon);
+				index = index + 1;
+			}
+			else {
+				nodePmf *= ci[1] / (ci[0] + ci[1]);		// same as Pmf(), rather than 1 - p0
+				u = Math::Min((u - p0) / (1.f - p0), OneMinusEpsilon);
+				index = nodes_[index].index;
+			}
+		}
+		*pmf = nodePmf;
+		if (remapped) *remapped = u;
+		return bounded_[nodes_[index].index];
+	}
+
+	float LightBVH::Pmf(const Vec3& p, const Vec3& n, const Light *light) const {
+		const float pInfinite = nodes_.empty() ? 1.f : float(infinite_.size()) / float(infinite_.size() + 1);
+		auto trail = trails_.find(light);
+		if (trail == trails_.end()) {
+			// a light without position, or one that is never picked
+			bool infinite = std::find(infinite_.begin(), infinite_.end(), light) != infinite_.end();
+			return infinite ? pInfinite / infinite_.size() : 0.f;
+		}
+
+		float pmf = 1.f - pInfinite;
+		uint64_t bits = trail->second;
+		uint index = 0;
+		if (nodes_[0].bounds.Importance(p, n) == 0.f)
+			return 0.f;
+		while (!nodes_[index].leaf) {
+			const float ci[2] = {
+				nodes_[index + 1].bounds.Importance(p, n),
+				nodes_[nodes_[index].index].bounds.Importance(p, n) };
+			const int child = int(bits & 1);
+			if (ci[child] == 0.f)
+				return 0.f;
+			pmf *= ci[child] / (ci[0] + ci[1]);
+			index = child ? nodes_[index].index : index + 1;
+			bits >>= 1;
+		}
+		return pmf;
+	}
+}
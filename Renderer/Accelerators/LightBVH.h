@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "txbase/math/bbox.h"
+#include "Core/Light.h"
+
+namespace TX
+{
+	/// <summary>
+	/// Hierarchy over the lights of a scene for picking the light to sample at a shading point,
+	/// in time logarithmic in the number of lights.
+	/// Every node bounds the position, the emitting directions and the power of the lights below it,
+	/// the traversal goes down to one light choosing the children in proportion to their importance.
+	/// Lights without position (directional lights) are kept aside &amp; picked uniformly.
+	/// </summary>
+	class LightBVH {
+	public:
+		/// <summary>
+		/// Bounds of one or several lights.
+		/// </summary>
+		struct LightBounds {
+			BBox bounds;
+			Vec3 axis;				// center of the cone of the surface normals
+			float cosTheta_o;		// spread of the normals around the axis, -1 for all directions
+			float cosTheta_e;		// spread of the emission around each normal
+			float power;
+
+			LightBounds() : cosTheta_o(1.f), cosTheta_e(1.f), power(0.f) {}
+			/// <summary>
+			/// Upper bound of the contribution to a point with the given normal.
+			/// </summary>
+			float Importance(const Vec3& p, const Vec3& n) const;
+			static LightBounds Union(const LightBounds& a, const LightBounds& b);
+		};
+
+		LightBVH() {}
+		void Build(const std::vector<std::shared_ptr<Light>>& lights);
+
+		/// <summary>
+		/// Picks a light for the point p with normal n.
+		/// </summary>
+		/// <param name="u"> Uniform sample in [0, 1) </param>
+		/// <param name="pmf"> Probability of picking the returned light </param>
+		/// <param name="remapped"> If not null, receives u rescaled to [0, 1) again, uncorrelated with the choice </param>
+		/// <returns> The light, null if no light can reach the point </returns>
+		const Light* Sample(const Vec3& p, const Vec3& n, float u, float *pmf, float *remapped = nullptr) const;
+		/// <summary>
+		/// Probability of Sample() picking the given light at p with normal n.
+		/// </summary>
+		float Pmf(const Vec3& p, const Vec3& n, const Light *light) const;
+
+		inline size_t Size() const { return bounded_.size() + infinite_.size(); }
+		static LightBounds Bounds(const Light& light);
+	private:
+		struct Node {
+			LightBounds bounds;
+			uint index;		// second child of an interior node (the first one is next), light of a leaf
+			bool leaf;
+		};
+		struct BuildLight {
+			uint light;
+			LightBounds bounds;
+			Vec3 centroid;
+		};
+
+		/// <summary>
+		/// Builds the subtree over lights [start, end) of buildLights, splitting where the
+		/// orientation &amp; surface area heuristic is the lowest.
+		/// </summary>
+		/// <param name="trail"> Path from the root, bit i set when the second child is taken at depth i </param>
+		/// <returns> Index of the node </returns>
+		uint RecursiveBuild(std::vector<BuildLight>& buildLights, uint start, uint end, uint64_t trail, int depth);
+		static float Cost(const LightBounds& bounds, const BBox& parent, int dim);
+	private:
+		std::vector<const Light*> bounded_;
+		std::vector<const Light*> infinite_;
+		std::vector<Node> nodes_;
+		std::unordered_map<const Light*, uint64_t> trails_;		// path to the leaf of every bounded light
+	};
+}
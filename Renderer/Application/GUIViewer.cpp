@@ -7,6 +7,7 @@
 #include "GUIViewer.h"
 #include "Core/Scene.h"
 #include "Core/Intersection.h"
+#include "Core/ImageWriter.h"
 
 namespace TX {
 	namespace UI {
@@ -27,6 +28,7 @@ namespace TX {
 
 			// Renderer
 			renderer_ = std::make_unique<Renderer>(rendererConfig, scene_, camera_, film_, monitor_.get());
+			cameraCtrl_ = std::make_unique<CameraController>(camera_.transform);
 		}
 
 		void GUIViewer::Start() {
@@ -40,14 +42,16 @@ namespace TX {
 #pragma	region GUI settings
 			font_.LoadDefault();
 			GUI::Init(font_);
-			windowMain_ = Rect(0.f, 0.f, 200.f, 180.f);
+			windowMain_ = Rect(0.f, 0.f, 200.f, 200.f);
 #pragma endregion
 		}
 
 		bool GUIViewer::Render() {
 			if (input.windowChanged) {
+				// a running render restarts itself at the new size
 				renderer_->Resize(input.windowSize.x, input.windowSize.y);
-				ActionPreview();
+				if (state_.mode != ViewMode::Rendered || !renderer_->Running())
+					ActionPreview();
 			}
 
 			switch (state_.mode) {
@@ -62,6 +66,7 @@ namespace TX {
 				break;
 			}
 			case ViewMode::Rendered:
+				renderer_->Resolve();
 				glDrawPixels(config.windowSize.x, config.windowSize.y, GL_RGBA, GL_FLOAT, (float *)film_.Pixels());
 				break;
 			}
@@ -92,12 +97,23 @@ namespace TX {
 					}
 					break;
 				}
+				case MouseButton::RIGHT:
+				{
+					// render the area under the cursor first
+					if (state_.mode == ViewMode::Rendered && renderer_->Running()) {
+						int x = int(cursor.x), y = int(cursor.y), r = rendererConfig_.tile_size;
+						renderer_->Prioritize(RenderRegion(x - r, y - r, x + r, y + r));
+					}
+					break;
+				}
 				}
 			}
 			if (input(KeyState::DOWN) || input(KeyState::HOLD)) {
 				switch (input.key) {
 				case KeyCode::ESCAPE:
 					Exit(); break;
+				default:
+					MoveCamera(input.key); break;
 				}
 			}
 
@@ -149,9 +165,14 @@ namespace TX {
 				if (!rendering) {
 					GUI::IntSlider("SPP", rendererConfig_.samples_per_pixel, 5, 8000);
 					GUI::IntSlider("Max Depth", rendererConfig_.tracer_maxdepth, 4, 32, 4);
+					GUI::IntSlider("Tile Size", rendererConfig_.tile_size, 8, 256, 8);
 					if (GUI::Button("Render")) {
 						ActionRender();
 					}
+					if (state_.mode == ViewMode::Rendered && GUI::Button("Save")) {
+						ImageWriter::WriteHDR("render.hdr", film_.Pixels(), film_.Width(), film_.Height());
+						ImageWriter::WritePNG("render.png", film_.Pixels(), film_.Width(), film_.Height());
+					}
 				}
 				GUI::EndWindow();
 			}
@@ -173,6 +194,30 @@ namespace TX {
 			this->Refresh();
 		}
 
+		void GUIViewer::MoveCamera(KeyCode key) {
+			Vec2 horizontal; float roll = 0; float vertical = 0;
+			switch (key) {
+			case KeyCode::W: horizontal.y = +1; break;
+			case KeyCode::S: horizontal.y = -1; break;
+			case KeyCode::A: horizontal.x = -1; break;
+			case KeyCode::D: horizontal.x = +1; break;
+			case KeyCode::Q: roll = -1; break;
+			case KeyCode::E: roll = +1; break;
+			case KeyCode::SPACE: vertical = +1; break;
+			case KeyCode::LEFT_SHIFT: vertical = -1; break;
+			default: return;
+			}
+			float delta = GetDeltaTime();
+			cameraCtrl_->HorizontalMove(delta, horizontal * CAM_MOV_SPEED);
+			cameraCtrl_->Roll(delta, roll * CAM_ROLL_SPEED);
+			cameraCtrl_->VerticalMove(delta, vertical * CAM_MOV_SPEED);
+			camera_.transform.UpdateMatrix();
+			if (state_.mode == ViewMode::Rendered) {
+				// the workers stay alive, restarting only cancels the current epoch
+				renderer_->NewTask();
+			}
+		}
+
 		void GUIViewer::FlipY(float *y) { *y = film_.Height() - *y - 1; }
 		void GUIViewer::FlipX(float *x) { *x = film_.Width() - *x - 1; }
 	}
@@ -3,6 +3,7 @@
 #include <future>
 #include <atomic>
 #include "txbase/opengl/application.h"
+#include "txbase/scene/camera_controller.h"
 
 #include "Core/Renderer.h"
 #include "Application/ObjViewer.h"
@@ -28,6 +29,7 @@ namespace TX {
 			void OnGUI();
 			void ActionRender();
 			void ActionPreview();
+			void MoveCamera(KeyCode key);
 			void FlipY(float *y);
 			void FlipX(float *x);
 		private:
@@ -38,6 +40,9 @@ namespace TX {
 			RendererConfig& rendererConfig_;
 			std::unique_ptr<ObjViewer> previewer_;
 			std::unique_ptr<IProgressMonitor> monitor_;
+			std::unique_ptr<CameraController> cameraCtrl_;
+			const float CAM_ROLL_SPEED = 1.f;
+			const float CAM_MOV_SPEED = 2.f;
 
 			// GUI
 			FontMap font_;
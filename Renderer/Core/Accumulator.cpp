@@ -0,0 +1,43 @@
+#include "stdafx.h"
+#include <emmintrin.h>
+
+#include "Accumulator.h"
+
+namespace TX {
+	Accumulator::~Accumulator() {
+		FreeAligned(pixels_);
+	}
+
+	void Accumulator::Resize(int width, int height) {
+		if (width == width_ && height == height_) return;
+		FreeAligned(pixels_);
+		width_ = width;
+		height_ = height;
+		pixels_ = width * height > 0 ? AllocAligned<Pixel>(width * height, 64) : nullptr;
+		Clear();
+	}
+
+	void Accumulator::Clear() {
+		if (pixels_)
+			std::memset(pixels_, 0, sizeof(Pixel) * width_ * height_);
+	}
+
+	void Accumulator::Resolve(Color *out, int ybegin, int yend) const {
+		static_assert(sizeof(Pixel) == 4 * sizeof(float), "pixel must fit in one SSE register");
+		static_assert(sizeof(Color) == 4 * sizeof(float), "color is expected to be rgba floats");
+
+		const __m128 zero = _mm_setzero_ps();
+		const float *src = reinterpret_cast<const float *>(pixels_ + ybegin * width_);
+		const float *end = reinterpret_cast<const float *>(pixels_ + yend * width_);
+		float *dst = reinterpret_cast<float *>(out + ybegin * width_);
+		for (; src < end; src += 4, dst += 4) {
+			// (r, g, b, w) / (w, w, w, w), which also leaves the alpha channel at 1
+			__m128 sum = _mm_load_ps(src);
+			__m128 weight = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 valid = _mm_cmpgt_ps(weight, zero);
+			__m128 color = _mm_div_ps(sum, weight);
+			__m128 prev = _mm_loadu_ps(dst);
+			_mm_storeu_ps(dst, _mm_or_ps(_mm_and_ps(valid, color), _mm_andnot_ps(valid, prev)));
+		}
+	}
+}
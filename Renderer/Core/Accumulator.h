@@ -0,0 +1,49 @@
+#pragma once
+
+#include "txbase/math/color.h"
+
+namespace TX {
+	/// <summary>
+	/// Running sums of a progressive render: weighted radiance and filter weight of every pixel.
+	/// Normalization is deferred to Resolve(), so committing samples never touches the whole image.
+	/// </summary>
+	class Accumulator {
+	public:
+		/// <summary>
+		/// Raw value of a pixel, weighted radiance in (r, g, b) and the sum of weights in w.
+		/// </summary>
+		struct Pixel {
+			float r, g, b, w;
+		};
+	public:
+		Accumulator() : width_(0), height_(0), pixels_(nullptr) {}
+		~Accumulator();
+
+		void Resize(int width, int height);
+		void Clear();
+
+		inline void Commit(int x, int y, const Color& c, float weight = 1.f) {
+			assert(0 <= x && x < width_ && 0 <= y && y < height_);
+			Pixel& p = pixels_[y * width_ + x];
+			p.r += c.r * weight;
+			p.g += c.g * weight;
+			p.b += c.b * weight;
+			p.w += weight;
+		}
+
+		/// <summary>
+		/// Writes the normalized color of rows [ybegin, yend) to the image.
+		/// Pixels that haven't received any sample are left untouched.
+		/// </summary>
+		/// <param name="out"> Image of the same size as the accumulator </param>
+		void Resolve(Color *out, int ybegin, int yend) const;
+
+		inline int Width() const { return width_; }
+		inline int Height() const { return height_; }
+		inline Pixel* Pixels() { return pixels_; }
+		inline const Pixel* Pixels() const { return pixels_; }
+	private:
+		int width_, height_;
+		Pixel *pixels_;
+	};
+}
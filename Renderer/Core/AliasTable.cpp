@@ -0,0 +1,40 @@
+#include "stdafx.h"
+#include "AliasTable.h"
+
+namespace TX {
+	AliasTable::AliasTable(const std::vector<float>& weights) {
+		const uint n = uint(weights.size());
+		if (n == 0)
+			throw "alias table without entries";
+		double sum = 0.0;
+		for (float w : weights) sum += w;
+		if (!(sum > 0.0))
+			throw "alias table without positive weight";
+
+		// split the entries in those below & above the average, then fill every
+		// bucket of an entry below the average with the rest of an entry above it
+		buckets_.resize(n);
+		std::vector<double> scaled(n);
+		std::vector<uint> small, large;
+		for (uint i = 0; i < n; i++) {
+			buckets_[i].pmf = float(weights[i] / sum);
+			buckets_[i].alias = i;
+			scaled[i] = weights[i] / sum * n;
+			(scaled[i] < 1.0 ? small : large).push_back(i);
+		}
+		while (!small.empty() && !large.empty()) {
+			uint s = small.back(), l = large.back();
+			small.pop_back();
+			buckets_[s].keep = float(scaled[s]);
+			buckets_[s].alias = l;
+			scaled[l] -= 1.0 - scaled[s];
+			if (scaled[l] < 1.0) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		// what is left is 1 up to rounding errors
+		for (uint i : small) buckets_[i].keep = 1.f;
+		for (uint i : large) buckets_[i].keep = 1.f;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "txbase/math/base.h"
+
+namespace TX {
+	/// <summary>
+	/// Discrete distribution sampled in constant time (Walker's alias method):
+	/// every bucket holds one entry with the probability of keeping it and the entry taken otherwise.
+	/// </summary>
+	class AliasTable {
+	public:
+		AliasTable() {}
+		/// <summary>
+		/// Builds the table for entries chosen in proportion to their weights, all weights must be >= 0.
+		/// </summary>
+		explicit AliasTable(const std::vector<float>& weights);
+
+		/// <param name="u"> Uniform sample in [0, 1) </param>
+		/// <param name="pmf"> If not null, receives the probability of the returned entry </param>
+		/// <returns> Index of the entry </returns>
+		inline uint Sample(float u, float *pmf = nullptr) const {
+			const uint n = uint(buckets_.size());
+			float scaled = u * n;
+			uint i = Math::Min(uint(scaled), n - 1);
+			const Bucket& bucket = buckets_[i];
+			if (scaled - i >= bucket.keep)
+				i = bucket.alias;
+			if (pmf) *pmf = buckets_[i].pmf;
+			return i;
+		}
+		inline float Pmf(uint i) const { return buckets_[i].pmf; }
+		inline uint Size() const { return uint(buckets_.size()); }
+		inline bool Empty() const { return buckets_.empty(); }
+	private:
+		struct Bucket {
+			float keep;		// probability of keeping this entry, the alias is taken otherwise
+			float pmf;		// probability of this entry in the distribution
+			uint alias;
+		};
+		std::vector<Bucket> buckets_;
+	};
+}
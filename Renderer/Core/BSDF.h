@@ -1,4 +1,5 @@
 #pragma once
+#include <utility>
 #include "txbase/math/color.h"
 #include "txbase/math/vector.h"
 #include "txbase/math/sample.h"
@@ -17,22 +18,78 @@ namespace TX{
 		BSDF_ALL				= BSDF_ALL_REFLECTION | BSDF_ALL_TRANSMISSION
 	};
 
+	namespace LocalCoord {
+		inline float CosTheta(const Vec3& vec) { return vec.z; }
+		inline float CosTheta2(const Vec3& vec) { return vec.z * vec.z; }
+		inline float AbsCosTheta(const Vec3& vec) { return Math::Abs(vec.z); }
+		inline float SinTheta2(const Vec3& vec) { return Math::Max(0.f, 1.f - CosTheta2(vec)); }
+		inline float SinTheta(const Vec3& vec) { return Math::Sqrt(SinTheta2(vec)); }
+		inline float TanTheta(const Vec3& vec)
+		{
+			return Math::Sqrt(SinTheta2(vec)) / vec.z;
+		}
+		inline float TanTheta2(const Vec3& vec)
+		{
+			float cos2 = vec.z * vec.z;
+			float sin2 = 1 - cos2;
+			if (sin2 <= 0.f)
+				return 0.f;
+			return sin2 / cos2;
+		}
+		inline float CosPhi(const Vec3& vec)
+		{
+			float sintheta = SinTheta(vec);
+			if (sintheta == 0.f) return 1.f;
+			return Math::Clamp(vec.x / sintheta, -1.f, 1.f);
+		}
+		inline float SinPhi(const Vec3& vec)
+		{
+			float sintheta = SinTheta(vec);
+			if (sintheta == 0.f)
+				return 0.f;
+			return Math::Clamp(vec.y / sintheta, -1.f, 1.f);
+		}
+		inline bool SameHemisphere(const Vec3& v1, const Vec3& v2) { return v1.z * v2.z > 0.f; }
+
+	}
+
+	class Diffuse;
+	class Mirror;
+	class Dielectric;
+
 	/// <summary>
 	/// Bi-directional Scattering Distribution Function.
+	/// The set of BSDFs is closed: every BSDF is one of the final classes below, tagged with its Kind.
+	/// SampleDirect, Eval &amp; Pdf switch on the tag and call the inline code of the concrete class,
+	/// code that knows the concrete class (e.g. a batch of hits of one kind) can call it directly.
 	/// </summary>
 	class BSDF {
 	public:
-		BSDF(BSDFType t, const Color& c = Color::WHITE) : type_(t), color_(c){}
+		enum class Kind : uint8_t {
+			Diffuse,
+			Mirror,
+			Dielectric
+		};
+
 		virtual ~BSDF(){}
 
-		virtual Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const = 0;
+		inline Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const;
+		inline Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
+		inline float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
+
+		/// <summary>
+		/// Calls f with this BSDF cast to its concrete class.
+		/// </summary>
+		template<typename F>
+		inline auto Dispatch(F&& f) const -> decltype(f(std::declval<const Diffuse&>()));
+
+		inline Kind GetKind() const { return kind_; }
+		inline BSDFType GetType() const { return type_; }
 		inline bool SubtypeOf(BSDFType t) const { return (type_ & t) == type_; }
 		inline bool IsSpecular() const { return (BSDFType(BSDF_SPECULAR | BSDF_DIFFUSE | BSDF_GLOSSY) & type_) == BSDFType(BSDF_SPECULAR); }
 		inline Color GetColor(const LocalGeo& geo) const {
 			return color_;
 		}
-		virtual Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
-		virtual float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
 
 		// clumsy approximation of phong components
 		virtual Color GetAmbient() const;
@@ -41,8 +98,7 @@ namespace TX{
 		virtual float GetShininess() const;
 
 	protected:
-		virtual float Eval(const Vec3& localwo, const Vec3& localwi, BSDFType type = BSDF_ALL) const = 0;
-		virtual float Pdf(const Vec3& localwo, const Vec3& localwi, BSDFType type = BSDF_ALL) const = 0;
+		BSDF(Kind kind, BSDFType t, const Color& c = Color::WHITE) : kind_(kind), type_(t), color_(c){}
 		inline bool Valid(const Vec3& wo, const Vec3& wi, const Vec3& normal, BSDFType *t) const{
 			if (Math::Dot(wo, normal) * Math::Dot(wi, normal) < 0.f)
 				*t = BSDFType(*t & ~BSDF_REFLECTION);
@@ -52,6 +108,7 @@ namespace TX{
 		}
 
 	protected:
+		const Kind kind_;
 		const BSDFType type_;
 		const Color color_;
 	};
@@ -59,103 +116,177 @@ namespace TX{
 	/// <summary>
 	/// Diffuse BSDF.
 	/// </summary>
-	class Diffuse : public BSDF {
+	class Diffuse final : public BSDF {
 	public:
-		Diffuse(const Color& c = Color::WHITE) : BSDF(BSDFType(BSDF_REFLECTION | BSDF_DIFFUSE), c){}
-		Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const;
-	protected:
-		float Eval(const Vec3& wo, const Vec3& wi, BSDFType type = BSDF_ALL) const;
-		float Pdf(const Vec3& wo, const Vec3& wi, BSDFType type = BSDF_ALL) const;
+		Diffuse(const Color& c = Color::WHITE) : BSDF(Kind::Diffuse, BSDFType(BSDF_REFLECTION | BSDF_DIFFUSE), c){}
 
-		virtual Color GetAmbient() const;
+		inline Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const{
+			Vec3 localwo = Math::Normalize(geom.WorldToLocal(wo));
+			Vec3 localwi = Sampling::CosineHemisphere(sample.u, sample.v);
+			if (localwo.z < 0.f)
+				localwi.z *= -1.f;
+			*wi = geom.LocalToWorld(localwi);
+			if (!Valid(wo, *wi, geom.normal, &types)){
+				*pdf = 0.f;
+				return Color::BLACK;
+			}
+			*pdf = Pdf(localwo, localwi);
+			if (sampled_types) *sampled_types = type_;
+			return GetColor(geom) * Eval(localwo, localwi);
+		}
+		inline Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const{
+			if (!Valid(wo, wi, geom.normal, &type))
+				return Color::BLACK;
+			return GetColor(geom) * Eval(geom.WorldToLocal(wo), geom.WorldToLocal(wi));
+		}
+		inline float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const{
+			if (!Valid(wo, wi, geom.normal, &type))
+				return 0.f;
+			return Pdf(geom.WorldToLocal(wo), geom.WorldToLocal(wi));
+		}
+
+		Color GetAmbient() const;
+	private:
+		inline float Eval(const Vec3& localwo, const Vec3& localwi) const{
+			return Math::PI_RCP;
+		}
+		inline float Pdf(const Vec3& localwo, const Vec3& localwi) const{
+			if (!LocalCoord::SameHemisphere(localwo, localwi))
+				return 0.f;
+			return LocalCoord::AbsCosTheta(localwi) * Math::PI_RCP;
+		}
 	};
 
 	/// <summary>
 	/// Mirror BSDF.
 	/// </summary>
-	class Mirror : public BSDF {
+	class Mirror final : public BSDF {
 	public:
-		Mirror(const Color& c = Color::WHITE) : BSDF(BSDFType(BSDF_REFLECTION | BSDF_SPECULAR), c){}
-		Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const;
-		Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
-		float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
+		Mirror(const Color& c = Color::WHITE) : BSDF(Kind::Mirror, BSDFType(BSDF_REFLECTION | BSDF_SPECULAR), c){}
 
-		virtual Color GetDiffuse() const;
-		virtual Color GetSpecular() const;
-		virtual float GetShininess() const;
-	protected:
-		float Eval(const Vec3& wo, const Vec3& wi, BSDFType type = BSDF_ALL) const;
-		float Pdf(const Vec3& wo, const Vec3& wi, BSDFType type = BSDF_ALL) const;
+		inline Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const{
+			if (!SubtypeOf(types)){
+				*pdf = 0.f;
+				return Color::BLACK;
+			}
+			Vec3 localwo(geom.WorldToLocal(wo));
+			Vec3 localwi(-localwo.x, -localwo.y, localwo.z);
+			*wi = geom.LocalToWorld(localwi);
+			*pdf = 1.f;
+			if (sampled_types) *sampled_types = type_;
+			return GetColor(geom) / LocalCoord::AbsCosTheta(localwi);
+		}
+		inline Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const{
+			return Color::BLACK;
+		}
+		inline float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const{
+			return 0.f;
+		}
+
+		Color GetDiffuse() const;
+		Color GetSpecular() const;
+		float GetShininess() const;
 	};
 
 	/// <summary>
 	/// Dielectric BSDF.
 	/// </summary>
-	class Dielectric : public BSDF{
+	class Dielectric final : public BSDF{
 	public:
 		Dielectric(const Color& c = Color::WHITE, float etat = 1.5f, float etai = 1.f) :
-			BSDF(BSDFType(BSDF_REFLECTION | BSDF_TRANSMISSION | BSDF_SPECULAR), c),
-			etat_(etat), etai_(etai), eta_(etai / etat), eta_inv_(etat / etai){}
-		Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const;
-		Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
-		float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const;
+			BSDF(Kind::Dielectric, BSDFType(BSDF_REFLECTION | BSDF_TRANSMISSION | BSDF_SPECULAR), c),
+			etai_(etai), etat_(etat), eta_(etai / etat), eta_inv_(etat / etai){}
 
-		virtual Color GetAmbient() const;
-		virtual Color GetDiffuse() const;
-		virtual Color GetSpecular() const;
-		virtual float GetShininess() const;
-	protected:
-		float Eval(const Vec3& wo, const Vec3& wi, BSDFType type = BSDF_ALL) const;
-		float Pdf(const Vec3& wo, const Vec3& wi, BSDFType type = BSDF_ALL) const;
+		inline Color SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types = BSDF_ALL, BSDFType *sampled_types = nullptr) const{
+			bool reflection = (types & (BSDF_REFLECTION | BSDF_SPECULAR)) == (BSDF_REFLECTION | BSDF_SPECULAR);
+			bool transmission = (types & (BSDF_TRANSMISSION | BSDF_SPECULAR)) == (BSDF_TRANSMISSION | BSDF_SPECULAR);
+			if (!reflection && !transmission){
+				*pdf = 0.f;
+				return Color::BLACK;
+			}
+			bool both = reflection == transmission;
+			Vec3 localwo(geom.WorldToLocal(wo)), localwi;
+			// angle of refraction
+			float eta;
+			float cosi = LocalCoord::CosTheta(localwo), cost = Refract(cosi, &eta);
+			// reflectance
+			float refl = Reflectance(cosi, cost);
+			float prob = 0.5f * refl + 0.25f;
+			if (refl > 0.f && (sample.w <= prob && both || reflection && !both)){			// sample reflection
+				localwi = Vec3(-localwo.x, -localwo.y, localwo.z);
+				*wi = geom.LocalToWorld(localwi);
+				*pdf = both ? prob : 1.f;
+				if (sampled_types) *sampled_types = BSDFType(BSDF_REFLECTION | BSDF_SPECULAR);
+				return GetColor(geom).Luminance() * refl / LocalCoord::AbsCosTheta(localwi);
+			}
+			else if (refl < 1.f && (sample.w > prob && both || transmission && !both)){		// sample refraction
+				if (eta == eta_)	// entering
+					cost = -cost;
+				localwi = Vec3(eta * -localwo.x, eta * -localwo.y, cost);
+				*wi = geom.LocalToWorld(localwi);
+				*pdf = both ? 1.f - prob : 1.f;
+				if (sampled_types) *sampled_types = BSDFType(BSDF_TRANSMISSION | BSDF_SPECULAR);
+				return GetColor(geom) * ((1.f - refl) / LocalCoord::AbsCosTheta(localwi));
+			}
+			return Color::BLACK;
+		}
+		inline Color Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const{
+			return Color::BLACK;
+		}
+		inline float Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type = BSDF_ALL) const{
+			return 0.f;
+		}
+
+		Color GetAmbient() const;
+		Color GetDiffuse() const;
+		Color GetSpecular() const;
+		float GetShininess() const;
+	private:
 		/// <summary>
 		/// Computes cosine of out angle using Snell's law.
 		/// </summary>
 		/// <param name="cosi">Incident angle</param>
 		/// <param name="eta">Index of refraction</param>
-		float Refract(float cosi, float *eta = nullptr) const;
+		inline float Refract(float cosi, float *eta = nullptr) const{
+			float e = (cosi > 0.f) ? eta_ : eta_inv_;	// determine whether the ray is entering the surface
+			if (eta) *eta = e;
+			return Math::Sqrt(Math::Max(0.f, 1.f - e * e * (1.f - cosi * cosi)));
+		}
 		/// <summary>
 		/// Computes reflectance using Fresnel's equation.
 		/// </summary>
 		/// <param name="cosi">Incident angle</param>
 		/// <param name="cost">Reflected angle</param>
-		float Reflectance(float cosi, float cost) const;
+		inline float Reflectance(float cosi, float cost) const{
+			if (cost == 0.f) return 1.f;	// total internal reflection
+			cosi = Math::Abs(cosi);
+			float etci = etat_ * cosi, etct = etat_ * cost,
+				eici = etai_ * cosi, eict = etai_ * cost;
+			float para = (etci - eict) / (etci + eict);
+			float perp = (eici - etct) / (eici + etct);
+			return 0.5f * (para * para + perp * perp);
+		}
 	private:
 		const float etai_, etat_;		// indices of refraction on each side
 		const float eta_, eta_inv_;		// convenient constants
 	};
 
-	namespace LocalCoord {
-		inline float CosTheta(const Vec3& vec) { return vec.z; }
-		inline float CosTheta2(const Vec3& vec) { return vec.z * vec.z; }
-		inline float AbsCosTheta(const Vec3& vec) { return Math::Abs(vec.z); }
-		inline float SinTheta2(const Vec3& vec) { return Math::Max(0.f, 1.f - CosTheta2(vec)); }
-		inline float SinTheta(const Vec3& vec) { return Math::Sqrt(SinTheta2(vec)); }
-		inline float TanTheta(const Vec3& vec)
-		{
-			return Math::Sqrt(SinTheta2(vec)) / vec.z;
-		}
-		inline float TanTheta2(const Vec3& vec)
-		{
-			float cos2 = vec.z * vec.z;
-			float sin2 = 1 - cos2;
-			if (sin2 <= 0.f)
-				return 0.f;
-			return sin2 / cos2;
-		}
-		inline float CosPhi(const Vec3& vec)
-		{
-			float sintheta = SinTheta(vec);
-			if (sintheta == 0.f) return 1.f;
-			return Math::Clamp(vec.x / sintheta, -1.f, 1.f);
+	template<typename F>
+	inline auto BSDF::Dispatch(F&& f) const -> decltype(f(std::declval<const Diffuse&>())) {
+		switch (kind_){
+		case Kind::Diffuse:		return f(static_cast<const Diffuse&>(*this));
+		case Kind::Mirror:		return f(static_cast<const Mirror&>(*this));
+		default:				return f(static_cast<const Dielectric&>(*this));
 		}
-		inline float SinPhi(const Vec3& vec)
-		{
-			float sintheta = SinTheta(vec);
-			if (sintheta == 0.f)
-				return 0.f;
-			return Math::Clamp(vec.y / sintheta, -1.f, 1.f);
-		}
-		inline bool SameHemisphere(const Vec3& v1, const Vec3& v2) { return v1.z * v2.z > 0.f; }
+	}
 
+	inline Color BSDF::SampleDirect(const Vec3& wo, const LocalGeo& geom, const Sample& sample, Vec3 *wi, float *pdf, BSDFType types, BSDFType *sampled_types) const{
+		return Dispatch([&](const auto& bsdf){ return bsdf.SampleDirect(wo, geom, sample, wi, pdf, types, sampled_types); });
+	}
+	inline Color BSDF::Eval(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type) const{
+		return Dispatch([&](const auto& bsdf){ return bsdf.Eval(wo, wi, geom, type); });
+	}
+	inline float BSDF::Pdf(const Vec3& wo, const Vec3& wi, const LocalGeo& geom, BSDFType type) const{
+		return Dispatch([&](const auto& bsdf){ return bsdf.Pdf(wo, wi, geom, type); });
 	}
 }
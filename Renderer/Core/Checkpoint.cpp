@@ -0,0 +1,130 @@
+#include "stdafx.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "txbase/scene/camera.h"
+
+#include "Checkpoint.h"
+#include "RendererConfig.h"
+
+namespace TX {
+	namespace {
+		const char MAGIC[4] = { 'T', 'X', 'C', 'K' };
+		const uint32_t VERSION = 3;
+
+		/// <summary>
+		/// FNV-1a, stable across runs &amp; platforms unlike std::hash.
+		/// </summary>
+		uint64_t Hash(const std::string& s) {
+			uint64_t h = 14695981039346656037ull;
+			for (char c : s) {
+				h ^= uint8_t(c);
+				h *= 1099511628211ull;
+			}
+			return h;
+		}
+	}
+
+	void Checkpoint::State::Describe(const RendererConfig& config, const Camera& camera) {
+		frame_width = camera.Width();
+		frame_height = camera.Height();
+		static_assert(sizeof(Matrix4x4) == sizeof(view), "the camera matrix is stored as 16 floats");
+		std::memcpy(view, &camera.transform.LocalToWorldMatrix(), sizeof(view));
+		tracer = int(config.tracer_t);
+		max_depth = config.tracer_maxdepth;
+		sampler = int(config.sampler_t);
+		ris_candidates = config.ris_candidates;
+		ris_neighbors = config.ris_neighbors;
+		scene = Hash(config.scene_name);
+		samples_per_pixel = config.samples_per_pixel;
+	}
+
+	bool Checkpoint::State::Matches(const State& other) const {
+		return width == other.width && height == other.height &&
+			film_x == other.film_x && film_y == other.film_y &&
+			frame_width == other.frame_width && frame_height == other.frame_height &&
+			samples_per_pixel == other.samples_per_pixel &&
+			std::memcmp(view, other.view, sizeof(view)) == 0 &&
+			tracer == other.tracer && max_depth == other.max_depth && sampler == other.sampler &&
+			ris_candidates == other.ris_candidates && ris_neighbors == other.ris_neighbors &&
+			scene == other.scene;
+	}
+
+	Checkpoint::~Checkpoint() {
+		Wait();
+	}
+
+	bool Checkpoint::Save(const std::string& path, const State& state, const Accumulator& accum) {
+		if (pending_.valid()) {
+			if (pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return false;
+			pending_.get();
+		}
+		// the copy is the only part done on the render threads
+		size_t count = size_t(accum.Width()) * accum.Height();
+		snapshot_.resize(count);
+		if (count > 0)
+			std::memcpy(snapshot_.data(), accum.Pixels(), sizeof(Accumulator::Pixel) * count);
+		pending_ = std::async(std::launch::async, &Checkpoint::Write, path, state, std::cref(snapshot_));
+		return true;
+	}
+
+	void Checkpoint::Wait() {
+		if (pending_.valid())
+			pending_.get();
+	}
+
+	bool Checkpoint::Write(const std::string& path, const State& state, const std::vector<Accumulator::Pixel>& pixels) {
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			if (!out) return false;
+			out.write(MAGIC, sizeof(MAGIC));
+			out.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+			out.write(reinterpret_cast<const char *>(&state), sizeof(State));
+			out.write(reinterpret_cast<const char *>(pixels.data()), sizeof(Accumulator::Pixel) * pixels.size());
+			if (!out) return false;
+		}
+		// the old checkpoint is replaced in one step, a crash leaves either of them
+#ifdef _WIN32
+		return MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+	}
+
+	bool Checkpoint::Load(const std::string& path, const State& expected, State& state, Accumulator& accum) {
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in) return false;
+		const uint64_t fileSize = uint64_t(in.tellg());
+		in.seekg(0);
+		char magic[4];
+		uint32_t version;
+		State loaded;
+		in.read(magic, sizeof(magic));
+		in.read(reinterpret_cast<char *>(&version), sizeof(version));
+		in.read(reinterpret_cast<char *>(&loaded), sizeof(State));
+		if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION)
+			return false;
+		if (loaded.width <= 0 || loaded.height <= 0 || loaded.passes < 0 || !loaded.Matches(expected))
+			return false;
+		const uint64_t pixelBytes = sizeof(Accumulator::Pixel) * uint64_t(loaded.width) * uint64_t(loaded.height);
+		if (fileSize != sizeof(MAGIC) + sizeof(VERSION) + sizeof(State) + pixelBytes)
+			return false;
+
+		accum.Resize(loaded.width, loaded.height);
+		in.read(reinterpret_cast<char *>(accum.Pixels()), std::streamsize(pixelBytes));
+		if (!in) {
+			accum.Clear();
+			return false;
+		}
+		state = loaded;
+		return true;
+	}
+}
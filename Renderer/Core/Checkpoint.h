@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <future>
+#include "Accumulator.h"
+
+namespace TX {
+	class Camera;
+	struct RendererConfig;
+
+	/// <summary>
+	/// Snapshot of a progressive render taken between two passes, enough to continue it in another process.
+	/// The sampler &amp; random streams are seeded from (pixel, sample index, seed),
+	/// so the seed and the number of finished passes are all the state they need.
+	/// </summary>
+	class Checkpoint {
+	public:
+		struct State {
+			int width = 0, height = 0;		// size of the accumulator
+			int film_x = 0, film_y = 0;		// position of the film in the frame
+			int frame_width = 0, frame_height = 0;
+			int passes = 0;					// number of sample passes already accumulated
+			int samples_per_pixel = 0;
+			uint64_t seed = 0;
+			float view[16] = {};			// local to world matrix of the camera
+			int tracer = 0;					// RenderMethod
+			int max_depth = 0;
+			int sampler = 0;				// SamplerType
+			int ris_candidates = 0, ris_neighbors = 0;	// settings of ResampledDirectLighting
+			uint64_t scene = 0;				// hash of the scene name of the config
+
+			/// <summary>
+			/// Fills in the frame, camera, tracer, sampler &amp; scene of a render, leaving the accumulator size,
+			/// film position &amp; passes to the caller.
+			/// </summary>
+			void Describe(const RendererConfig& config, const Camera& camera);
+			/// <summary>
+			/// Whether a render with the other settings can continue from this state,
+			/// everything but the passes done &amp; the seed has to be the same.
+			/// </summary>
+			bool Matches(const State& other) const;
+		};
+	public:
+		~Checkpoint();
+
+		/// <summary>
+		/// Copies the accumulated sums and writes them to the file in the background.
+		/// The file is replaced only once the new checkpoint is complete.
+		/// </summary>
+		/// <returns> False if the previous checkpoint is still being written, in which case nothing is saved </returns>
+		bool Save(const std::string& path, const State& state, const Accumulator& accum);
+		/// <summary>
+		/// Blocks until the pending write, if any, is done.
+		/// </summary>
+		void Wait();
+
+		/// <summary>
+		/// Reads a checkpoint the render described by expected can continue from, resizing the accumulator to match it.
+		/// Nothing is allocated before the header is known to match and the file to hold all the pixels.
+		/// </summary>
+		/// <returns> False if the file is missing, not a valid checkpoint or of another render </returns>
+		static bool Load(const std::string& path, const State& expected, State& state, Accumulator& accum);
+	private:
+		static bool Write(const std::string& path, const State& state, const std::vector<Accumulator::Pixel>& pixels);
+	private:
+		std::future<bool> pending_;
+		std::vector<Accumulator::Pixel> snapshot_;
+	};
+}
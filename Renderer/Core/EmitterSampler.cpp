@@ -0,0 +1,118 @@
+#include "stdafx.h"
+#include "EmitterSampler.h"
+
+namespace TX {
+	const float EmitterSampler::MIN_SPHERICAL_AREA = 3e-4f;
+	const float EmitterSampler::MAX_SPHERICAL_AREA = 6.22f;
+
+	namespace {
+		inline Vec3 GramSchmidt(const Vec3& v, const Vec3& w) { return v - w * Math::Dot(v, w); }
+		inline float AngleBetween(const Vec3& a, const Vec3& b) { return Math::Acos(Math::Clamp(Math::Dot(a, b), -1.f, 1.f)); }
+
+		/// <summary>
+		/// Arvo's sampling of the spherical triangle abc of unit directions, uniform in solid angle.
+		/// </summary>
+		/// <returns> The sampled direction </returns>
+		Vec3 SampleSphericalTriangle(const Vec3& a, const Vec3& b, const Vec3& c, float u, float v) {
+			Vec3 n_ab = Math::Normalize(Math::Cross(a, b));
+			Vec3 n_bc = Math::Normalize(Math::Cross(b, c));
+			Vec3 n_ca = Math::Normalize(Math::Cross(c, a));
+			// angles at the vertices, their sum minus pi is the area
+			float alpha = AngleBetween(n_ab, -n_ca);
+			float beta = AngleBetween(n_bc, -n_ab);
+			float gamma = AngleBetween(n_ca, -n_bc);
+
+			// area of the sub-triangle ab'c' with the sampled fraction of the area, then its vertex c' on the arc ac
+			float area = Math::PI + u * (alpha + beta + gamma - Math::PI);
+			float cosAlpha = Math::Cos(alpha), sinAlpha = Math::Sin(alpha);
+			float sinPhi = Math::Sin(area) * cosAlpha - Math::Cos(area) * sinAlpha;
+			float cosPhi = Math::Cos(area) * cosAlpha + Math::Sin(area) * sinAlpha;
+			float k1 = cosPhi + cosAlpha;
+			float k2 = sinPhi - sinAlpha * Math::Dot(a, b);
+			float cosB = (k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) / ((k2 * sinPhi + k1 * cosPhi) * sinAlpha);
+			cosB = Math::Clamp(cosB, -1.f, 1.f);
+			float sinB = Math::Sqrt(Math::Max(0.f, 1.f - cosB * cosB));
+			Vec3 c_ = a * cosB + Math::Normalize(GramSchmidt(c, a)) * sinB;
+
+			// uniform point of the arc from b to c'
+			float cosTheta = 1.f - v * (1.f - Math::Dot(c_, b));
+			float sinTheta = Math::Sqrt(Math::Max(0.f, 1.f - cosTheta * cosTheta));
+			return b * cosTheta + Math::Normalize(GramSchmidt(c_, b)) * sinTheta;
+		}
+	}
+
+	EmitterSampler::EmitterSampler(const Mesh& mesh) {
+		const uint n = mesh.TriangleCount();
+		for (auto v : { &p0_x, &p0_y, &p0_z, &e1_x, &e1_y, &e1_z, &e2_x, &e2_y, &e2_z, &n_x, &n_y, &n_z, &areas_ })
+			v->resize(n);
+		const bool hasNormals = !mesh.normals.empty();
+		double area = 0.0;
+		for (uint i = 0; i < n; i++) {
+			const uint *idx = &mesh.indices[3 * i];
+			const Vec3& p0 = mesh.vertices[idx[0]];
+			Vec3 e1 = mesh.vertices[idx[1]] - p0, e2 = mesh.vertices[idx[2]] - p0;
+			Vec3 cross = Math::Cross(e1, e2);
+			float length = Math::Length(cross);
+			Vec3 normal = length > 0.f ? cross / length : Vec3::ZERO;
+			if (hasNormals && Math::Dot(normal, mesh.normals[idx[0]] + mesh.normals[idx[1]] + mesh.normals[idx[2]]) < 0.f)
+				normal = -normal;
+			p0_x[i] = p0.x; p0_y[i] = p0.y; p0_z[i] = p0.z;
+			e1_x[i] = e1.x; e1_y[i] = e1.y; e1_z[i] = e1.z;
+			e2_x[i] = e2.x; e2_y[i] = e2.y; e2_z[i] = e2.z;
+			n_x[i] = normal.x; n_y[i] = normal.y; n_z[i] = normal.z;
+			areas_[i] = 0.5f * length;
+			area += areas_[i];
+		}
+		if (!(area > 0.0))
+			throw "emitting mesh without area";
+		area_ = float(area);
+		inv_area_ = 1.f / area_;
+		triangles_ = AliasTable(areas_);
+	}
+
+	float EmitterSampler::SphericalArea(uint i, const Vec3& eye) const {
+		Vec3 a = P0(i) - eye, b = a + E1(i), c = a + E2(i);
+		float la = Math::Length(a), lb = Math::Length(b), lc = Math::Length(c);
+		if (la == 0.f || lb == 0.f || lc == 0.f)
+			return 0.f;
+		a /= la; b /= lb; c /= lc;
+		float area = Math::Abs(2.f * std::atan2(Math::Dot(a, Math::Cross(b, c)), 1.f + Math::Dot(a, b) + Math::Dot(a, c) + Math::Dot(b, c)));
+		return area >= MIN_SPHERICAL_AREA && area <= MAX_SPHERICAL_AREA ? area : 0.f;
+	}
+
+	void EmitterSampler::SamplePoint(const Sample *sample, const Vec3& eye, Vec3 *point, uint *triId, Vec3 *normal) const {
+		const uint i = triangles_.Sample(sample->w);
+		const Vec3 p0 = P0(i), e1 = E1(i), e2 = E2(i);
+		*triId = i;
+		*normal = Normal(i);
+
+		if (SphericalArea(i, eye) > 0.f) {
+			Vec3 a = Math::Normalize(p0 - eye), b = Math::Normalize(p0 + e1 - eye), c = Math::Normalize(p0 + e2 - eye);
+			Vec3 dir = SampleSphericalTriangle(a, b, c, sample->u, sample->v);
+			// where the direction meets the plane of the triangle
+			float cosine = Math::Dot(dir, *normal);
+			if (cosine != 0.f) {
+				float t = Math::Dot(p0 - eye, *normal) / cosine;
+				if (t > 0.f) {
+					*point = eye + dir * t;
+					return;
+				}
+			}
+		}
+		float s = Math::Sqrt(sample->u);
+		*point = p0 + e1 * (s * (1.f - sample->v)) + e2 * (s * sample->v);
+	}
+
+	float EmitterSampler::Pdf(uint triId, const Vec3& eye, const Vec3& dir) const {
+		float spherical = SphericalArea(triId, eye);
+		if (spherical > 0.f)
+			return triangles_.Pmf(triId) / spherical;
+		// area pdf converted to solid angle
+		const Vec3 normal = Normal(triId);
+		float cosine = Math::Dot(dir, normal);
+		if (cosine == 0.f)
+			return 0.f;
+		float t = Math::Dot(P0(triId) - eye, normal) / cosine;
+		return t > 0.f ? t * t * inv_area_ / Math::Abs(cosine) : 0.f;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "txbase/math/vector.h"
+#include "txbase/math/sample.h"
+#include "txbase/shape/mesh.h"
+#include "AliasTable.h"
+
+namespace TX {
+	/// <summary>
+	/// Samples points on the triangles of an emitting mesh, in constant time whatever the triangle count:
+	/// the triangle is picked by area from an alias table, the point either uniformly on it or,
+	/// for triangles seen under a large enough solid angle, uniformly in that solid angle.
+	/// The triangles are kept in a compact structure of arrays, separate from the mesh.
+	/// </summary>
+	class EmitterSampler {
+	public:
+		explicit EmitterSampler(const Mesh& mesh);
+
+		/// <summary>
+		/// Samples a point of the mesh seen from eye, the triangle is picked with sample->w,
+		/// the point with sample->u &amp; sample->v.
+		/// </summary>
+		void SamplePoint(const Sample *sample, const Vec3& eye, Vec3 *point, uint *triId, Vec3 *normal) const;
+		/// <summary>
+		/// Pdf w.r.t. the area of the mesh of sampling a point without the solid angle sampling.
+		/// </summary>
+		inline float Pdf(uint triId, const Vec3& surfacePoint) const { return inv_area_; }
+		/// <summary>
+		/// Pdf w.r.t. solid angle at eye of sampling the direction dir, which hits the triangle triId.
+		/// </summary>
+		float Pdf(uint triId, const Vec3& eye, const Vec3& dir) const;
+		inline float Area() const { return area_; }
+	private:
+		inline Vec3 P0(uint i) const { return Vec3(p0_x[i], p0_y[i], p0_z[i]); }
+		inline Vec3 E1(uint i) const { return Vec3(e1_x[i], e1_y[i], e1_z[i]); }
+		inline Vec3 E2(uint i) const { return Vec3(e2_x[i], e2_y[i], e2_z[i]); }
+		inline Vec3 Normal(uint i) const { return Vec3(n_x[i], n_y[i], n_z[i]); }
+		/// <summary>
+		/// Solid angle of the triangle seen from eye if it is sampled by solid angle, 0 if it is sampled by area.
+		/// </summary>
+		float SphericalArea(uint i, const Vec3& eye) const;
+	private:
+		static const float MIN_SPHERICAL_AREA;		// below, the spherical sampling loses precision
+		static const float MAX_SPHERICAL_AREA;		// above, the eye is nearly on the plane of the triangle
+
+		std::vector<float> p0_x, p0_y, p0_z;		// first vertex
+		std::vector<float> e1_x, e1_y, e1_z;		// edges to the second & third vertex
+		std::vector<float> e2_x, e2_y, e2_z;
+		std::vector<float> n_x, n_y, n_z;			// unit normal, on the side of the vertex normals
+		std::vector<float> areas_;
+		AliasTable triangles_;
+		float area_, inv_area_;
+	};
+}
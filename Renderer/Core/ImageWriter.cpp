@@ -0,0 +1,64 @@
+#include "stdafx.h"
+#include <vector>
+
+// private copy of the writer, txbase may carry its own
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "txbase/libs/stb_image_write.h"
+
+#include "ImageWriter.h"
+
+namespace TX {
+	namespace {
+		/// <summary>
+		/// Exposed, clamped &amp; gamma corrected 8 bit pixels, top row first.
+		/// </summary>
+		std::vector<uint8_t> ToRGB8(const Color *pixels, int width, int height, float exposure) {
+			const float INV_GAMMA = 1.f / 2.2f;
+			auto encode = [=](float v) {
+				return uint8_t(Math::Pow(Math::Clamp(v * exposure, 0.f, 1.f), INV_GAMMA) * 255.f + 0.5f);
+			};
+			std::vector<uint8_t> rgb(size_t(width) * height * 3);
+			uint8_t *dst = rgb.data();
+			for (int y = height - 1; y >= 0; y--) {
+				const Color *row = pixels + y * width;
+				for (int x = 0; x < width; x++) {
+					*dst++ = encode(row[x].r);
+					*dst++ = encode(row[x].g);
+					*dst++ = encode(row[x].b);
+				}
+			}
+			return rgb;
+		}
+
+		void AppendBytes(void *context, void *data, int size) {
+			auto out = static_cast<std::vector<uint8_t> *>(context);
+			out->insert(out->end(), static_cast<uint8_t *>(data), static_cast<uint8_t *>(data) + size);
+		}
+	}
+
+	bool ImageWriter::WriteHDR(const std::string& path, const Color *pixels, int width, int height) {
+		std::vector<float> rgb(size_t(width) * height * 3);
+		float *dst = rgb.data();
+		for (int y = height - 1; y >= 0; y--) {
+			const Color *row = pixels + y * width;
+			for (int x = 0; x < width; x++) {
+				*dst++ = row[x].r;
+				*dst++ = row[x].g;
+				*dst++ = row[x].b;
+			}
+		}
+		return stbi_write_hdr(path.c_str(), width, height, 3, rgb.data()) != 0;
+	}
+
+	bool ImageWriter::WritePNG(const std::string& path, const Color *pixels, int width, int height, float exposure) {
+		std::vector<uint8_t> rgb = ToRGB8(pixels, width, height, exposure);
+		return stbi_write_png(path.c_str(), width, height, 3, rgb.data(), width * 3) != 0;
+	}
+
+	bool ImageWriter::EncodePNG(std::vector<uint8_t>& out, const Color *pixels, int width, int height, float exposure) {
+		std::vector<uint8_t> rgb = ToRGB8(pixels, width, height, exposure);
+		out.clear();
+		return stbi_write_png_to_func(AppendBytes, &out, width, height, 3, rgb.data(), width * 3) != 0;
+	}
+}
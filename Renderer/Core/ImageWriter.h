@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "txbase/math/color.h"
+
+namespace TX {
+	/// <summary>
+	/// Saves rendered pixels to image files.
+	/// The pixels are expected bottom row first as in the film, the files are written top row first.
+	/// </summary>
+	class ImageWriter {
+	public:
+		/// <summary>
+		/// Radiance HDR file keeping the raw radiance.
+		/// </summary>
+		static bool WriteHDR(const std::string& path, const Color *pixels, int width, int height);
+		/// <summary>
+		/// 8 bit PNG file, the radiance is scaled by the exposure, clamped and gamma corrected.
+		/// </summary>
+		static bool WritePNG(const std::string& path, const Color *pixels, int width, int height, float exposure = 1.f);
+		/// <summary>
+		/// Same as WritePNG but into memory, to be sent over the network.
+		/// </summary>
+		static bool EncodePNG(std::vector<uint8_t>& out, const Color *pixels, int width, int height, float exposure = 1.f);
+	};
+}
@@ -22,12 +22,26 @@ namespace TX
 		uint triId;
 
 		// take a random point on the surface
-		primitive->SamplePoint(lightsamples, &lightpoint, &triId, &normal);
+		primitive->SamplePoint(lightsamples, eye, &lightpoint, &triId, &normal);
 		wi->SetSegment(eye, lightpoint);
 		// compute pdf & color of the ray
 		*pdf = primitive->Pdf(triId, eye, wi->dir);
 		Emit(lightpoint, normal, -wi->dir, lightcolor);
 	}
+	void AreaLight::SamplePoint(const Vec3& eye, const Sample *lightsamples, Vec3 *point, Vec3 *normal, float *pdf) const {
+		uint triId;
+		primitive->SamplePoint(lightsamples, eye, point, &triId, normal);
+		Vec3 d = *point - eye;
+		float dist2 = Math::Dot(d, d);
+		if (dist2 == 0.f){
+			*pdf = 0.f;
+			return;
+		}
+		d /= Math::Sqrt(dist2);
+		// solid angle at eye to area of the light
+		float cosl = Math::Abs(Math::Dot(*normal, d));
+		*pdf = primitive->Pdf(triId, eye, d) * cosl / dist2;
+	}
 	void AreaLight::Emit(const Vec3& pos, const Vec3& normal, const Vec3& wo, Color *out) const {
 		*out = Math::Dot(normal, wo) > 0.f ? intensity : 0.f;
 	}
@@ -43,6 +43,11 @@ namespace TX {
 		virtual void SampleDirect(const Vec3& pos, const Sample *lightsamples, Ray *wi, Color *lightcolor, float *pdf) const;
 		virtual void Emit(const Vec3& pos, const Vec3& normal, const Vec3& wo, Color *out) const;
 		virtual float Pdf(const Vec3& eye, const Vec3& dir) const;
+		/// <summary>
+		/// Samples a point of the light for a shading point at eye, same distribution as SampleDirect().
+		/// </summary>
+		/// <param name="pdf">Pdf w.r.t. the area of the light, 0 if the point faces away from eye</param>
+		void SamplePoint(const Vec3& eye, const Sample *lightsamples, Vec3 *point, Vec3 *normal, float *pdf) const;
 
 		virtual Color Intensity() const;
 		virtual Vec4 Position() const;
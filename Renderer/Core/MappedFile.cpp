@@ -0,0 +1,85 @@
+#include "stdafx.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+namespace TX {
+	MappedFile::MappedFile() : data_(nullptr), size_(0), file_(nullptr), mapping_(nullptr) {}
+	MappedFile::~MappedFile() {
+		Close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string& path) {
+		Close();
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+		data_ = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!data_) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		size_ = size_t(size.QuadPart);
+		file_ = file;
+		mapping_ = mapping;
+		return true;
+	}
+
+	void MappedFile::Close() {
+		if (data_) UnmapViewOfFile(data_);
+		if (mapping_) CloseHandle(mapping_);
+		if (file_) CloseHandle(file_);
+		data_ = nullptr;
+		size_ = 0;
+		file_ = mapping_ = nullptr;
+	}
+#else
+	bool MappedFile::Open(const std::string& path) {
+		Close();
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return false;
+		}
+		void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);		// the mapping keeps the file alive
+		if (data == MAP_FAILED)
+			return false;
+		// the whole file is about to be read, start fetching it now
+		madvise(data, size_t(st.st_size), MADV_WILLNEED);
+		data_ = static_cast<const char *>(data);
+		size_ = size_t(st.st_size);
+		return true;
+	}
+
+	void MappedFile::Close() {
+		if (data_) munmap(const_cast<char *>(data_), size_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+#endif
+}
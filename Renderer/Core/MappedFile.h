@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+namespace TX {
+	/// <summary>
+	/// Read-only view of a whole file mapped into memory.
+	/// </summary>
+	class MappedFile {
+	public:
+		MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator = (const MappedFile&) = delete;
+		~MappedFile();
+
+		/// <returns> False if the file can't be opened or mapped </returns>
+		bool Open(const std::string& path);
+		void Close();
+
+		inline const char* Data() const { return data_; }
+		inline size_t Size() const { return size_; }
+	private:
+		const char *data_;
+		size_t size_;
+		void *file_;		// native handles
+		void *mapping_;
+	};
+}
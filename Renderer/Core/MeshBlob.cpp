@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include <fstream>
+#include <stdexcept>
+
+#include "MeshBlob.h"
+#include "MappedFile.h"
+#include "SceneMesh.h"
+
+namespace TX {
+	namespace {
+		const char MAGIC[4] = { 'T', 'X', 'M', 'B' };
+		const uint32_t VERSION = 1;
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint32_t vertexCount;		// number of vertices, also the number of normals
+			uint32_t indexCount;		// three per triangle
+		};
+
+		static_assert(sizeof(Vec3) == 3 * sizeof(float), "vertices are copied as packed floats");
+		static_assert(sizeof(Header) % 4 == 0, "arrays must stay aligned to 4 bytes");
+	}
+
+	bool MeshBlob::Write(const std::string& path, const Mesh& mesh) {
+		if (mesh.normals.size() != mesh.vertices.size() || mesh.indices.size() % 3 != 0)
+			return false;
+		Header header;
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.vertexCount = uint32_t(mesh.vertices.size());
+		header.indexCount = uint32_t(mesh.indices.size());
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char *>(mesh.vertices.data()), sizeof(Vec3) * mesh.vertices.size());
+		out.write(reinterpret_cast<const char *>(mesh.normals.data()), sizeof(Vec3) * mesh.normals.size());
+		out.write(reinterpret_cast<const char *>(mesh.indices.data()), sizeof(uint32_t) * mesh.indices.size());
+		return bool(out);
+	}
+
+	void MeshBlob::Load(const std::string& path, SceneMesh& mesh) {
+		MappedFile file;
+		if (!file.Open(path))
+			throw std::runtime_error("cannot open mesh " + path);
+
+		Header header;
+		if (file.Size() < sizeof(Header))
+			throw std::runtime_error("not a mesh blob: " + path);
+		std::memcpy(&header, file.Data(), sizeof(Header));
+		size_t expected = sizeof(Header) +
+			2 * sizeof(Vec3) * size_t(header.vertexCount) +
+			sizeof(uint32_t) * size_t(header.indexCount);
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+			header.indexCount % 3 != 0 || file.Size() != expected)
+			throw std::runtime_error("not a mesh blob: " + path);
+
+		const Vec3 *vertices = reinterpret_cast<const Vec3 *>(file.Data() + sizeof(Header));
+		const Vec3 *normals = vertices + header.vertexCount;
+		const uint32_t *indices = reinterpret_cast<const uint32_t *>(normals + header.vertexCount);
+		for (uint32_t i = 0; i < header.indexCount; i++)
+			if (indices[i] >= header.vertexCount)
+				throw std::runtime_error("not a mesh blob: " + path);
+		mesh.vertices.assign(vertices, vertices + header.vertexCount);
+		mesh.normals.assign(normals, normals + header.vertexCount);
+		mesh.indices.assign(indices, indices + header.indexCount);
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+namespace TX {
+	class Mesh;
+	class SceneMesh;
+
+	/// <summary>
+	/// Binary mesh file holding the arrays of a mesh exactly as they are laid out in memory:
+	/// a header followed by the vertices, the normals and the triangle indices.
+	/// Loading is a memory mapping and one copy per array, nothing is parsed.
+	/// </summary>
+	class MeshBlob {
+	public:
+		static bool Write(const std::string& path, const Mesh& mesh);
+		/// <summary>
+		/// Throws if the file is missing or not a valid mesh blob.
+		/// </summary>
+		static void Load(const std::string& path, SceneMesh& mesh);
+	};
+}
@@ -0,0 +1,314 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "txbase/shape/mesh.h"
+
+#include "ParallelObjLoader.h"
+#include "MappedFile.h"
+#include "TaskSystem.h"
+
+namespace TX {
+	namespace {
+		const int NO_NORMAL = -1;
+
+		/// <summary>
+		/// Everything parsed from one chunk of the file.
+		/// Indices are 0-based and absolute, except the negative ones which are listed in the fixups
+		/// because they are relative to the elements of the previous chunks.
+		/// </summary>
+		struct Chunk {
+			const char *begin, *end;
+			std::vector<Vec3> positions;
+			std::vector<Vec3> normals;
+			std::vector<int> corner_positions;		// three per triangle
+			std::vector<int> corner_normals;
+			std::vector<std::pair<size_t, int>> position_fixups;	// corner, index counted back from the end of the chunk
+			std::vector<std::pair<size_t, int>> normal_fixups;
+			int lines = 0;
+			int error_line = 0;				// 1-based line of the chunk, 0 if none
+			const char *error = nullptr;
+		};
+
+		inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+		inline void SkipSpaces(const char *&p, const char *end) {
+			while (p < end && IsSpace(*p)) p++;
+		}
+
+		/// <summary>
+		/// Plain decimal float, locale independent and a lot faster than strtof.
+		/// </summary>
+		bool ParseFloat(const char *&p, const char *end, float& out) {
+			SkipSpaces(p, end);
+			const char *start = p;
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+			double value = 0.0;
+			const char *digits = p;
+			while (p < end && *p >= '0' && *p <= '9') value = value * 10.0 + (*p++ - '0');
+			if (p < end && *p == '.') {
+				p++;
+				double scale = 0.1;
+				while (p < end && *p >= '0' && *p <= '9') { value += (*p++ - '0') * scale; scale *= 0.1; }
+			}
+			if (p == digits || (p == digits + 1 && *digits == '.')) {
+				p = start;
+				return false;
+			}
+			if (p < end && (*p == 'e' || *p == 'E')) {
+				p++;
+				bool negativeExp = false;
+				if (p < end && (*p == '-' || *p == '+')) negativeExp = *p++ == '-';
+				int exp = 0;
+				while (p < end && *p >= '0' && *p <= '9') exp = exp * 10 + (*p++ - '0');
+				value *= std::pow(10.0, negativeExp ? -exp : exp);
+			}
+			out = float(negative ? -value : value);
+			return true;
+		}
+
+		bool ParseInt(const char *&p, const char *end, int& out) {
+			bool negative = false;
+			if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+			const char *digits = p;
+			int value = 0;
+			while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+			out = negative ? -value : value;
+			return p != digits;
+		}
+
+		bool ParseVec3(const char *&p, const char *end, Vec3& v) {
+			return ParseFloat(p, end, v.x) && ParseFloat(p, end, v.y) && ParseFloat(p, end, v.z);
+		}
+
+		/// <summary>
+		/// Converts an obj index, 1-based or negative from the last element, to a 0-based one.
+		/// </summary>
+		/// <returns> False if the index is relative and must be fixed once the previous chunks are known </returns>
+		inline bool Absolute(int& index, int count) {
+			if (index > 0) {
+				index--;
+				return true;
+			}
+			index = count + index;
+			return false;
+		}
+
+		void ParseChunk(Chunk& chunk) {
+			const char *p = chunk.begin;
+			std::vector<int> facePositions, faceNormals;
+			while (p < chunk.end) {
+				chunk.lines++;
+				const char *eol = static_cast<const char *>(std::memchr(p, '\n', chunk.end - p));
+				if (!eol) eol = chunk.end;
+				SkipSpaces(p, eol);
+
+				if (eol - p > 2 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+					Vec3 n;
+					p += 2;
+					if (!ParseVec3(p, eol, n)) { chunk.error = "invalid normal"; break; }
+					chunk.normals.push_back(n);
+				}
+				else if (eol - p > 1 && p[0] == 'v' && IsSpace(p[1])) {
+					Vec3 v;
+					p += 1;
+					// a trailing w or vertex color is ignored
+					if (!ParseVec3(p, eol, v)) { chunk.error = "invalid vertex"; break; }
+					chunk.positions.push_back(v);
+				}
+				else if (eol - p > 1 && p[0] == 'f' && IsSpace(p[1])) {
+					p += 1;
+					facePositions.clear();
+					faceNormals.clear();
+					while (true) {
+						SkipSpaces(p, eol);
+						if (p >= eol) break;
+						int v, vt, vn = 0;
+						if (!ParseInt(p, eol, v) || v == 0) { chunk.error = "invalid face"; break; }
+						if (p < eol && *p == '/') {
+							p++;
+							if (p < eol && *p != '/') ParseInt(p, eol, vt);
+							if (p < eol && *p == '/') {
+								p++;
+								if (!ParseInt(p, eol, vn) || vn == 0) { chunk.error = "invalid face"; break; }
+							}
+						}
+						facePositions.push_back(v);
+						faceNormals.push_back(vn);
+					}
+					if (chunk.error) break;
+					if (facePositions.size() < 3) { chunk.error = "face with less than three vertices"; break; }
+					for (size_t i = 1; i + 1 < facePositions.size(); i++) {
+						for (size_t k : { size_t(0), i, i + 1 }) {
+							size_t corner = chunk.corner_positions.size();
+							int v = facePositions[k], vn = faceNormals[k];
+							if (!Absolute(v, int(chunk.positions.size())))
+								chunk.position_fixups.push_back(std::make_pair(corner, v));
+							if (vn == 0)
+								vn = NO_NORMAL;
+							else if (!Absolute(vn, int(chunk.normals.size())))
+								chunk.normal_fixups.push_back(std::make_pair(corner, vn));
+							chunk.corner_positions.push_back(v);
+							chunk.corner_normals.push_back(vn);
+						}
+					}
+				}
+				// comments, vt, objects, groups, smoothing groups & materials are skipped
+				p = eol + 1;
+			}
+			if (chunk.error) chunk.error_line = chunk.lines;
+		}
+
+		/// <summary>
+		/// Area weighted average of the normals of the faces around each vertex, only for the flagged vertices.
+		/// </summary>
+		void ComputeNormals(Mesh& mesh, const std::vector<bool>& missing) {
+			for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+				uint a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+				Vec3 n = Math::Cross(mesh.vertices[b] - mesh.vertices[a], mesh.vertices[c] - mesh.vertices[a]);
+				for (uint v : { a, b, c })
+					if (missing[v]) mesh.normals[v] += n;
+			}
+			for (size_t v = 0; v < mesh.normals.size(); v++) {
+				if (!missing[v]) continue;
+				float length = Math::Length(mesh.normals[v]);
+				mesh.normals[v] = length > 0.f ? mesh.normals[v] / length : Vec3(0.f, 0.f, 1.f);
+			}
+		}
+	}
+
+	void ParallelObjLoader::Load(const std::string& path, Mesh& mesh, int threads) {
+		MappedFile file;
+		if (!file.Open(path))
+			throw std::runtime_error("cannot open obj file " + path);
+
+		/////////////////////////////////////
+		// Split at line ends & parse the chunks in parallel
+		if (threads <= 0)
+			threads = TaskSystem::Instance().Concurrency();
+		const size_t minChunkSize = 1 << 20;
+		const char *data = file.Data(), *end = data + file.Size();
+		int chunkCount = int(Math::Max(size_t(1), Math::Min(size_t(threads), file.Size() / minChunkSize)));
+		std::vector<Chunk> chunks(chunkCount);
+		const char *begin = data;
+		for (int i = 0; i < chunkCount; i++) {
+			const char *split = i + 1 == chunkCount ? end : data + file.Size() * (i + 1) / chunkCount;
+			if (split < begin) split = begin;
+			while (split < end && split[-1] != '\n') split++;
+			chunks[i].begin = begin;
+			chunks[i].end = begin = split;
+		}
+		ParallelFor(0, chunkCount, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) ParseChunk(chunks[i]);
+		}, 1);
+
+		/////////////////////////////////////
+		// Offsets of every chunk in the merged arrays
+		std::vector<size_t> positionBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+		int lineBase = 0;
+		for (int i = 0; i < chunkCount; i++) {
+			const Chunk& chunk = chunks[i];
+			if (chunk.error)
+				throw std::runtime_error(path + ":" + std::to_string(lineBase + chunk.error_line) + ": " + chunk.error);
+			lineBase += chunk.lines;
+			positionBase[i + 1] = positionBase[i] + chunk.positions.size();
+			normalBase[i + 1] = normalBase[i] + chunk.normals.size();
+			cornerBase[i + 1] = cornerBase[i] + chunk.corner_positions.size();
+		}
+		const size_t positionCount = positionBase[chunkCount], normalCount = normalBase[chunkCount];
+		const size_t cornerCount = cornerBase[chunkCount];
+		if (positionCount > size_t(INT_MAX) || cornerCount > size_t(UINT_MAX))
+			throw std::runtime_error("obj file too large: " + path);
+
+		// relative indices now point into the merged arrays, then every index is checked in parallel
+		std::vector<char> chunkSharedNormals(chunkCount, 1);
+		try {
+			ParallelFor(0, chunkCount, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					Chunk& chunk = chunks[i];
+					for (auto& fixup : chunk.position_fixups)
+						chunk.corner_positions[fixup.first] = int(positionBase[i]) + fixup.second;
+					for (auto& fixup : chunk.normal_fixups)
+						chunk.corner_normals[fixup.first] = int(normalBase[i]) + fixup.second;
+					bool sharedNormals = true;
+					for (size_t c = 0; c < chunk.corner_positions.size(); c++) {
+						int v = chunk.corner_positions[c], vn = chunk.corner_normals[c];
+						if (v < 0 || size_t(v) >= positionCount || (vn != NO_NORMAL && (vn < 0 || size_t(vn) >= normalCount)))
+							throw std::runtime_error("face index out of range");
+						sharedNormals &= (vn == v && normalCount == positionCount) || (vn == NO_NORMAL && normalCount == 0);
+					}
+					chunkSharedNormals[i] = sharedNormals;
+				}
+			}, 1);
+		}
+		catch (const std::runtime_error& ex) { throw std::runtime_error(path + ": " + ex.what()); }
+		const bool sharedNormals = std::find(chunkSharedNormals.begin(), chunkSharedNormals.end(), 0) == chunkSharedNormals.end();
+
+		/////////////////////////////////////
+		// Merge
+		mesh.vertices.resize(positionCount);
+		mesh.normals.assign(positionCount, Vec3());
+		mesh.indices.resize(cornerCount);
+		std::vector<bool> missingNormals;
+		if (sharedNormals) {
+			// vertex i uses normal i or the file has no normals at all: the chunks are copied as they are
+			ParallelFor(0, chunkCount, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					const Chunk& chunk = chunks[i];
+					std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.vertices.begin() + positionBase[i]);
+					if (normalCount > 0)
+						std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + normalBase[i]);
+					std::copy(chunk.corner_positions.begin(), chunk.corner_positions.end(), mesh.indices.begin() + cornerBase[i]);
+				}
+			}, 1);
+			if (normalCount == 0)
+				missingNormals.assign(positionCount, true);
+		}
+		else {
+			// a vertex with several normals is split, the first normal seen stays on the original vertex
+			for (int i = 0; i < chunkCount; i++)
+				std::copy(chunks[i].positions.begin(), chunks[i].positions.end(), mesh.vertices.begin() + positionBase[i]);
+			std::vector<Vec3> normals;
+			normals.reserve(normalCount);
+			for (const Chunk& chunk : chunks)
+				normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+			const int UNSET = -2;
+			std::vector<int> firstNormal(positionCount, UNSET);
+			std::unordered_map<uint64_t, uint> splits;
+			size_t corner = 0;
+			for (const Chunk& chunk : chunks) {
+				for (size_t c = 0; c < chunk.corner_positions.size(); c++, corner++) {
+					int v = chunk.corner_positions[c], vn = chunk.corner_normals[c];
+					uint index = uint(v);
+					if (firstNormal[v] == UNSET) {
+						firstNormal[v] = vn;
+					}
+					else if (firstNormal[v] != vn) {
+						uint64_t key = uint64_t(uint(v)) << 32 | uint(vn);
+						auto it = splits.find(key);
+						if (it == splits.end()) {
+							it = splits.emplace(key, uint(mesh.vertices.size())).first;
+							mesh.vertices.push_back(mesh.vertices[v]);
+							firstNormal.push_back(vn);
+						}
+						index = it->second;
+					}
+					mesh.indices[corner] = index;
+				}
+			}
+			mesh.normals.resize(mesh.vertices.size());
+			missingNormals.assign(mesh.vertices.size(), false);
+			for (size_t v = 0; v < mesh.vertices.size(); v++) {
+				if (firstNormal[v] >= 0) mesh.normals[v] = normals[firstNormal[v]];
+				else missingNormals[v] = true;
+			}
+		}
+		if (!missingNormals.empty())
+			ComputeNormals(mesh, missingNormals);
+	}
+}
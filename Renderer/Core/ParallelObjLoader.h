@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+namespace TX {
+	class Mesh;
+
+	/// <summary>
+	/// Loads the geometry of an obj file into a single mesh, using all the cores.
+	/// The file is memory mapped and split into line-aligned chunks which are parsed in parallel,
+	/// the chunks are then merged straight into the arrays of the mesh.
+	/// Objects, groups and materials are ignored, faces are triangulated as fans,
+	/// texture coordinates are skipped and missing normals are computed by averaging the adjacent faces.
+	/// </summary>
+	class ParallelObjLoader {
+	public:
+		/// <summary>
+		/// Throws a std::runtime_error if the file can't be read or is invalid.
+		/// </summary>
+		/// <param name="threads"> Number of chunks parsed at the same time, 0 for one per core </param>
+		static void Load(const std::string& path, Mesh& mesh, int threads = 0);
+	};
+}
@@ -5,10 +5,18 @@
 
 namespace TX {
 	Primitive& Primitive::Bake() {
+		return BakeTransform().BakeSampler();
+	}
+
+	Primitive& Primitive::BakeTransform() {
 		mesh->ApplyTransform(transform);
 		transform = Transform();
+		return *this;
+	}
+
+	Primitive& Primitive::BakeSampler() {
 		if (areaLight) {
-			meshSampler = std::make_unique<MeshSampler>(mesh);
+			meshSampler = std::make_unique<EmitterSampler>(*mesh);
 		}
 		return *this;
 	}
@@ -2,6 +2,7 @@
 
 #include "SceneObject.h"
 #include "SceneMesh.h"
+#include "EmitterSampler.h"
 
 namespace TX {
 	class BSDF;
@@ -25,6 +26,14 @@ namespace TX {
 		/// - Generate mesh sampler if this is a light source
 		/// </summary>
 		Primitive& Bake();
+		/// <summary>
+		/// First step of Bake(), applies the transform to the local copy of the mesh.
+		/// </summary>
+		Primitive& BakeTransform();
+		/// <summary>
+		/// Second step of Bake(), generates the mesh sampler if this is a light source.
+		/// </summary>
+		Primitive& BakeSampler();
 
 		/// <summary>
 		/// Extracts info to the LocalGeo.
@@ -38,13 +47,15 @@ namespace TX {
 
 		inline float Pdf(uint surfaceTriId, const Vec3& eye, const Vec3& dir) const {
 			assert(meshSampler);
-			Ray ray(eye, dir);
-			return meshSampler->Pdf(surfaceTriId, ray);
+			return meshSampler->Pdf(surfaceTriId, eye, dir);
 		}
 
-		inline void SamplePoint(const Sample *sample, Vec3 *point, uint *triId, Vec3 *normal) const {
+		/// <summary>
+		/// Samples a point of the mesh for a shading point at eye, see EmitterSampler.
+		/// </summary>
+		inline void SamplePoint(const Sample *sample, const Vec3& eye, Vec3 *point, uint *triId, Vec3 *normal) const {
 			assert(meshSampler);
-			meshSampler->SamplePoint(sample, point, triId, normal);
+			meshSampler->SamplePoint(sample, eye, point, triId, normal);
 		}
 	private:
 		std::shared_ptr<const BSDF>		bsdf;
@@ -54,7 +65,7 @@ namespace TX {
 		/// If this primitive is associated with an area light,
 		/// then the mesh sampler should be created for the underlying mesh
 		/// </summary>
-		std::unique_ptr<MeshSampler>	meshSampler;
+		std::unique_ptr<EmitterSampler>	meshSampler;
 		const AreaLight *				areaLight;
 	};
 }
@@ -12,13 +12,27 @@ namespace TX
 		virtual ~PrimitiveManager(){}
 
 		inline void Construct(const std::vector<std::shared_ptr<Primitive>>& prims) {
-			prims_ = &prims;
+			BeginConstruct(prims);
+			for (uint i = 0; i < prims.size(); i++)
+				PrimitiveReady(i);
 			Build();
 		}
+		/// <summary>
+		/// Staged construction, lets the per primitive work overlap with baking:
+		/// BeginConstruct() once, PrimitiveReady() from any thread as soon as a primitive is baked, then Build().
+		/// The number of triangles & vertices of the primitives must not change once it started.
+		/// </summary>
+		inline void BeginConstruct(const std::vector<std::shared_ptr<Primitive>>& prims) {
+			prims_ = &prims;
+			Prepare();
+		}
+		virtual void PrimitiveReady(uint primId) {}
+		virtual void Build() = 0;
+
 		virtual bool Intersect(const Ray& ray, Intersection& intxn) const = 0;
 		virtual bool Occlude(const Ray& ray) const = 0;
 	protected:
-		virtual void Build() = 0;
+		virtual void Prepare() {}
 	protected:
 		const std::vector<std::shared_ptr<Primitive>> *prims_;
 	};
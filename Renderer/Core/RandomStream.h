@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <emmintrin.h>
+
+namespace TX {
+	/// <summary>
+	/// Small seedable generator with independent sequences, cheap enough to be reseeded for every pixel sample.
+	/// Four xoshiro128+ generators run side by side in SSE registers and refill a small buffer of
+	/// sixteen numbers at a time, Float() &amp; UInt() only read from the buffer.
+	/// The state is expanded from the seed on the first draw, streams nobody draws from cost nothing.
+	/// </summary>
+	class RandomStream {
+	public:
+		RandomStream(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t sequence = 0) { Seed(seed, sequence); }
+
+		/// <summary>
+		/// Restarts the generator, streams of different sequences are uncorrelated.
+		/// </summary>
+		inline void Seed(uint64_t seed, uint64_t sequence = 0) {
+			seed_ = seed;
+			sequence_ = sequence;
+			expanded_ = false;
+			next_ = BUFFER_SIZE;
+		}
+
+		inline uint32_t UInt() {
+			if (next_ == BUFFER_SIZE)
+				Refill();
+			return buffer_[next_++];
+		}
+
+		/// <summary>
+		/// Uniform float in [0, 1).
+		/// </summary>
+		inline float Float() {
+			return (UInt() >> 8) * (1.f / 16777216.f);
+		}
+
+		/// <summary>
+		/// Moves every lane 2^64 steps ahead, the streams obtained by jumping the same seed
+		/// 0, 1, 2... times never overlap, whatever thread draws from them.
+		/// </summary>
+		inline void Jump() {
+			if (!expanded_)
+				Expand();
+			static const uint32_t JUMP[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+			__m128i s[4], j[4];
+			Load(s);
+			j[0] = j[1] = j[2] = j[3] = _mm_setzero_si128();
+			for (int i = 0; i < 4; i++) {
+				for (int b = 0; b < 32; b++) {
+					if (JUMP[i] & (1u << b)) {
+						j[0] = _mm_xor_si128(j[0], s[0]);
+						j[1] = _mm_xor_si128(j[1], s[1]);
+						j[2] = _mm_xor_si128(j[2], s[2]);
+						j[3] = _mm_xor_si128(j[3], s[3]);
+					}
+					Step(s);
+				}
+			}
+			Store(j);
+			next_ = BUFFER_SIZE;
+		}
+
+		/// <summary>
+		/// Scrambles the bits of a key (splitmix64 finalizer), used to derive seeds.
+		/// </summary>
+		static inline uint64_t Hash(uint64_t v) {
+			v ^= v >> 30;
+			v *= 0xbf58476d1ce4e5b9ULL;
+			v ^= v >> 27;
+			v *= 0x94d049bb133111ebULL;
+			v ^= v >> 31;
+			return v;
+		}
+
+		/// <summary>
+		/// Seed of a pixel, which only depends on its coordinates and the seed of the render.
+		/// </summary>
+		static inline uint64_t PixelSeed(int x, int y, uint64_t seed = 0) {
+			return Hash((uint64_t(uint32_t(y)) << 32 | uint32_t(x)) ^ Hash(seed));
+		}
+	private:
+		/// <summary>
+		/// One step of the four generators, s[j] holds the word j of the four states.
+		/// </summary>
+		static inline void Step(__m128i s[4]) {
+			__m128i t = _mm_slli_epi32(s[1], 9);
+			s[2] = _mm_xor_si128(s[2], s[0]);
+			s[3] = _mm_xor_si128(s[3], s[1]);
+			s[1] = _mm_xor_si128(s[1], s[2]);
+			s[0] = _mm_xor_si128(s[0], s[3]);
+			s[2] = _mm_xor_si128(s[2], t);
+			s[3] = _mm_or_si128(_mm_slli_epi32(s[3], 11), _mm_srli_epi32(s[3], 21));
+		}
+
+		// the stream lives in vectors & heap blocks that are only 8-byte aligned on 32-bit Windows,
+		// the state is kept as plain words and only moved through unaligned loads & stores
+		inline void Load(__m128i s[4]) const {
+			for (int j = 0; j < 4; j++)
+				s[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state_ + 4 * j));
+		}
+		inline void Store(const __m128i s[4]) {
+			for (int j = 0; j < 4; j++)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(state_ + 4 * j), s[j]);
+		}
+
+		/// <summary>
+		/// Fills the four states from the seed with splitmix64.
+		/// </summary>
+		inline void Expand() {
+			const uint64_t x = seed_ ^ Hash(sequence_ + 0x9e3779b97f4a7c15ULL);
+			__m128i s[4];
+			for (int j = 0; j < 4; j++) {
+				uint64_t lo = Hash(x + (2 * j + 1) * 0x9e3779b97f4a7c15ULL);
+				uint64_t hi = Hash(x + (2 * j + 2) * 0x9e3779b97f4a7c15ULL);
+				s[j] = _mm_set_epi64x(int64_t(hi), int64_t(lo));
+			}
+			Store(s);
+			expanded_ = true;
+		}
+
+		inline void Refill() {
+			if (!expanded_)
+				Expand();
+			__m128i s[4];
+			Load(s);
+			for (int i = 0; i < BUFFER_SIZE; i += 4) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(buffer_ + i), _mm_add_epi32(s[0], s[3]));
+				Step(s);
+			}
+			Store(s);
+			next_ = 0;
+		}
+	private:
+		static const int BUFFER_SIZE = 16;
+		uint32_t state_[16];		// word j of lane i at 4 * j + i
+		uint32_t buffer_[BUFFER_SIZE];
+		int next_;
+		bool expanded_;
+		uint64_t seed_, sequence_;
+	};
+}
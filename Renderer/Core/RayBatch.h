@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "txbase/math/color.h"
+#include "txbase/math/ray.h"
+#include "Core/Sampler.h"
+
+namespace TX
+{
+	/// <summary>
+	/// Tells whether the render some work belongs to has been canceled, cheap enough to be polled per path:
+	/// either the epoch of the renderer moved on, or the canceled flag of a job has been set.
+	/// The default one is never canceled.
+	/// </summary>
+	class CancelToken {
+	public:
+		CancelToken() : epoch_(nullptr), running_(0), flag_(nullptr) {}
+		CancelToken(const std::atomic<uint>& epoch, uint running) : epoch_(&epoch), running_(running), flag_(nullptr) {}
+		explicit CancelToken(const std::atomic<bool>& flag) : epoch_(nullptr), running_(0), flag_(&flag) {}
+
+		inline bool Canceled() const {
+			return (epoch_ && epoch_->load(std::memory_order_relaxed) != running_) ||
+				(flag_ && flag_->load(std::memory_order_relaxed));
+		}
+	private:
+		const std::atomic<uint> *epoch_;
+		uint running_;
+		const std::atomic<bool> *flag_;
+	};
+
+	/// <summary>
+	/// Camera rays of a tile traced together by the tracers working on batches of paths.
+	/// The path i uses the random stream (Seed(i), Sequence(i)) and its radiance ends up in GetColor(i).
+	/// Owned by a render worker &amp; reused for all its tiles, the buffers only grow.
+	/// </summary>
+	class RayBatch {
+	public:
+		RayBatch() : size_(0) {}
+
+		inline void Clear() { size_ = 0; }
+		inline int Size() const { return size_; }
+
+		/// <summary>
+		/// Appends a path, the pixel sample &amp; ray are filled in by the caller.
+		/// </summary>
+		/// <returns> Index of the path </returns>
+		int Add(int x, int y, uint64_t seed, uint64_t sequence) {
+			if (size_ == int(samples_.size())) {
+				samples_.emplace_back();
+				rays_.emplace_back();
+				colors_.emplace_back();
+				pixels_.emplace_back();
+				seeds_.emplace_back();
+			}
+			pixels_[size_] = Pixel{ x, y };
+			seeds_[size_] = Stream{ seed, sequence };
+			return size_++;
+		}
+
+		inline PixelSample& Samples(int i) { return samples_[i]; }
+		inline const PixelSample& Samples(int i) const { return samples_[i]; }
+		inline Ray& GetRay(int i) { return rays_[i]; }
+		inline const Ray& GetRay(int i) const { return rays_[i]; }
+		inline Color& GetColor(int i) { return colors_[i]; }
+		inline int X(int i) const { return pixels_[i].x; }
+		inline int Y(int i) const { return pixels_[i].y; }
+		inline uint64_t Seed(int i) const { return seeds_[i].seed; }
+		inline uint64_t Sequence(int i) const { return seeds_[i].sequence; }
+
+		/// <summary>
+		/// Tracers poll it between paths or stages and give up on a canceled batch, whose colors are then meaningless.
+		/// </summary>
+		inline void SetCancel(const CancelToken& cancel) { cancel_ = cancel; }
+		inline const CancelToken& Cancel() const { return cancel_; }
+		inline bool Canceled() const { return cancel_.Canceled(); }
+	private:
+		struct Pixel { int x, y; };
+		struct Stream { uint64_t seed, sequence; };
+
+		int size_;
+		CancelToken cancel_;
+		std::vector<PixelSample> samples_;
+		std::vector<Ray> rays_;
+		std::vector<Color> colors_;
+		std::vector<Pixel> pixels_;
+		std::vector<Stream> seeds_;
+	};
+}
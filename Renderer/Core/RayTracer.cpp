@@ -5,13 +5,23 @@
 #include "Scene.h"
 #include "Intersection.h"
 #include "BSDF.h"
+#include "Accelerators/LightBVH.h"
 
 namespace TX
 {
-	void RayTracer::Trace(const Scene *scene, const Ray& ray, const CameraSample& samples, RNG& rng, Color *color)
+	void RayTracer::Trace(const Scene *scene, const Ray& ray, PixelSample& sample, RandomStream& rng, Color *color)
 	{
 		rng_ = &rng;
-		*color = Li(scene, ray, maxdepth_, samples);
+		*color = Li(scene, ray, maxdepth_, sample);
+	}
+
+	void RayTracer::Trace(const Scene *scene, RayBatch& batch)
+	{
+		RandomStream rng;
+		for (int i = 0; i < batch.Size() && !batch.Canceled(); i++) {
+			rng.Seed(batch.Seed(i), batch.Sequence(i));
+			Trace(scene, batch.GetRay(i), batch.Samples(i), rng, &batch.GetColor(i));
+		}
 	}
 
 	Color RayTracer::EstimateDirect(const Scene *scene, const Ray& ray, const LocalGeo& geom, const Light *light, const Sample *lightsample, const Sample *bsdfsample){
@@ -58,7 +68,54 @@ namespace TX
 		return color;
 	}
 
-	Color RayTracer::TraceSpecularReflect(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, const CameraSample& samplebuf){
+	Color RayTracer::SampleOneLight(const Scene *scene, const Ray& ray, const LocalGeo& geom, const Sample *lightsample, const Sample *bsdfsample){
+		const LightBVH& lights = scene->GetLightBVH();
+		float pick_pmf;
+		Sample sample = *lightsample;
+		const Light *light = lights.Sample(geom.point, geom.normal, lightsample->w, &pick_pmf, &sample.w);
+		if (!light)
+			return Color::BLACK;
+
+		Vec3 wo = -ray.dir;		// dir to camera
+		Ray lightray;
+		float light_pdf, bsdf_pdf;
+		Color color, lightcolor, surfacecolor;
+
+		// sample the picked light with multiple importance sampling
+		light->SampleDirect(geom.point, &sample, &lightray, &lightcolor, &light_pdf);
+		if (light_pdf > 0.f && lightcolor != Color::BLACK){
+			surfacecolor = geom.bsdf->Eval(lightray.dir, wo, geom, BSDFType(BSDF_ALL & ~BSDF_SPECULAR));
+			if (surfacecolor != Color::BLACK && !scene->Occlude(lightray)){
+				if (light->IsDelta())
+					color = surfacecolor * lightcolor * (Math::AbsDot(lightray.dir, geom.normal) / pick_pmf);
+				else{
+					light_pdf *= pick_pmf;
+					bsdf_pdf = geom.bsdf->Pdf(wo, lightray.dir, geom);
+					color = surfacecolor * lightcolor * (Math::AbsDot(lightray.dir, geom.normal) / light_pdf * PowerHeuristic(1, light_pdf, 1, bsdf_pdf));
+				}
+			}
+		}
+
+		// sample bsdf with multiple importance sampling, counts for whichever area light it hits
+		Vec3 wi;
+		surfacecolor = geom.bsdf->SampleDirect(wo, geom, *bsdfsample, &wi, &bsdf_pdf, BSDFType(BSDF_ALL & ~BSDF_SPECULAR));
+		if (bsdf_pdf > 0.f && surfacecolor != Color::BLACK){
+			Ray bsdfray(geom.point, wi);
+			LocalGeo geom_light;
+			if (scene->Intersect(bsdfray, geom_light) && geom_light.prim->GetAreaLight()){
+				scene->PostIntersect(bsdfray, geom_light);
+				geom_light.Emit(-wi, &lightcolor);
+				if (lightcolor != Color::BLACK){
+					light_pdf = geom_light.prim->Pdf(geom_light.triId, geom.point, wi) *
+						lights.Pmf(geom.point, geom.normal, geom_light.prim->GetAreaLight());
+					color += surfacecolor * lightcolor * (Math::AbsDot(wi, geom.normal) / bsdf_pdf * PowerHeuristic(1, bsdf_pdf, 1, light_pdf));
+				}
+			}
+		}
+		return color;
+	}
+
+	Color RayTracer::TraceSpecularReflect(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, PixelSample& sample){
 		Vec3 wo = -ray.dir, wi;
 		float pdf;
 		Color color;
@@ -67,12 +124,12 @@ namespace TX
 		if (pdf > 0.f && f != Color::BLACK && absdot_wi_n != 0.f){
 			Ray reflected(geom.point, wi);
 			// TODO differential
-			color = f * Li(scene, reflected, depth, samplebuf) *absdot_wi_n / pdf;
+			color = f * Li(scene, reflected, depth, sample) *absdot_wi_n / pdf;
 		}
 		return color;
 	}
 
-	Color RayTracer::TraceSpecularTransmit(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, const CameraSample& samplebuf){
+	Color RayTracer::TraceSpecularTransmit(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, PixelSample& sample){
 		Vec3 wo = -ray.dir, wi;
 		float pdf;
 		Color color;
@@ -81,7 +138,7 @@ namespace TX
 		if (pdf > 0.f && f != Color::BLACK && absdot_wi_n != 0.f){
 			Ray refracted(geom.point, wi);
 			//TODO differential
-			color = f * Li(scene, refracted, depth, samplebuf) * absdot_wi_n / pdf;
+			color = f * Li(scene, refracted, depth, sample) * absdot_wi_n / pdf;
 		}
 		return color;
 	}
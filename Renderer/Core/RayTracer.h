@@ -2,6 +2,9 @@
 
 #include "txbase/math/color.h"
 #include "Core/Scene.h"
+#include "Core/RandomStream.h"
+#include "Core/RayBatch.h"
+#include "Core/Sampler.h"
 
 namespace TX{
 	class RayTracer {
@@ -9,18 +12,41 @@ namespace TX{
 		RayTracer(int maxdepth = 5) : maxdepth_(maxdepth){}
 		virtual ~RayTracer(){}
 
-		void Trace(const Scene *scene, const Ray& ray, const CameraSample& samples, RNG& rng, Color *color);
-
-		// Pick necessary samples from current sample buffer for future use
-		virtual void BakeSamples(const Scene *scene, const CameraSample *samples) = 0;
+		/// <summary>
+		/// Traces one path, its sample dimensions are taken from the pixel sample as needed.
+		/// </summary>
+		void Trace(const Scene *scene, const Ray& ray, PixelSample& sample, RandomStream& rng, Color *color);
+		/// <summary>
+		/// Trace() for loops specialized on the class of the tracer: with T final, Li() is bound at compile time.
+		/// With T = RayTracer it is the usual virtual call.
+		/// </summary>
+		template<typename T>
+		static inline void TraceAs(T& tracer, const Scene *scene, const Ray& ray, PixelSample& sample, RandomStream& rng, Color *color) {
+			tracer.rng_ = &rng;
+			*color = tracer.Li(scene, ray, tracer.maxdepth_, sample);
+		}
+		/// <summary>
+		/// Traces all the paths of the batch, by default one after another.
+		/// Returns early once the batch is canceled.
+		/// </summary>
+		virtual void Trace(const Scene *scene, RayBatch& batch);
+		/// <summary>
+		/// Whether the tracer gains anything from getting whole tiles through the batch version of Trace().
+		/// </summary>
+		virtual bool Batched() const { return false; }
 	protected:
 		// The recursive tracing function
-		virtual Color Li(const Scene *scene, const Ray& ray, int depth, const CameraSample& samplebuf) = 0;
+		virtual Color Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample) = 0;
 		Color EstimateDirect(const Scene *scene, const Ray& ray, const LocalGeo& geom, const Light *light, const Sample *lightsample, const Sample *bsdfsample);
-		Color TraceSpecularReflect(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, const CameraSample& samplebuf);
-		Color TraceSpecularTransmit(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, const CameraSample& samplebuf);
+		/// <summary>
+		/// Direct lighting from one light picked by the light BVH of the scene, divided by the probability of the pick.
+		/// The light sample is weighted against BSDF samples hitting any area light, with the pick included in the light pdfs.
+		/// </summary>
+		Color SampleOneLight(const Scene *scene, const Ray& ray, const LocalGeo& geom, const Sample *lightsample, const Sample *bsdfsample);
+		Color TraceSpecularReflect(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, PixelSample& sample);
+		Color TraceSpecularTransmit(const Scene *scene, const Ray& ray, const LocalGeo& geom, int depth, PixelSample& sample);
 	protected:
 		const int maxdepth_;
-		RNG *rng_;
+		RandomStream *rng_;
 	};
 }
@@ -0,0 +1,336 @@
+#include "stdafx.h"
+
+#include "txbase/image/film.h"
+#include "txbase/math/sample.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#include "RenderQueue.h"
+#include "RayTracer.h"
+#include "Sampler.h"
+#include "TileKernel.h"
+#include "Core/Scene.h"
+
+namespace TX {
+	RenderJob::RenderJob(uint id, const Transform& view, const RendererConfig& config, Film& film, int priority,
+		IProgressMonitor *monitor, TileCallback onTile)
+		: id_(id), priority_(priority), config_(config), camera_(config.width, config.height), film_(film), monitor_(monitor), on_tile_(onTile),
+		pass_(config.first_pass), tiles_done_(0), in_flight_(0), canceled_(false), done_(false), version_(0), samples_(0), passes_done_(config.first_pass), resolved_version_(0),
+		start_(std::chrono::steady_clock::now()) {
+		camera_.transform = view;
+		camera_.transform.UpdateMatrix();
+		if (film_.Width() != config.width || film_.Height() != config.height)
+			film_.Resize(config.width, config.height);
+		film_.Clear();
+		accum_.Resize(config.width, config.height);
+		accum_.Clear();
+		// the job goes on without it if the segment can't be created
+		if (!config.shared_film.empty() &&
+			shared_film_.Create(config.shared_film, config.width, config.height,
+				config.shared_film_raw ? SharedFilmHeader::Accumulation : SharedFilmHeader::Resolved))
+			shared_film_.SetFrame(0, 0, config.width, config.height);
+		tiles_.Init(config.width, config.height, config.tile_size, config.tile_order, config.pixel_order,
+			config.crop.Clip(config.width, config.height), config.priority_regions);
+		tile_count_ = tiles_.TileCount();
+		if (monitor_) monitor_->Reset(float(Math::Max(0, config.samples_per_pixel - config.first_pass) * tile_count_));
+	}
+
+	bool RenderJob::Done() const {
+		std::lock_guard<std::mutex> lock(done_lock_);
+		return done_;
+	}
+
+	void RenderJob::Wait() {
+		std::unique_lock<std::mutex> lock(done_lock_);
+		done_changed_.wait(lock, [this] { return done_; });
+	}
+
+	float RenderJob::Progress() const {
+		int passes = config_.samples_per_pixel - config_.first_pass;
+		if (passes <= 0 || tile_count_ == 0) return 1.f;
+		return Math::Min(1.f, float(version_) / (float(passes) * tile_count_));
+	}
+
+	float RenderJob::ElapsedTime() const {
+		std::lock_guard<std::mutex> lock(done_lock_);
+		auto end = done_ ? end_ : std::chrono::steady_clock::now();
+		return std::chrono::duration<float>(end - start_).count();
+	}
+
+	bool RenderJob::Resolve() {
+		return Resolve(false);
+	}
+
+	bool RenderJob::Resolve(bool force) {
+		LockGuard scope(resolve_lock_);
+		uint version = version_;
+		if (!force && version == resolved_version_)
+			return false;
+		resolved_version_ = version;
+		accum_.Resolve(film_.Pixels(), 0, accum_.Height());
+		if (shared_film_.Valid()) {
+			static_assert(sizeof(Accumulator::Pixel) == sizeof(Color), "both kinds of pixels share the layout of the segment");
+			const size_t size = size_t(accum_.Width()) * accum_.Height() * sizeof(Color);
+			Color *shared = shared_film_.BeginWrite();
+			if (shared_film_.Content() == SharedFilmHeader::Accumulation)
+				std::memcpy(shared, accum_.Pixels(), size);
+			else
+				std::memcpy(shared, film_.Pixels(), size);
+			shared_film_.EndWrite(passes_done_);
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Tracers &amp; samplers of a task slot for the jobs it has rendered tiles of, kept from one task to the next.
+	/// </summary>
+	struct RenderQueue::WorkerState {
+		struct Prepared {
+			std::shared_ptr<RenderJob> job;
+			std::unique_ptr<RayTracer> tracer;
+			std::unique_ptr<Sampler> sampler;
+			TileKernel kernel;
+		};
+		std::vector<Prepared> prepared;
+		RandomStream random;
+		RayBatch batch;
+
+		Prepared& Get(const std::shared_ptr<RenderJob>& job, const Scene& scene) {
+			prepared.erase(std::remove_if(prepared.begin(), prepared.end(), [](const Prepared& p) { return p.job->Done(); }), prepared.end());
+			for (auto& p : prepared)
+				if (p.job == job) return p;
+			Prepared p;
+			p.job = job;
+			p.tracer.reset(job->config_.NewMethod());
+			p.sampler.reset(job->config_.NewSampler());
+			p.kernel = SelectTileKernel(job->config_);
+			prepared.push_back(std::move(p));
+			return prepared.back();
+		}
+	};
+
+	RenderQueue::RenderQueue(const Scene& scene, int threads)
+		: scene_(scene), running_tasks_(0), next_id_(0), unfinished_(0), shutdown_(false) {
+		// the threads submitting & polling the jobs don't render, unless they wait for all of them
+		if (threads <= 0)
+			threads = Math::Max(1, TaskSystem::Instance().Concurrency() - 1);
+		for (int i = 0; i < threads; i++) {
+			states_.push_back(std::unique_ptr<WorkerState>(new WorkerState));
+			idle_states_.push_back(states_.back().get());
+		}
+	}
+
+	RenderQueue::~RenderQueue() {
+		std::vector<std::shared_ptr<RenderJob>> idle;
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			shutdown_ = true;
+			for (auto& job : jobs_) {
+				job->canceled_ = true;
+				if (job->in_flight_ == 0) idle.push_back(job);
+			}
+			jobs_.clear();
+		}
+		changed_.notify_all();
+		for (auto& job : idle) Finish(*job);
+		// the running tasks stop after their current tile.
+		// an error of a task can't leave a destructor, nobody waited for it
+		try {
+			tasks_.Wait();
+		}
+		catch (const std::exception& ex) {
+			std::fprintf(stderr, "RenderQueue: a render task failed: %s\n", ex.what());
+		}
+		catch (...) {
+			std::fprintf(stderr, "RenderQueue: a render task failed\n");
+		}
+	}
+
+	std::shared_ptr<RenderJob> RenderQueue::Submit(const Transform& view, const RendererConfig& config, Film& film, int priority,
+		IProgressMonitor *monitor, RenderJob::TileCallback onTile) {
+		uint id;
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			id = next_id_++;
+		}
+		auto job = std::make_shared<RenderJob>(id, view, config, film, priority, monitor, onTile);
+		bool empty = job->pass_ >= config.samples_per_pixel || job->tile_count_ == 0;
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			unfinished_++;
+			if (!empty && !shutdown_) {
+				jobs_.push_back(job);
+				Spawn();
+			}
+			else
+				job->canceled_ = shutdown_;
+		}
+		if (empty || job->canceled_)
+			Finish(*job);
+		return job;
+	}
+
+	void RenderQueue::Cancel(const std::shared_ptr<RenderJob>& job) {
+		bool idle;
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			auto it = std::find(jobs_.begin(), jobs_.end(), job);
+			if (it == jobs_.end()) return;		// already over
+			jobs_.erase(it);
+			job->canceled_ = true;
+			idle = job->in_flight_ == 0;
+		}
+		// otherwise the last worker rendering a tile of the job finishes it
+		if (idle) Finish(*job);
+	}
+
+	void RenderQueue::WaitAll() {
+		tasks_.Wait();
+		// jobs that were empty or canceled before any tile are finished by the thread that submitted or canceled them
+		std::unique_lock<std::mutex> lock(lock_);
+		changed_.wait(lock, [this] { return unfinished_ == 0; });
+	}
+
+	void RenderQueue::Spawn() {
+		while (running_tasks_ < int(states_.size())) {
+			running_tasks_++;
+			tasks_.Run([this] { Work(); });
+		}
+	}
+
+	void RenderQueue::Work() {
+		WorkerState *state = nullptr;
+		RenderTile *tile = nullptr;
+		int pass = 0;
+		while (true) {
+			std::shared_ptr<RenderJob> job;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				if (!state) {
+					state = idle_states_.back();
+					idle_states_.pop_back();
+				}
+				if (!shutdown_)
+					job = NextTile(tile, pass);
+				// the next pass or job starts new tasks
+				if (!job) {
+					idle_states_.push_back(state);
+					running_tasks_--;
+					return;
+				}
+			}
+
+			WorkerState::Prepared& p = state->Get(job, scene_);
+			TilePass tilePass;
+			tilePass.scene = &scene_;
+			tilePass.camera = &job->camera_;
+			tilePass.tracer = p.tracer.get();
+			tilePass.sampler = p.sampler.get();
+			tilePass.offsets = &job->tiles_.PixelOffsets();
+			tilePass.random = &state->random;
+			tilePass.batch = &state->batch;
+			tilePass.accum = &job->accum_;
+			tilePass.film_x = tilePass.film_y = 0;
+			tilePass.seed = job->config_.seed;
+			tilePass.pass = pass;
+			tilePass.cancel = CancelToken(job->canceled_);
+			int samples = p.kernel(tilePass, *tile);
+			job->samples_ += samples;
+			if (!job->canceled_) {
+				if (job->monitor_) job->monitor_->UpdateInc();
+				if (job->on_tile_) job->on_tile_(*job, *tile, pass);
+			}
+
+			bool over, publish = false;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				over = EndTile(*job, publish);
+			}
+			if (publish) {
+				// nobody renders the job until the next pass starts, the readers get a whole pass
+				job->Resolve(true);
+				std::lock_guard<std::mutex> lock(lock_);
+				over = EndPublish(*job);
+			}
+			if (over) Finish(*job);
+		}
+	}
+
+	std::shared_ptr<RenderJob> RenderQueue::NextTile(RenderTile*& tile, int& pass) {
+		if (jobs_.empty()) return nullptr;
+		// higher priority first, then the jobs that are behind, then the oldest
+		std::vector<RenderJob*> order;
+		order.reserve(jobs_.size());
+		for (auto& job : jobs_) order.push_back(job.get());
+		std::sort(order.begin(), order.end(), [](const RenderJob *a, const RenderJob *b) {
+			if (a->priority_ != b->priority_) return a->priority_ > b->priority_;
+			if (a->pass_ != b->pass_) return a->pass_ < b->pass_;
+			return a->id_ < b->id_;
+		});
+		for (RenderJob *job : order) {
+			// a job whose pass is fully handed out waits for its last tiles, the next job fills the gap
+			if (job->tiles_.NextTile(tile)) {
+				job->in_flight_++;
+				pass = job->pass_;
+				for (auto& shared : jobs_)
+					if (shared.get() == job) return shared;
+			}
+		}
+		return nullptr;
+	}
+
+	bool RenderQueue::EndTile(RenderJob& job, bool& publish) {
+		job.in_flight_--;
+		job.version_++;
+		if (job.canceled_)
+			return job.in_flight_ == 0;
+		if (++job.tiles_done_ < job.tile_count_)
+			return false;
+		// last tile of the pass, nobody is rendering this job now
+		job.tiles_done_ = 0;
+		job.pass_++;
+		job.passes_done_ = job.pass_;
+		if (job.pass_ < job.config_.samples_per_pixel) {
+			if (job.shared_film_.Valid()) {
+				// the job can't be finished while the caller publishes the pass
+				job.in_flight_++;
+				publish = true;
+				return false;
+			}
+			job.tiles_.ResetTiles();
+			Spawn();
+			return false;
+		}
+		jobs_.erase(std::find_if(jobs_.begin(), jobs_.end(), [&job](const std::shared_ptr<RenderJob>& j) { return j.get() == &job; }));
+		return true;
+	}
+
+	bool RenderQueue::EndPublish(RenderJob& job) {
+		job.in_flight_--;
+		if (job.canceled_)
+			return job.in_flight_ == 0;
+		job.tiles_.ResetTiles();
+		Spawn();
+		return false;
+	}
+
+	void RenderQueue::Finish(RenderJob& job) {
+		// the readers of the shared film get the final count of passes even if the pixels were up to date
+		job.Resolve(true);
+		if (job.monitor_) job.monitor_->Finish();
+		{
+			std::lock_guard<std::mutex> lock(job.done_lock_);
+			job.done_ = true;
+			job.end_ = std::chrono::steady_clock::now();
+		}
+		job.done_changed_.notify_all();
+		{
+			std::lock_guard<std::mutex> lock(lock_);
+			unfinished_--;
+		}
+		changed_.notify_all();
+	}
+}
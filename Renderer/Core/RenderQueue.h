@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "txbase/scene/camera.h"
+#include "Synchronizer.h"
+#include "RendererConfig.h"
+#include "Accumulator.h"
+#include "SharedFilm.h"
+#include "TaskSystem.h"
+
+namespace TX {
+	class RenderQueue;
+
+	/// <summary>
+	/// One render submitted to a RenderQueue: its own camera, config and film, sharing the scene of the queue.
+	/// Samples are the same as the ones of a Renderer with the same config.
+	/// The film is published to the shared memory segment of the config if any, whole passes at a time;
+	/// jobs configured with the same name replace each other's segment.
+	/// </summary>
+	class RenderJob {
+		friend class RenderQueue;
+	public:
+		/// <summary>
+		/// Called by the worker that rendered the tile, right after its samples are committed.
+		/// </summary>
+		typedef std::function<void(const RenderJob& job, const RenderTile& tile, int pass)> TileCallback;
+
+		RenderJob(uint id, const Transform& view, const RendererConfig& config, Film& film, int priority,
+			IProgressMonitor *monitor = nullptr, TileCallback onTile = nullptr);
+
+		inline uint Id() const { return id_; }
+		inline int Priority() const { return priority_; }
+		inline const RendererConfig& Config() const { return config_; }
+		inline const Camera& View() const { return camera_; }
+
+		/// <summary>
+		/// Whether the job is finished or canceled, in which case no worker touches it anymore.
+		/// </summary>
+		bool Done() const;
+		inline bool Canceled() const { return canceled_; }
+		/// <summary>
+		/// Blocks until the job is finished or canceled.
+		/// </summary>
+		void Wait();
+		/// <summary>
+		/// Fraction of the tiles of all the passes rendered so far.
+		/// </summary>
+		float Progress() const;
+		/// <summary>
+		/// Number of camera samples traced so far, one primary ray each.
+		/// </summary>
+		inline uint64_t Samples() const { return samples_; }
+		/// <summary>
+		/// Seconds since the job has been submitted, until it's done.
+		/// </summary>
+		float ElapsedTime() const;
+		/// <summary>
+		/// Number of tiles finished, changes whenever the accumulated samples do.
+		/// </summary>
+		inline uint Version() const { return version_; }
+		/// <summary>
+		/// Normalizes the accumulated samples into the film &amp; the shared film, does nothing if no tile has been finished since the last call.
+		/// Called by the queue at the end of every pass when the film is shared, and when the job is done.
+		/// </summary>
+		/// <returns> Whether the film has been updated </returns>
+		bool Resolve();
+	private:
+		/// <param name="force"> Resolves &amp; publishes even if the film is up to date, e.g. when a whole pass is done </param>
+		bool Resolve(bool force);
+	private:
+		const uint id_;
+		const int priority_;
+		const RendererConfig config_;
+		Camera camera_;
+		Film& film_;
+		IProgressMonitor *monitor_;
+		TileCallback on_tile_;
+		Accumulator accum_;
+		SharedFilm shared_film_;
+		Synchronizer tiles_;			// only the tile layout & order is used, the queue does the pass bookkeeping
+		int tile_count_;
+
+		// guarded by the lock of the queue
+		int pass_;						// current sample pass
+		int tiles_done_;				// tiles of the current pass finished
+		int in_flight_;					// tiles being rendered
+
+		std::atomic<bool> canceled_;
+		bool done_;						// guarded by done_lock_
+		std::atomic<uint> version_;		// number of tiles finished
+		std::atomic<uint64_t> samples_;
+		std::atomic<int> passes_done_;	// complete sample passes in the accumulator
+		std::chrono::steady_clock::time_point start_, end_;	// end_ guarded by done_lock_
+		uint resolved_version_;
+		Lock resolve_lock_;
+		mutable std::mutex done_lock_;
+		std::condition_variable done_changed_;
+	};
+
+	/// <summary>
+	/// Keeps a built scene resident and renders any number of jobs on it with tasks of the shared TaskSystem.
+	/// A task renders tiles one after the other, picking the next one from the job of highest priority that has one available,
+	/// and ends once no tile is available. Jobs of the same priority are kept at the same pass. A job waiting for the last tiles
+	/// of a pass doesn't stall the tasks as long as there are other jobs, so the cores stay busy between jobs.
+	/// Unlike the Renderer there is no preview, crop film nor checkpoint: the film always covers the whole frame.
+	/// </summary>
+	class RenderQueue {
+	public:
+		/// <param name="threads"> Tiles rendered at once at most, 0 for one per worker of the task system </param>
+		RenderQueue(const Scene& scene, int threads = 0);
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator = (const RenderQueue&) = delete;
+		/// <summary>
+		/// Cancels the remaining jobs and stops the workers.
+		/// </summary>
+		~RenderQueue();
+
+		/// <summary>
+		/// Queues a render of the scene seen from the given camera transform.
+		/// The film is resized to the frame of the config, it must outlive the job.
+		/// </summary>
+		/// <param name="priority"> Jobs of higher priority get the workers first </param>
+		/// <param name="monitor"> Updated for every tile if not null </param>
+		/// <param name="onTile"> Called for every tile finished if set </param>
+		std::shared_ptr<RenderJob> Submit(const Transform& view, const RendererConfig& config, Film& film, int priority = 0,
+			IProgressMonitor *monitor = nullptr, RenderJob::TileCallback onTile = nullptr);
+		/// <summary>
+		/// Stops the job as soon as the tiles being rendered are finished, the film keeps the samples done so far.
+		/// </summary>
+		void Cancel(const std::shared_ptr<RenderJob>& job);
+		/// <summary>
+		/// Blocks until all the submitted jobs are done, rendering tiles meanwhile.
+		/// </summary>
+		void WaitAll();
+
+		inline int ThreadCount() const { return int(states_.size()); }
+		inline const Scene& GetScene() const { return scene_; }
+	private:
+		struct WorkerState;
+		/// <summary>
+		/// Starts tasks until as many are running as the queue allows, with the lock held.
+		/// </summary>
+		void Spawn();
+		/// <summary>
+		/// Renders tiles until none is available.
+		/// </summary>
+		void Work();
+		/// <summary>
+		/// Picks a tile of the job of highest priority that has one, with the lock held.
+		/// </summary>
+		std::shared_ptr<RenderJob> NextTile(RenderTile*& tile, int& pass);
+		/// <summary>
+		/// Counts a finished tile, ends the pass & the job if it was the last one, with the lock held.
+		/// </summary>
+		/// <param name="publish"> Set if the pass must be published before the next one starts, the tile then stays in flight </param>
+		/// <returns> Whether the job is over and must be finished </returns>
+		bool EndTile(RenderJob& job, bool& publish);
+		/// <summary>
+		/// Starts the next pass of a job whose last pass has been published, with the lock held.
+		/// </summary>
+		/// <returns> Whether the job is over and must be finished </returns>
+		bool EndPublish(RenderJob& job);
+		/// <summary>
+		/// Resolves the film of a job no worker touches anymore and wakes up the threads waiting for it, without the lock.
+		/// </summary>
+		void Finish(RenderJob& job);
+	private:
+		const Scene& scene_;
+		TaskGroup tasks_;
+		std::vector<std::unique_ptr<WorkerState>> states_;	// one per task that may run at once
+		std::vector<WorkerState*> idle_states_;				// states not used by a running task
+		int running_tasks_;									// tasks started & not returned yet
+		std::vector<std::shared_ptr<RenderJob>> jobs_;		// unfinished jobs
+		uint next_id_;
+		int unfinished_;				// jobs submitted & not finished yet, canceled or not
+		std::mutex lock_;
+		std::condition_variable changed_;
+		bool shutdown_;
+	};
+}
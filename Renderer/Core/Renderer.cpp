@@ -4,9 +4,13 @@
 #include "txbase/scene/camera.h"
 #include "txbase/math/sample.h"
 
+#include <cstring>
+#include <thread>
+
 #include "Renderer.h"
 #include "RendererConfig.h"
 #include "Core/Scene.h"
+#include "Core/TaskSystem.h"
 
 namespace TX {
 	Renderer::Renderer(
@@ -15,27 +19,37 @@ namespace TX {
 		Camera& camera,
 		Film& film,
 		IProgressMonitor *monitor)
-		: config(config), scene(scene), camera(camera), film(film), monitor_(monitor) {
-		ThreadScheduler::Instance()->StartAll();
-		// Sample buffer
-		sample_buf_ = std::make_unique<CameraSample>(10);	// should be enough to trace a ray
+		: config(config), scene(scene), camera(camera), film(film), monitor_(monitor), film_x_(0), film_y_(0), start_pass_(0),
+		passes_done_(0), version_(0), resolved_version_(0), pending_epoch_(0), busy_(false), running_(false), shutdown_(false) {
 		// Init tiled rendering synchronizer
-		thread_sync_.Init(config.width, config.height);
+		runtimeConfig = config;
+		SetupFrame();
+
+		// the state of a task slot is reused by every pass, whichever thread runs it
+		int slots = TaskSystem::Instance().Concurrency();
+		for (auto i = 0; i < slots; i++)
+			tasks_.push_back(std::unique_ptr<RenderTask>(new RenderTask()));
+		// the thread lives as long as the renderer, a new render only bumps the epoch
+		worker_ = std::thread(&Renderer::Work, this);
 	}
 	Renderer::~Renderer(){
+		{
+			std::lock_guard<std::mutex> lock(state_lock_);
+			shutdown_ = true;
+		}
 		Abort();
-		ThreadScheduler::Instance()->StopAll();
+		state_changed_.notify_all();
+		worker_.join();
 	}
 
 
 
 	Renderer& Renderer::Resize(int width, int height) {
-		if (runtimeConfig.width != width || runtimeConfig.height != height){
+		if (camera.Width() != width || camera.Height() != height){
 			bool wasRunning = this->Running();
 			Abort();
 			camera.Resize(width, height);
-			film.Resize(width, height);
-			thread_sync_.Init(width, height);
+			SetupFrame();
 			if (wasRunning) {
 				NewTask();
 			}
@@ -43,73 +57,273 @@ namespace TX {
 		return *this;
 	}
 
+	void Renderer::Prioritize(const RenderRegion& region) {
+		thread_sync_.Prioritize(region);
+	}
+
+	void Renderer::SetupFrame() {
+		// the camera always covers the full frame, the film only needs to hold the crop window
+		int width = camera.Width(), height = camera.Height();
+		RenderRegion region = runtimeConfig.crop.Clip(width, height);
+		if (runtimeConfig.crop_film) {
+			film_x_ = region.xmin;
+			film_y_ = region.ymin;
+			width = region.Width();
+			height = region.Height();
+		}
+		else {
+			film_x_ = film_y_ = 0;
+		}
+		if (film.Width() != width || film.Height() != height)
+			film.Resize(width, height);
+		accum_.Resize(width, height);
+		if (runtimeConfig.shared_film.empty()) {
+			shared_film_.Close();
+		}
+		else {
+			auto content = runtimeConfig.shared_film_raw ? SharedFilmHeader::Accumulation : SharedFilmHeader::Resolved;
+			if (!shared_film_.Valid() || shared_film_.Name() != runtimeConfig.shared_film ||
+				shared_film_.Width() != width || shared_film_.Height() != height || shared_film_.Content() != content)
+				shared_film_.Create(runtimeConfig.shared_film, width, height, content);
+			// the render goes on without it if the segment can't be created
+			if (shared_film_.Valid())
+				shared_film_.SetFrame(film_x_, film_y_, camera.Width(), camera.Height());
+		}
+		thread_sync_.Init(camera.Width(), camera.Height(),
+			runtimeConfig.tile_size, runtimeConfig.tile_order, runtimeConfig.pixel_order,
+			region, runtimeConfig.priority_regions);
+	}
+
 	bool Renderer::Running() {
-		return thread_sync_.Running() && ThreadScheduler::Instance()->taskCount > 0;
+		return running_;
 	}
 
 	void Renderer::Abort(){
-		thread_sync_.Abort();
-		ThreadScheduler::Instance()->JoinAll();
+		thread_sync_.NextEpoch();
+		std::unique_lock<std::mutex> lock(state_lock_);
+		// the tasks notice the new epoch within a pixel
+		state_changed_.wait(lock, [this]{ return !busy_; });
+		if (running_ && monitor_) monitor_->Finish();
+		running_ = false;
+		lock.unlock();
+		state_changed_.notify_all();
 	}
 
 	void Renderer::NewTask(){
-		if (monitor_) monitor_->Reset(float(config.samples_per_pixel * thread_sync_.TileCount()));
-		film.Clear();
-		thread_sync_.Resume();
+		Abort();
 		runtimeConfig = config;
+		// tiling & crop settings may have changed since the last render
+		SetupFrame();
+		film.Clear();
+		accum_.Clear();
+		version_ = resolved_version_ = 0;
+		start_pass_ = Math::Max(runtimeConfig.first_pass, LoadCheckpoint());
+		passes_done_ = start_pass_;
+		last_checkpoint_ = std::chrono::steady_clock::now();
+		if (monitor_) monitor_->Reset(float(Math::Max(0, runtimeConfig.samples_per_pixel - start_pass_) * thread_sync_.TileCount()));
 
-		Resize(config.width, config.height);
-		tracer_.reset(config.NewMethod());
-		sampler_.reset(config.NewSampler());
-
-		// generate sample offset for the current tracer
-		tracer_->BakeSamples(&scene, sample_buf_.get());
-
-		for (auto i = 0; i < ThreadScheduler::Instance()->ThreadCount(); i++){
-			tasks_.push_back(std::make_shared<RenderTask>(this));
-			ThreadScheduler::Instance()->AddTask(Task((Task::Func)&RenderTask::Run, tasks_[i].get()));
+		{
+			std::lock_guard<std::mutex> lock(state_lock_);
+			pending_epoch_ = thread_sync_.NextEpoch();
+			running_ = true;
 		}
+		state_changed_.notify_all();
 	}
 
-	void Renderer::Render(int workerId, RNG& random) {
-		// duplicate sample buffer in each thread
-		CameraSample sample_buf_dup(*sample_buf_);
-		for (int i = 0; thread_sync_.Running() && i < runtimeConfig.samples_per_pixel; i++){
-			// sync threads before and after each sample frame
-			thread_sync_.PreRenderSync(workerId);
-			RenderTiles(sample_buf_dup, random);
-			thread_sync_.PostRenderSync(workerId);
+	void Renderer::Wait(){
+		std::unique_lock<std::mutex> lock(state_lock_);
+		state_changed_.wait(lock, [this]{ return !running_ && !busy_; });
+	}
 
-			if (workerId == 0){
-				film.ScalePixels();
-				thread_sync_.ResetTiles();
+	void Renderer::Work() {
+		uint seen = 0;
+		while (true){
+			uint epoch;
+			{
+				std::unique_lock<std::mutex> lock(state_lock_);
+				state_changed_.wait(lock, [&]{ return shutdown_ || pending_epoch_ != seen; });
+				if (shutdown_) return;
+				seen = epoch = pending_epoch_;
+				// the render may have been canceled before this worker woke up
+				if (!thread_sync_.Running(epoch)) continue;
+				busy_ = true;
+			}
+			Render(epoch);
+			{
+				std::lock_guard<std::mutex> lock(state_lock_);
+				busy_ = false;
 			}
+			state_changed_.notify_all();
 		}
-		if (workerId == 0){
-			film.ScalePixels();
+	}
+
+	void Renderer::Render(uint epoch) {
+		RunPass([this](RenderTask& task) { task.Prepare(runtimeConfig); });
+		const TileKernel kernel = SelectTileKernel(runtimeConfig);
+		if (runtimeConfig.preview_scale > 1 && start_pass_ == 0){
+			RunPass([this, epoch](RenderTask& task) { RenderPreview(task, epoch); });
+			thread_sync_.ResetTiles();
+		}
+		for (int i = start_pass_; thread_sync_.Running(epoch) && i < runtimeConfig.samples_per_pixel; i++){
+			RunPass([this, kernel, i, epoch](RenderTask& task) { RenderTiles(task, kernel, i, epoch); });
+			if (!thread_sync_.Running(epoch)) break;
+			// nobody is fetching tiles or committing samples between passes
+			OnPassEnd(i + 1);
+			thread_sync_.ResetTiles();
+		}
+		if (thread_sync_.Running(epoch)){
+			Resolve(true);
 			if (monitor_) monitor_->Finish();
 		}
+		running_ = false;
+	}
+
+	void Renderer::RunPass(const std::function<void(RenderTask&)>& body) {
+		// every slot takes tiles until there are none left, so the slots balance themselves;
+		// this thread runs some of them while it waits
+		TaskGroup group;
+		for (auto& task : tasks_) {
+			RenderTask *t = task.get();
+			group.Run([&body, t] { body(*t); });
+		}
+		group.Wait();
 	}
 
-	void Renderer::RenderTiles(CameraSample& sample_buf, RNG& random){
+	void Renderer::RenderPreview(RenderTask& task, uint epoch){
+		// one sample per block of pixels, written straight to the film.
+		// the accumulator leaves pixels without samples untouched, so the blocks stay until the first full pass covers them
+		RayTracer& tracer = *task.tracer;
+		Sampler& sampler = *task.sampler;
+		const int scale = runtimeConfig.preview_scale;
+		const int width = accum_.Width();
+		Color *pixels = film.Pixels();
 		RenderTile* tile;
 		Ray ray;
 		Color c;
 		while (thread_sync_.NextTile(tile)){
-			for (int y = tile->ymin; y < tile->ymax; y++){
-				for (int x = tile->xmin; x < tile->xmax; x++){
-					if (!thread_sync_.Running()) return;
-					sampler_->GetSamples(&sample_buf);
-					sample_buf.pix_x = x;
-					sample_buf.pix_y = y;
-					sample_buf.x += x;
-					sample_buf.y += y;
-					camera.GenerateRay(&ray, sample_buf.x, sample_buf.y);
-					tracer_->Trace(&scene, ray, sample_buf, random, &c);
-					film.Commit(sample_buf.x, sample_buf.y, c);
+			for (int y = tile->ymin - tile->ymin % scale; y < tile->ymax; y += scale){
+				for (int x = tile->xmin - tile->xmin % scale; x < tile->xmax; x += scale){
+					if (!thread_sync_.Running(epoch)) return;
+					PixelSample sample = sampler.StartPixel(x, y, 0, runtimeConfig.seed);
+					sample.Skip(1);		// the ray goes through the center of the block
+					camera.GenerateRay(&ray, x + 0.5f * scale, y + 0.5f * scale);
+					task.random.Seed(RandomStream::PixelSeed(x, y, runtimeConfig.seed), 1);
+					tracer.Trace(&scene, ray, sample, task.random, &c);
+					c.a = 1.f;
+					for (int py = Math::Max(y, tile->ymin); py < Math::Min(y + scale, tile->ymax); py++)
+						for (int px = Math::Max(x, tile->xmin); px < Math::Min(x + scale, tile->xmax); px++)
+							pixels[(py - film_y_) * width + px - film_x_] = c;
 				}
 			}
+		}
+	}
+
+	void Renderer::RenderTiles(RenderTask& task, TileKernel kernel, int sampleIndex, uint epoch){
+		TilePass pass;
+		pass.scene = &scene;
+		pass.camera = &camera;
+		pass.tracer = task.tracer.get();
+		pass.sampler = task.sampler.get();
+		pass.offsets = &thread_sync_.PixelOffsets();
+		pass.random = &task.random;
+		pass.batch = &task.batch;
+		pass.accum = &accum_;
+		pass.film_x = film_x_;
+		pass.film_y = film_y_;
+		pass.seed = runtimeConfig.seed;
+		pass.pass = sampleIndex;
+		pass.cancel = thread_sync_.Token(epoch);
+		RenderTile* tile;
+		while (thread_sync_.NextTile(tile)){
+			kernel(pass, *tile);
+			if (!thread_sync_.Running(epoch)) return;
+			version_++;
 			if (monitor_) monitor_->UpdateInc();
 		}
 	}
+
+	int Renderer::LoadCheckpoint() {
+		if (!runtimeConfig.resume || runtimeConfig.checkpoint_path.empty())
+			return 0;
+		Checkpoint::State expected, saved;
+		expected.Describe(runtimeConfig, camera);
+		expected.width = accum_.Width();
+		expected.height = accum_.Height();
+		expected.film_x = film_x_;
+		expected.film_y = film_y_;
+		if (!Checkpoint::Load(runtimeConfig.checkpoint_path, expected, saved, accum_)) {
+			accum_.Resize(expected.width, expected.height);
+			accum_.Clear();
+			return 0;
+		}
+		// the samples of the remaining passes only depend on the seed
+		runtimeConfig.seed = saved.seed;
+		version_ = 1;
+		return Math::Min(saved.passes, runtimeConfig.samples_per_pixel);
+	}
+
+	void Renderer::OnPassEnd(int passes) {
+		passes_done_ = passes;
+		// nobody commits samples now, the readers get a whole pass along with its count,
+		// even if the pixels have been resolved since the last tile
+		if (shared_film_.Valid())
+			Resolve(true, true);
+		if (runtimeConfig.checkpoint_path.empty())
+			return;
+		auto now = std::chrono::steady_clock::now();
+		std::chrono::duration<float> elapsed = now - last_checkpoint_;
+		if (passes < runtimeConfig.samples_per_pixel && elapsed.count() < runtimeConfig.checkpoint_interval)
+			return;
+		Checkpoint::State state;
+		state.Describe(runtimeConfig, camera);
+		state.width = accum_.Width();
+		state.height = accum_.Height();
+		state.film_x = film_x_;
+		state.film_y = film_y_;
+		state.passes = passes;
+		state.seed = runtimeConfig.seed;
+		// the last checkpoint must not be skipped because of a slow write
+		if (passes == runtimeConfig.samples_per_pixel)
+			checkpoint_.Wait();
+		if (checkpoint_.Save(runtimeConfig.checkpoint_path, state, accum_))
+			last_checkpoint_ = now;
+	}
+
+	bool Renderer::Resolve() {
+		return Resolve(false);
+	}
+
+	bool Renderer::Resolve(bool parallel, bool force) {
+		LockGuard scope(resolve_lock_);
+		uint version = version_;
+		if (!force && version == resolved_version_)
+			return false;
+		if (film.Width() != accum_.Width() || film.Height() != accum_.Height())
+			return false;
+		resolved_version_ = version;
+
+		// samples of the running pass may be committed meanwhile, which is fine for a preview
+		int height = accum_.Height();
+		Color *shared = shared_film_.Valid() ? shared_film_.BeginWrite() : nullptr;
+		auto ResolveRows = [this, shared](size_t ybegin, size_t yend) {
+			accum_.Resolve(film.Pixels(), int(ybegin), int(yend));
+			if (shared) Publish(shared, int(ybegin), int(yend));
+		};
+		if (parallel)
+			ParallelFor(0, height, ResolveRows, 16);
+		else
+			ResolveRows(0, height);
+		if (shared) shared_film_.EndWrite(passes_done_);
+		return true;
+	}
+
+	void Renderer::Publish(Color *shared, int ybegin, int yend) {
+		static_assert(sizeof(Accumulator::Pixel) == sizeof(Color), "both kinds of pixels share the layout of the segment");
+		const int width = accum_.Width();
+		const size_t offset = size_t(ybegin) * width, count = size_t(yend - ybegin) * width;
+		if (shared_film_.Content() == SharedFilmHeader::Accumulation)
+			std::memcpy(shared + offset, accum_.Pixels() + offset, count * sizeof(Color));
+		else
+			std::memcpy(shared + offset, film.Pixels() + offset, count * sizeof(Color));
+	}
 }
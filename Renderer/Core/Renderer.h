@@ -1,10 +1,25 @@
 #pragma once
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
 #include "txbase/math/sample.h"
 #include "Synchronizer.h"
 #include "RendererConfig.h"
+#include "Accumulator.h"
+#include "Checkpoint.h"
+#include "SharedFilm.h"
+#include "TileKernel.h"
+#include <chrono>
 
 namespace TX {
+	/// <summary>
+	/// Renders a scene progressively into a film, one sample pass after the other.
+	/// The tiles of a pass are rendered by tasks of the shared TaskSystem, a thread of the renderer waits
+	/// for new renders between them and helps with the tasks of the pass it waits for.
+	/// </summary>
 	class Renderer {
 	public:
 		Renderer(const RendererConfig& config,
@@ -14,12 +29,65 @@ namespace TX {
 			IProgressMonitor *monitor=nullptr);
 		~Renderer();
 		bool Running();
+		/// <summary>
+		/// Cancels the current render, returns as soon as the workers are idle.
+		/// </summary>
 		void Abort();
+		/// <summary>
+		/// Restarts rendering with the current config, canceling the previous render if any.
+		/// </summary>
 		void NewTask();
-		void Render(int workerId, RNG& random);
-		void RenderTiles(CameraSample& sample_buf, RNG& random);
+		/// <summary>
+		/// Blocks until the current render is finished or aborted.
+		/// </summary>
+		void Wait();
+		/// <summary>
+		/// Normalizes the accumulated samples into the film.
+		/// Does nothing if no tile has been finished since the last call.
+		/// </summary>
+		/// <returns> Whether the film has been updated </returns>
+		bool Resolve();
 
 		Renderer& Resize(int width, int height);
+		/// <summary>
+		/// Raw sums of the current render, only consistent while no render is running.
+		/// </summary>
+		inline const Accumulator& Accumulation() const { return accum_; }
+		/// <summary>
+		/// Renders the tiles intersecting the region before the others, starting from the current pass.
+		/// </summary>
+		void Prioritize(const RenderRegion& region);
+	private:
+		/// <summary>
+		/// Sizes the film for the crop window of the runtime config and splits it into tiles.
+		/// </summary>
+		void SetupFrame();
+		/// <summary>
+		/// Loads the checkpoint of the runtime config into the accumulator if it belongs to the same frame.
+		/// </summary>
+		/// <returns> Number of passes already done </returns>
+		int LoadCheckpoint();
+		void OnPassEnd(int passes);
+		/// <summary>
+		/// Loop of the thread of the renderer, waits for new renders until the renderer is destroyed.
+		/// </summary>
+		void Work();
+		void Render(uint epoch);
+		/// <summary>
+		/// Runs the body once for every task slot in parallel, returns when all are done.
+		/// </summary>
+		void RunPass(const std::function<void(RenderTask&)>& body);
+		void RenderPreview(RenderTask& task, uint epoch);
+		/// <summary>
+		/// Renders the tiles of one sample pass with the kernel picked for the runtime config, once per render.
+		/// </summary>
+		void RenderTiles(RenderTask& task, TileKernel kernel, int sampleIndex, uint epoch);
+		/// <param name="force"> Resolves &amp; publishes even if no tile has been finished since the last call, e.g. when a whole pass is done </param>
+		bool Resolve(bool parallel, bool force = false);
+		/// <summary>
+		/// Copies rows [ybegin, yend) of the film or of the raw accumulation to the shared film being written.
+		/// </summary>
+		void Publish(Color *shared, int ybegin, int yend);
 	public:
 		const Scene& scene;
 		Camera& camera;
@@ -27,11 +95,27 @@ namespace TX {
 		const RendererConfig& config;
 	private:
 		RendererConfig runtimeConfig;
-		std::unique_ptr<RayTracer> tracer_;
-		std::unique_ptr<Sampler> sampler_;
-		std::unique_ptr<CameraSample> sample_buf_;
 		Synchronizer thread_sync_;
-		std::vector<std::shared_ptr<RenderTask>> tasks_;
+		Accumulator accum_;
+		int film_x_, film_y_;			// position of the film in the frame
+		int start_pass_;				// first sample pass of the current task, non zero when resuming
+		Checkpoint checkpoint_;
+		std::chrono::steady_clock::time_point last_checkpoint_;
+		SharedFilm shared_film_;
+		std::atomic<int> passes_done_;	// complete sample passes in the accumulator
+		std::atomic<uint> version_;		// number of tiles finished since the task started
+		uint resolved_version_;
+		Lock resolve_lock_;
+		std::vector<std::unique_ptr<RenderTask>> tasks_;	// one per thread of the task system
 		IProgressMonitor *monitor_;
+
+		// state of the thread of the renderer
+		std::mutex state_lock_;
+		std::condition_variable state_changed_;
+		uint pending_epoch_;			// the render the thread should pick up
+		bool busy_;						// whether the thread is inside a render
+		std::atomic<bool> running_;		// whether the current render hasn't finished yet
+		bool shutdown_;
+		std::thread worker_;
 	};
 }
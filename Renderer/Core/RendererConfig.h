@@ -1,4 +1,6 @@
 #pragma once
+#include <string>
+#include <vector>
 
 #include "txbase/image/filter.h"
 #include "txbase/math/sample.h"
@@ -6,26 +8,56 @@
 #include "RayTracer.h"
 #include "Methods/DirectLighting.h"
 #include "Methods/PathTracing.h"
+#include "Methods/WavefrontPathTracing.h"
+#include "Methods/ResampledDirectLighting.h"
 #include "Sampler.h"
 #include "Samplers/RandomSampler.h"
+#include "Samplers/SobolSampler.h"
+#include "Samplers/HaltonSampler.h"
+#include "Samplers/BlueNoiseSampler.h"
+#include "Synchronizer.h"
 
 namespace TX
 {
 	enum class RenderMethod{
 		DirectLighting,
-		PathTracing
+		PathTracing,
+		WavefrontPathTracing,
+		ResampledDirectLighting
 	};
 	enum class SamplerType{
-		Random
+		Random,
+		Sobol,
+		Halton,
+		BlueNoise
 	};
 
 	struct RendererConfig {
 		RendererConfig(){}
 		int samples_per_pixel;
+		int first_pass = 0;			// sample passes [first_pass, samples_per_pixel) are rendered, the others are left to other processes
 		int width = 0, height = 0;
 		RenderMethod tracer_t = RenderMethod::PathTracing;
 		int tracer_maxdepth = 5;
+		int ris_candidates = 32;	// light samples resampled per shading point by ResampledDirectLighting
+		int ris_neighbors = 0;		// reservoirs of close pixels it combines per pixel, 0 for no spatial reuse
+		bool sort_shading = true;	// WavefrontPathTracing groups the hits by BSDF before shading them
 		SamplerType sampler_t = SamplerType::Random;
+		bool static_dispatch = true;	// render loop specialized on the class of the tracer, false calls it through its base class
+		int tile_size = 64;
+		TileOrder tile_order = TileOrder::Hilbert;
+		PixelOrder pixel_order = PixelOrder::Morton;
+		uint64_t seed = 0;
+		int preview_scale = 1;		// block size of the coarse pass shown right after a restart, 1 to disable
+		RenderRegion crop;			// only the pixels inside are rendered, empty for the whole frame
+		bool crop_film = false;		// true: the film is sized to the crop window, false: the crop lands at its offset in a full frame film
+		std::vector<RenderRegion> priority_regions;		// rendered first, in this order
+		std::string checkpoint_path;		// empty to disable checkpoints
+		float checkpoint_interval = 600.f;	// minimum number of seconds between two checkpoints
+		bool resume = false;				// continue from the checkpoint if it matches the frame
+		std::string scene_name;				// identifies the scene in checkpoints, e.g. the path of its description
+		std::string shared_film;			// name of the shared memory segment the film is published to, empty to disable
+		bool shared_film_raw = false;		// publish the raw accumulation instead of the resolved colors
 
 		RayTracer* NewMethod() const {
 			switch (tracer_t){
@@ -33,6 +65,10 @@ namespace TX
 				return new DirectLighting(tracer_maxdepth);
 			case RenderMethod::PathTracing:
 				return new PathTracing(tracer_maxdepth);
+			case RenderMethod::WavefrontPathTracing:
+				return new WavefrontPathTracing(tracer_maxdepth, sort_shading);
+			case RenderMethod::ResampledDirectLighting:
+				return new ResampledDirectLighting(tracer_maxdepth, ris_candidates, ris_neighbors);
 			default:
 				throw "unimplemented";
 			}
@@ -42,6 +78,12 @@ namespace TX
 			switch (sampler_t){
 			case SamplerType::Random:
 				return new RandomSampler;
+			case SamplerType::Sobol:
+				return new SobolSampler;
+			case SamplerType::Halton:
+				return new HaltonSampler;
+			case SamplerType::BlueNoise:
+				return new BlueNoiseSampler;
 			default:
 				throw "unimplemented";
 			}
@@ -2,16 +2,84 @@
 #include <iostream>
 #include "txbase/fwddecl.h"
 #include "txbase/math/random.h"
+#include "txbase/math/vector.h"
+#include "txbase/math/sample.h"
+#include "RandomStream.h"
 
 namespace TX
 {
+	class Sampler;
+
+	/// <summary>
+	/// One sample of a pixel. Its dimensions are generated by the sampler when the integrator asks for them,
+	/// in groups of 1 to 3 coordinates taken in order: the position in the pixel first,
+	/// then as many groups as the path consumes, there is no upper bound.
+	/// A plain value, every path of a batch keeps its own.
+	/// </summary>
+	class PixelSample {
+	public:
+		PixelSample() : x(0), y(0), index(0), seed(0), pixel_seed(0), sampler_(nullptr), next_(0) {}
+		PixelSample(const Sampler *sampler, int x, int y, int index, uint64_t seed)
+			: x(x), y(y), index(index), seed(seed), pixel_seed(RandomStream::PixelSeed(x, y, seed)), sampler_(sampler), next_(0) {}
+
+		inline float Get1D();
+		inline Vec2 Get2D();
+		inline Sample Get3D();
+		/// <summary>
+		/// Leaves groups unused, so the next ones keep their place in the sequence.
+		/// </summary>
+		inline void Skip(uint32_t groups) { next_ += groups; }
+		/// <summary>
+		/// Number of groups taken so far.
+		/// </summary>
+		inline uint32_t Groups() const { return next_; }
+	public:
+		int x, y;
+		int index;				// of the sample in the pixel
+		uint64_t seed;			// of the render
+		uint64_t pixel_seed;	// RandomStream::PixelSeed() of the pixel
+	private:
+		const Sampler *sampler_;
+		uint32_t next_;
+	};
+
 	class Sampler {
 	public:
 		virtual ~Sampler(){}
 
 		/// <summary>
-		/// Fills all fields with canonical random value.
+		/// Starts a new sample of the given pixel.
+		/// The samples only depend on the pixel, the index of the sample and the seed, not on the calling thread.
+		/// </summary>
+		inline PixelSample StartPixel(int x, int y, int sampleIndex, uint64_t seed) const {
+			return PixelSample(this, x, y, sampleIndex, seed);
+		}
+
+		/// <summary>
+		/// Generates the first dims (up to 3) canonical coordinates of a group of dimensions of the sample.
 		/// </summary>
-		virtual void GetSamples(CameraSample *sample) = 0;
+		virtual void Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const = 0;
 	};
+
+	inline float PixelSample::Get1D() {
+		float v;
+		sampler_->Generate(*this, next_++, 1, &v);
+		return v;
+	}
+
+	inline Vec2 PixelSample::Get2D() {
+		float v[2];
+		sampler_->Generate(*this, next_++, 2, v);
+		return Vec2(v[0], v[1]);
+	}
+
+	inline Sample PixelSample::Get3D() {
+		float v[3];
+		sampler_->Generate(*this, next_++, 3, v);
+		Sample sample;
+		sample.u = v[0];
+		sample.v = v[1];
+		sample.w = v[2];
+		return sample;
+	}
 }
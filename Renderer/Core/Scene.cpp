@@ -1,13 +1,18 @@
 #include "stdafx.h"
+#include <atomic>
+#include <chrono>
 #include "Scene.h"
 #include "PrimitiveManager.h"
 #include "Primitive.h"
 #include "Intersection.h"
+#include "TaskSystem.h"
+#include "Accelerators/LightBVH.h"
 
 namespace TX {
-	Scene::Scene(std::unique_ptr<PrimitiveManager> primmgr) {
+	Scene::Scene(std::unique_ptr<PrimitiveManager> primmgr) : light_bvh_(new LightBVH) {
 		primmgr_ = std::move(primmgr);
 	}
+	Scene::~Scene() {}
 	void Scene::AddPrimitive(std::shared_ptr<Primitive> prim) {
 		prim->scene = this;
 		prims_.push_back(prim);
@@ -21,10 +26,50 @@ namespace TX {
 		result = prims_;
 	}
 	void Scene::Construct() {
-		for (auto& prim : prims_) {
-			prim->Bake();
-		}
-		primmgr_->Construct(prims_);
+		typedef std::chrono::steady_clock Clock;
+		typedef std::chrono::nanoseconds Nanoseconds;
+		auto Seconds = [](Clock::duration d) { return std::chrono::duration<float>(d).count(); };
+		auto Ns = [](Clock::duration d) { return std::chrono::duration_cast<Nanoseconds>(d).count(); };
+		const Clock::time_point start = Clock::now();
+
+		// nanoseconds spent in each per primitive stage by all threads
+		std::atomic<int64_t> transformTime(0), gatherTime(0), samplerTime(0);
+		TaskGroup samplers;
+		primmgr_->BeginConstruct(prims_);
+		ParallelFor(0, prims_.size(), [&](size_t begin, size_t end) {
+			for (uint i = uint(begin); i < end; i++) {
+				Primitive *prim = prims_[i].get();
+				Clock::time_point t0 = Clock::now();
+				prim->BakeTransform();
+				Clock::time_point t1 = Clock::now();
+				primmgr_->PrimitiveReady(i);
+				Clock::time_point t2 = Clock::now();
+				transformTime += Ns(t1 - t0);
+				gatherTime += Ns(t2 - t1);
+				if (prim->GetAreaLight()) {
+					samplers.Run([prim, &samplerTime, Ns] {
+						Clock::time_point t = Clock::now();
+						prim->BakeSampler();
+						samplerTime += Ns(Clock::now() - t);
+					});
+				}
+			}
+		}, 1);
+
+		const Clock::time_point baked = Clock::now();
+		primmgr_->Build();
+		timings_.build = Seconds(Clock::now() - baked);
+		samplers.Wait();
+
+		// the bounds of the area lights come from the baked meshes
+		const Clock::time_point lightsStart = Clock::now();
+		light_bvh_->Build(lights);
+		timings_.lights = Seconds(Clock::now() - lightsStart);
+
+		timings_.transform = std::chrono::duration<float>(Nanoseconds(transformTime.load())).count();
+		timings_.gather = std::chrono::duration<float>(Nanoseconds(gatherTime.load())).count();
+		timings_.samplers = std::chrono::duration<float>(Nanoseconds(samplerTime.load())).count();
+		timings_.total = Seconds(Clock::now() - start);
 	}
 
 
@@ -4,18 +4,41 @@
 #include "PrimitiveManager.h"
 
 namespace TX {
+	class LightBVH;
+
 	class Scene {
 	public:
+		/// <summary>
+		/// Time spent in the stages of Construct(), in seconds.
+		/// The stages overlap, so the per primitive ones are summed over all the threads.
+		/// </summary>
+		struct ConstructTimings {
+			float transform = 0.f;		// applying the transforms of the primitives
+			float gather = 0.f;			// copying the baked meshes into the accelerator
+			float samplers = 0.f;		// building the samplers of the area lights
+			float build = 0.f;			// building the accelerator, wall time
+			float lights = 0.f;			// building the light BVH, wall time
+			float total = 0.f;			// wall time of Construct()
+		};
+
 		Scene(std::unique_ptr<PrimitiveManager> primmgr);
+		~Scene();
 
 		void AddPrimitive(std::shared_ptr<Primitive> prim);
 		void AddLight(std::shared_ptr<Light> light);
 		void GetPrimitives(std::vector<std::shared_ptr<Primitive>>& result) const;
 
 		/// <summary>
-		/// Initializes the scene after all lights & primitives are added
+		/// Initializes the scene after all lights & primitives are added.
+		/// Primitives are baked in parallel, each one is handed to the accelerator as soon as it is transformed,
+		/// and the light samplers are built while the accelerator builds its tree.
 		/// </summary>
 		void Construct();
+		inline const ConstructTimings& Timings() const { return timings_; }
+		/// <summary>
+		/// Picks the light to sample at a shading point, available after Construct().
+		/// </summary>
+		inline const LightBVH& GetLightBVH() const { return *light_bvh_; }
 
 		bool Intersect(const Ray& ray, Intersection& intxn) const;
 		void PostIntersect(const Ray& ray, LocalGeo& geo) const;
@@ -25,5 +48,7 @@ namespace TX {
 	private:
 		std::vector<std::shared_ptr<Primitive>> prims_;
 		std::unique_ptr<PrimitiveManager> primmgr_;
+		std::unique_ptr<LightBVH> light_bvh_;
+		ConstructTimings timings_;
 	};
 }
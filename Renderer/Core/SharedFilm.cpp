@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "SharedFilm.h"
+
+namespace TX {
+	namespace {
+		const char MAGIC[4] = { 'T', 'X', 'S', 'F' };
+		// pixels start on their own cache line
+		const uint32_t HEADER_SIZE = 64;
+
+		static_assert(sizeof(SharedFilmHeader) <= HEADER_SIZE, "the header must fit before the pixels");
+		static_assert(sizeof(Color) == 4 * sizeof(float), "pixels are shared as four floats");
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the sequence must be lock free to be shared between processes");
+
+		inline std::string SegmentName(const std::string& name, int generation) {
+			return generation == 0 ? name : name + "." + std::to_string(generation);
+		}
+
+		/// <summary>
+		/// Maps a named segment of the given size, creating it if writable.
+		/// Creating fails on Windows if the segment already exists, readers may still map it with its old size.
+		/// </summary>
+		void* MapSegment(const std::string& name, size_t size, bool writable, void *&mapping) {
+#ifdef _WIN32
+			std::string native = "Local\\" + name;
+			HANDLE handle = writable ?
+				CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), native.c_str()) :
+				OpenFileMappingA(FILE_MAP_READ, FALSE, native.c_str());
+			if (!handle) return nullptr;
+			if (writable && GetLastError() == ERROR_ALREADY_EXISTS) {
+				CloseHandle(handle);
+				return nullptr;
+			}
+			void *data = MapViewOfFile(handle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+			if (!data) {
+				CloseHandle(handle);
+				return nullptr;
+			}
+			mapping = handle;
+			return data;
+#else
+			std::string native = "/" + name;
+			int fd = writable ? shm_open(native.c_str(), O_CREAT | O_RDWR, 0644) : shm_open(native.c_str(), O_RDONLY, 0);
+			if (fd < 0) return nullptr;
+			if (writable && ftruncate(fd, off_t(size)) != 0) {
+				close(fd);
+				return nullptr;
+			}
+			if (!writable) {
+				struct stat st;
+				if (fstat(fd, &st) != 0 || size_t(st.st_size) < size) {
+					close(fd);
+					return nullptr;
+				}
+			}
+			void *data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);		// the mapping keeps the segment alive
+			mapping = nullptr;
+			return data == MAP_FAILED ? nullptr : data;
+#endif
+		}
+
+		void UnmapSegment(const void *data, size_t size, void *mapping) {
+#ifdef _WIN32
+			UnmapViewOfFile(data);
+			CloseHandle(mapping);
+#else
+			munmap(const_cast<void *>(data), size);
+#endif
+		}
+
+		inline size_t SegmentSize(int width, int height) {
+			return HEADER_SIZE + sizeof(Color) * size_t(width) * height;
+		}
+	}
+
+	SharedFilm::SharedFilm() : header_(nullptr), size_(0), mapping_(nullptr) {}
+	SharedFilm::~SharedFilm() {
+		Close();
+	}
+
+	bool SharedFilm::Create(const std::string& name, int width, int height, SharedFilmHeader::Content content) {
+		Close();
+#ifndef _WIN32
+		// a segment can't be shrunk while readers map it, start from a fresh one
+		shm_unlink(("/" + name).c_str());
+#endif
+		size_t size = SegmentSize(width, height);
+		void *data = nullptr;
+		for (int g = 0; !data && g < SharedFilmHeader::GENERATIONS; g++) {
+			segment_ = SegmentName(name, g);
+			data = MapSegment(segment_, size, true, mapping_);
+		}
+		if (!data) {
+			segment_.clear();
+			return false;
+		}
+		std::memset(data, 0, size);
+		header_ = new (data) SharedFilmHeader;
+		std::memcpy(header_->magic, MAGIC, sizeof(MAGIC));
+		header_->version = SharedFilmHeader::VERSION;
+		header_->header_size = HEADER_SIZE;
+		header_->content = content;
+		header_->width = header_->frame_width = uint32_t(width);
+		header_->height = header_->frame_height = uint32_t(height);
+		header_->open = 1;
+		header_->sequence.store(0, std::memory_order_release);
+		name_ = name;
+		size_ = size;
+		return true;
+	}
+
+	void SharedFilm::Close() {
+		if (!header_)
+			return;
+		header_->sequence.fetch_add(1, std::memory_order_acq_rel);
+		header_->open = 0;
+		header_->sequence.fetch_add(1, std::memory_order_release);
+		UnmapSegment(header_, size_, mapping_);
+#ifndef _WIN32
+		shm_unlink(("/" + segment_).c_str());
+#endif
+		header_ = nullptr;
+		mapping_ = nullptr;
+		size_ = 0;
+		name_.clear();
+		segment_.clear();
+	}
+
+	void SharedFilm::SetFrame(int filmX, int filmY, int frameWidth, int frameHeight) {
+		header_->sequence.fetch_add(1, std::memory_order_acq_rel);
+		header_->film_x = uint32_t(filmX);
+		header_->film_y = uint32_t(filmY);
+		header_->frame_width = uint32_t(frameWidth);
+		header_->frame_height = uint32_t(frameHeight);
+		header_->sequence.fetch_add(1, std::memory_order_release);
+	}
+
+	Color* SharedFilm::BeginWrite() {
+		header_->sequence.fetch_add(1, std::memory_order_acq_rel);
+		// the pixels must not be written before the readers can see the odd sequence
+		std::atomic_thread_fence(std::memory_order_release);
+		return reinterpret_cast<Color *>(reinterpret_cast<char *>(header_) + HEADER_SIZE);
+	}
+
+	void SharedFilm::EndWrite(int passes) {
+		header_->passes = uint32_t(passes);
+		header_->sequence.fetch_add(1, std::memory_order_release);
+	}
+
+	SharedFilmReader::SharedFilmReader() : header_(nullptr), size_(0), mapping_(nullptr) {}
+	SharedFilmReader::~SharedFilmReader() {
+		Close();
+	}
+
+	bool SharedFilmReader::Open(const std::string& name) {
+		Close();
+		// older generations may be gone while newer ones are still there
+		for (int g = 0; g < SharedFilmHeader::GENERATIONS; g++)
+			if (OpenSegment(SegmentName(name, g)))
+				return true;
+		return false;
+	}
+
+	bool SharedFilmReader::OpenSegment(const std::string& segment) {
+		// the header first to know the size of the segment
+		void *mapping = nullptr;
+		void *data = MapSegment(segment, HEADER_SIZE, false, mapping);
+		if (!data)
+			return false;
+		const SharedFilmHeader *header = static_cast<const SharedFilmHeader *>(data);
+		bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->version == SharedFilmHeader::VERSION &&
+			header->open;
+		size_t size = valid ? header->header_size + sizeof(Color) * size_t(header->width) * header->height : 0;
+		UnmapSegment(data, HEADER_SIZE, mapping);
+		if (!valid)
+			return false;
+
+		data = MapSegment(segment, size, false, mapping_);
+		if (!data)
+			return false;
+		header_ = static_cast<const SharedFilmHeader *>(data);
+		size_ = size;
+		return true;
+	}
+
+	void SharedFilmReader::Close() {
+		if (header_)
+			UnmapSegment(header_, size_, mapping_);
+		header_ = nullptr;
+		mapping_ = nullptr;
+		size_ = 0;
+	}
+
+	bool SharedFilmReader::Read(std::vector<Color>& pixels, SharedFilmHeader *header) const {
+		return Read([&](const SharedFilmHeader& h, const Color *data) {
+			pixels.assign(data, data + size_t(h.width) * h.height);
+			if (header) std::memcpy(static_cast<void *>(header), &h, sizeof(SharedFilmHeader));
+		});
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "txbase/math/color.h"
+
+namespace TX {
+	class Accumulator;
+
+	/// <summary>
+	/// Layout of the beginning of a shared film segment, followed by width * height pixels of four floats, bottom row first.
+	/// Readers in other languages only need this struct: read the sequence, skip odd values, read the pixels,
+	/// then read the sequence again and retry if it changed.
+	/// The segment of a film is named after it, or "name.1" to "name.15" if an older segment of that name still exists,
+	/// readers take the first of them that is open.
+	/// </summary>
+	struct SharedFilmHeader {
+		enum Content : uint32_t {
+			Resolved = 0,			// colors (r, g, b, a) as in the film
+			Accumulation = 1		// raw sums (r, g, b, weight) as in the accumulator, divide by the weight
+		};
+		static const uint32_t VERSION = 1;
+		static const int GENERATIONS = 16;	// names a film can be published under
+
+		char magic[4];				// "TXSF"
+		uint32_t version;
+		uint32_t header_size;		// offset of the pixels from the beginning of the segment
+		uint32_t content;
+		uint32_t width, height;		// size of the film
+		uint32_t film_x, film_y;	// position of the film in the frame, not zero for a cropped film
+		uint32_t frame_width, frame_height;
+		uint32_t passes;			// sample passes finished when the pixels were written
+		uint32_t open;				// cleared when the writer goes away, readers should reopen the segment
+		std::atomic<uint64_t> sequence;		// odd while the pixels are being written, increased by 2 for every update
+	};
+
+	/// <summary>
+	/// Writer side of a named shared memory segment holding a copy of the film, updated as a seqlock:
+	/// the writer never waits for the readers, the readers retry if the pixels changed while they read them.
+	/// POSIX shared memory (shm_open) elsewhere, a named file mapping on Windows.
+	/// </summary>
+	class SharedFilm {
+	public:
+		SharedFilm();
+		SharedFilm(const SharedFilm&) = delete;
+		SharedFilm& operator = (const SharedFilm&) = delete;
+		~SharedFilm();
+
+		/// <summary>
+		/// Creates the segment, replacing the one of the same name.
+		/// A Windows file mapping lives as long as someone maps it and keeps its size,
+		/// so while readers hold the old one the film is published under the next free generation of the name.
+		/// </summary>
+		/// <returns> False if the segment can't be created </returns>
+		bool Create(const std::string& name, int width, int height, SharedFilmHeader::Content content);
+		/// <summary>
+		/// Marks the segment closed &amp; removes its name, readers keep their mapping until they close it.
+		/// </summary>
+		void Close();
+
+		/// <summary>
+		/// Places the film in the frame, published with the next update.
+		/// </summary>
+		void SetFrame(int filmX, int filmY, int frameWidth, int frameHeight);
+
+		/// <summary>
+		/// Starts an update, the pixels can then be written in place until EndWrite().
+		/// </summary>
+		Color* BeginWrite();
+		void EndWrite(int passes);
+
+		inline bool Valid() const { return header_ != nullptr; }
+		inline const std::string& Name() const { return name_; }
+		inline SharedFilmHeader::Content Content() const { return SharedFilmHeader::Content(header_->content); }
+		inline int Width() const { return int(header_->width); }
+		inline int Height() const { return int(header_->height); }
+	private:
+		std::string name_;
+		std::string segment_;	// name with the generation suffix if any
+		SharedFilmHeader *header_;
+		size_t size_;
+		void *mapping_;		// native handle on Windows
+	};
+
+	/// <summary>
+	/// Reader side of a shared film, for viewers &amp; tools written against this code.
+	/// </summary>
+	class SharedFilmReader {
+	public:
+		SharedFilmReader();
+		SharedFilmReader(const SharedFilmReader&) = delete;
+		SharedFilmReader& operator = (const SharedFilmReader&) = delete;
+		~SharedFilmReader();
+
+		/// <summary>
+		/// Opens the segment of the film published under the name, whatever its generation.
+		/// </summary>
+		bool Open(const std::string& name);
+		void Close();
+
+		/// <summary>
+		/// Calls the function on the pixels in place, again if they changed meanwhile.
+		/// The function must not keep the pointer, nor trust the values before Read() returns true.
+		/// </summary>
+		/// <returns> False if the segment has been closed by the writer or kept changing </returns>
+		template<typename Func>
+		bool Read(Func read, int retries = 64) const {
+			for (int i = 0; i < retries && header_->open; i++) {
+				uint64_t begin = header_->sequence.load(std::memory_order_acquire);
+				if (begin & 1) continue;
+				read(*header_, reinterpret_cast<const Color *>(reinterpret_cast<const char *>(header_) + header_->header_size));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (header_->sequence.load(std::memory_order_relaxed) == begin)
+					return true;
+			}
+			return false;
+		}
+		/// <summary>
+		/// Copies the pixels, resizing the vector to the film.
+		/// </summary>
+		bool Read(std::vector<Color>& pixels, SharedFilmHeader *header = nullptr) const;
+
+		inline bool Valid() const { return header_ != nullptr; }
+		/// <summary>
+		/// Sequence of the last completed update, changes whenever the pixels do.
+		/// </summary>
+		inline uint64_t Sequence() const { return header_->sequence.load(std::memory_order_acquire) & ~uint64_t(1); }
+	private:
+		bool OpenSegment(const std::string& segment);
+	private:
+		const SharedFilmHeader *header_;
+		size_t size_;
+		void *mapping_;
+	};
+}
@@ -1,61 +1,169 @@
 #include "stdafx.h"
 
 #include "Synchronizer.h"
-#include "Renderer.h"
+#include "RendererConfig.h"
+#include <algorithm>
 
 namespace TX
 {
-	void RenderTask::Render(int workerId) {
-		renderer->Render(workerId, random);
+	RenderTask::RenderTask(){}
+	RenderTask::~RenderTask(){}
+
+	void RenderTask::Prepare(const RendererConfig& config){
+		tracer.reset(config.NewMethod());
+		sampler.reset(config.NewSampler());
+	}
+
+	void* RenderTask::operator new(size_t size){
+		return AllocAligned<char>(size, 64);
+	}
+	void RenderTask::operator delete(void *ptr){
+		FreeAligned(ptr);
+	}
+
+	namespace {
+		/// <summary>
+		/// Interleaves the lower 16 bits of x and y.
+		/// </summary>
+		inline uint MortonIndex(uint x, uint y) {
+			auto spread = [](uint v) {
+				v &= 0x0000ffff;
+				v = (v | (v << 8)) & 0x00ff00ff;
+				v = (v | (v << 4)) & 0x0f0f0f0f;
+				v = (v | (v << 2)) & 0x33333333;
+				v = (v | (v << 1)) & 0x55555555;
+				return v;
+			};
+			return spread(x) | (spread(y) << 1);
+		}
+
+		/// <summary>
+		/// Distance of (x, y) along the Hilbert curve filling a square of size n (power of 2).
+		/// </summary>
+		inline uint HilbertIndex(uint n, uint x, uint y) {
+			uint d = 0;
+			for (uint s = n / 2; s > 0; s /= 2) {
+				uint rx = (x & s) > 0;
+				uint ry = (y & s) > 0;
+				d += s * s * ((3 * rx) ^ ry);
+				// rotate the quadrant
+				if (ry == 0) {
+					if (rx == 1) {
+						x = s - 1 - x;
+						y = s - 1 - y;
+					}
+					std::swap(x, y);
+				}
+			}
+			return d;
+		}
+
+		inline uint CeilPow2(uint v) {
+			uint p = 1;
+			while (p < v) p <<= 1;
+			return p;
+		}
 	}
-	void Synchronizer::Init(int x, int y){
+
+	void Synchronizer::Init(int x, int y, int tileSize, TileOrder tileOrder, PixelOrder pixelOrder,
+		const RenderRegion& region, const std::vector<RenderRegion>& priorities){
+		assert(0 < tileSize && tileSize <= 0xffff);
 		tiles.clear();
+		tileQueue.clear();
 		currentTile = 0;
-		for (int i = 0; i < y; i += RenderTile::SIZE){
-			for (int j = 0; j < x; j += RenderTile::SIZE){
-				int xmin = j;
-				int ymin = i;
-				int xmax = Math::Min(x, j + RenderTile::SIZE);
-				int ymax = Math::Min(y, i + RenderTile::SIZE);
-				tiles.push_back(RenderTile(xmin, ymin, xmax, ymax));
+		focus = RenderRegion();
+		RenderRegion bounds = region.Clip(x, y);
+
+		// sort the tiles along the chosen curve, the key of a tile is computed from its grid coordinates
+		int tilesX = (x + tileSize - 1) / tileSize;
+		int tilesY = (y + tileSize - 1) / tileSize;
+		uint gridSize = CeilPow2(Math::Max(tilesX, tilesY));
+		std::vector<float> keys;
+		std::vector<int> order;
+		keys.reserve(tilesX * tilesY);
+		for (int i = 0; i < tilesY; i++){
+			for (int j = 0; j < tilesX; j++){
+				switch (tileOrder) {
+				case TileOrder::Morton:
+					keys.push_back(float(MortonIndex(j, i)));
+					break;
+				case TileOrder::Hilbert:
+					keys.push_back(float(HilbertIndex(gridSize, j, i)));
+					break;
+				case TileOrder::Spiral:
+				{
+					// ring around the center first, then the angle inside the ring
+					float dx = j - 0.5f * (tilesX - 1);
+					float dy = i - 0.5f * (tilesY - 1);
+					float ring = Math::Max(std::floor(Math::Abs(dx) + 0.5f), std::floor(Math::Abs(dy) + 0.5f));
+					keys.push_back(ring * 8.f + (std::atan2(dy, dx) + Math::PI) / Math::PI);
+					break;
+				}
+				default:
+					keys.push_back(float(i * tilesX + j));
+					break;
+				}
+				order.push_back(i * tilesX + j);
 			}
 		}
-		for (auto& e : preRenderEvents) CloseHandle(e);
-		for (auto& e : postRenderEvents) CloseHandle(e);
-		preRenderEvents.resize(ThreadScheduler::Instance()->ThreadCount());
-		postRenderEvents.resize(ThreadScheduler::Instance()->ThreadCount());
-		for (auto& e : preRenderEvents) e = CreateEvent(NULL, TRUE, FALSE, NULL);
-		for (auto& e : postRenderEvents) e = CreateEvent(NULL, TRUE, FALSE, NULL);
-		running = true;
-		finished = false;
+		std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+		// the grid stays aligned to the frame so that tiles of a crop window match those of the full frame
+		std::vector<uint> rank;
+		tiles.reserve(order.size());
+		for (int id : order) {
+			int xmin = Math::Max(bounds.xmin, (id % tilesX) * tileSize);
+			int ymin = Math::Max(bounds.ymin, (id / tilesX) * tileSize);
+			int xmax = Math::Min(bounds.xmax, (id % tilesX + 1) * tileSize);
+			int ymax = Math::Min(bounds.ymax, (id / tilesX + 1) * tileSize);
+			if (xmax <= xmin || ymax <= ymin) continue;
+			tiles.push_back(RenderTile(xmin, ymin, xmax, ymax));
+			tileQueue.push_back(tileQueue.size());
+
+			// index of the first prioritized region the tile belongs to
+			uint r = 0;
+			while (r < priorities.size() && (priorities[r].Empty() || !priorities[r].Overlaps(tiles.back()))) r++;
+			rank.push_back(r);
+		}
+		std::stable_sort(tileQueue.begin(), tileQueue.end(), [&rank](uint a, uint b) { return rank[a] < rank[b]; });
+
+		// pixel order inside a full tile, shared by all the tiles
+		pixelOffsets.clear();
+		for (int py = 0; py < tileSize; py++)
+			for (int px = 0; px < tileSize; px++)
+				pixelOffsets.push_back(py << 16 | px);
+		if (pixelOrder == PixelOrder::Morton) {
+			std::sort(pixelOffsets.begin(), pixelOffsets.end(), [](uint a, uint b) {
+				return MortonIndex(a & 0xffff, a >> 16) < MortonIndex(b & 0xffff, b >> 16);
+			});
+		}
+	}
+	uint Synchronizer::NextEpoch(){
+		return ++epoch;
+	}
+	void Synchronizer::ResetTiles(){
+		LockGuard scope(syncLock);
+		currentTile = 0;
+		if (!focus.Empty()) {
+			std::stable_partition(tileQueue.begin(), tileQueue.end(), [this](uint i) { return focus.Overlaps(tiles[i]); });
+		}
 	}
 	bool Synchronizer::NextTile(RenderTile*& tile){
 		LockGuard scope(syncLock);
-		if (currentTile < tiles.size()){
-			tile = &tiles[currentTile++];
+		if (currentTile < tileQueue.size()){
+			tile = &tiles[tileQueue[currentTile++]];
 			return true;
 		}
 		return false;
 	}
-	int Synchronizer::TileCount(){
-		return tiles.size();
-	}
-	void Synchronizer::PreRenderSync(int workerId){
-		SetEvent(preRenderEvents[workerId]);
-		while (WaitForMultipleObjects(preRenderEvents.size(), preRenderEvents.data(), true, 50) == WAIT_TIMEOUT)
-			if (!running) return;
-		if (++preRenderCount == preRenderEvents.size()){
-			preRenderCount = 0;
-			for (auto& e : preRenderEvents) ResetEvent(e);
+	void Synchronizer::Prioritize(const RenderRegion& region){
+		LockGuard scope(syncLock);
+		focus = region;
+		if (!focus.Empty()) {
+			std::stable_partition(tileQueue.begin() + currentTile, tileQueue.end(), [this](uint i) { return focus.Overlaps(tiles[i]); });
 		}
 	}
-	void Synchronizer::PostRenderSync(int workerId){
-		SetEvent(postRenderEvents[workerId]);
-		while (WaitForMultipleObjects(postRenderEvents.size(), postRenderEvents.data(), true, 50) == WAIT_TIMEOUT)
-			if (!running) return;
-		if (++postRenderCount == postRenderEvents.size()){
-			postRenderCount = 0;
-			for (auto& e : postRenderEvents) ResetEvent(e);
-		}
+	int Synchronizer::TileCount(){
+		return tiles.size();
 	}
 }
@@ -2,52 +2,138 @@
 #include "txbase/sys/thread.h"
 #include "txbase/math/base.h"
 #include "txbase/math/random.h"
+#include "txbase/math/sample.h"
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "RandomStream.h"
+#include "RayBatch.h"
 
 namespace TX
 {
-	class Renderer;
-	class RenderTask{
+	class RayTracer;
+	class Sampler;
+	struct RendererConfig;
+
+	/// <summary>
+	/// Task slot of a renderer along with all the state it mutates while rendering,
+	/// so that no thread writes to shared memory in the inner loop.
+	/// Aligned to cache lines to avoid false sharing between threads.
+	/// </summary>
+	class alignas(64) RenderTask{
 	public:
-		RenderTask(Renderer *renderer) : renderer(renderer){}
+		RenderTask();
+		~RenderTask();
 
-		static void Run(RenderTask *task, int workerId){
-			task->Render(workerId);
-		}
-	protected:
-		void Render(int workerId);
+		static void* operator new(size_t size);
+		static void operator delete(void *ptr);
+
+		/// <summary>
+		/// Creates the tracer &amp; sampler for a new render.
+		/// </summary>
+		void Prepare(const RendererConfig& config);
 	public:
-		Renderer *renderer;
-	private:
-		RNG random;
+		std::unique_ptr<RayTracer> tracer;
+		std::unique_ptr<Sampler> sampler;
+		RandomStream random;
+		RayBatch batch;		// camera rays of a tile, for the tracers working on batches
+	};
+
+	/// <summary>
+	/// Order in which the tiles of a frame are handed out.
+	/// </summary>
+	enum class TileOrder {
+		Scanline,
+		Morton,
+		Hilbert,
+		Spiral			// outwards from the center of the image
+	};
+	/// <summary>
+	/// Order in which the pixels inside a tile are traced.
+	/// </summary>
+	enum class PixelOrder {
+		Scanline,
+		Morton
 	};
 
 	struct RenderTile {
-		static const int SIZE = 64;
 		const int xmin, ymin, xmax, ymax;
 		RenderTile(int xmin, int ymin, int xmax, int ymax)
 			: xmin(xmin), ymin(ymin), xmax(xmax), ymax(ymax){}
 	};
 
+	/// <summary>
+	/// Rectangle of pixels [xmin, xmax) x [ymin, ymax) in full frame coordinates.
+	/// An empty region stands for the whole frame.
+	/// </summary>
+	struct RenderRegion {
+		int xmin = 0, ymin = 0, xmax = 0, ymax = 0;
+		RenderRegion(){}
+		RenderRegion(int xmin, int ymin, int xmax, int ymax)
+			: xmin(xmin), ymin(ymin), xmax(xmax), ymax(ymax){}
+
+		inline bool Empty() const { return xmax <= xmin || ymax <= ymin; }
+		inline int Width() const { return Math::Max(0, xmax - xmin); }
+		inline int Height() const { return Math::Max(0, ymax - ymin); }
+		inline bool Overlaps(const RenderTile& tile) const {
+			return xmin < tile.xmax && tile.xmin < xmax && ymin < tile.ymax && tile.ymin < ymax;
+		}
+		/// <summary>
+		/// Clips the region to a frame of the given size, an empty region becomes the whole frame.
+		/// </summary>
+		inline RenderRegion Clip(int width, int height) const {
+			if (Empty()) return RenderRegion(0, 0, width, height);
+			return RenderRegion(Math::Max(xmin, 0), Math::Max(ymin, 0), Math::Min(xmax, width), Math::Min(ymax, height));
+		}
+	};
+
+	/// <summary>
+	/// Hands out the tiles of a sample pass to the workers.
+	/// Every render is identified by an epoch, starting a new epoch cancels the previous one.
+	/// </summary>
 	class Synchronizer {
 	public:
-		void Init(int x, int y);
-		inline void Abort(){ running = false; }
-		inline void Resume(){ running = true; }
-		inline bool Running(){ return running; }
+		Synchronizer() : currentTile(0), epoch(0) {}
+		/// <summary>
+		/// Splits the frame into tiles, keeping only those that intersect the given region (clipped to it).
+		/// Tiles intersecting the prioritized regions are handed out first, in the order of the list.
+		/// </summary>
+		void Init(int x, int y, int tileSize = 64, TileOrder tileOrder = TileOrder::Scanline, PixelOrder pixelOrder = PixelOrder::Scanline,
+			const RenderRegion& region = RenderRegion(), const std::vector<RenderRegion>& priorities = std::vector<RenderRegion>());
+
+		/// <summary>
+		/// Cancels the current render.
+		/// </summary>
+		/// <returns> The new epoch </returns>
+		uint NextEpoch();
+		inline uint Epoch() const { return epoch; }
+		inline bool Running(uint e) const { return epoch == e; }
+		/// <summary>
+		/// Canceled once the render of the given epoch is.
+		/// </summary>
+		inline CancelToken Token(uint e) const { return CancelToken(epoch, e); }
 
-		void ResetTiles(){ currentTile = 0; finished = false; }
+		void ResetTiles();
 		bool NextTile(RenderTile*& tile);
 		int TileCount();
-		void PreRenderSync(int workerId);
-		void PostRenderSync(int workerId);
+		/// <summary>
+		/// Moves the tiles intersecting the region to the front of the remaining ones, in this pass and the following ones.
+		/// </summary>
+		void Prioritize(const RenderRegion& region);
+		/// <summary>
+		/// Offsets of the pixels relative to the corner of a tile in tracing order,
+		/// packed as (y &lt;&lt; 16 | x). Offsets past the border of a smaller tile must be skipped.
+		/// </summary>
+		inline const std::vector<uint>& PixelOffsets() const { return pixelOffsets; }
 
 	private:
 		std::vector<RenderTile> tiles;
+		std::vector<uint> tileQueue;		// indices into tiles, in the order they are handed out
+		std::vector<uint> pixelOffsets;
 		uint currentTile;
+		RenderRegion focus;					// region prioritized while rendering
 		Lock syncLock;
-		std::atomic_int preRenderCount, postRenderCount;	// number of threads that reached the barrier
-		std::vector<HANDLE> preRenderEvents, postRenderEvents;
-		bool finished;
-		bool running;
+		std::atomic<uint> epoch;
 	};
 }
@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "TaskSystem.h"
+
+namespace TX {
+	namespace {
+		thread_local int currentWorker = -1;
+
+		std::mutex instanceLock;
+		TaskSystem::Options instanceOptions;
+		std::unique_ptr<TaskSystem> instance;
+
+#ifdef _WIN32
+		/// <summary>
+		/// Cores &amp; NUMA nodes of all the processor groups.
+		/// </summary>
+		std::vector<CpuInfo> DetectTopology() {
+			std::vector<CpuInfo> cpus;
+			DWORD size = 0;
+			GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+			std::vector<char> buffer(size);
+			auto info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data());
+			if (size == 0 || !GetLogicalProcessorInformationEx(RelationAll, info, &size))
+				return cpus;
+
+			std::vector<std::pair<GROUP_AFFINITY, int>> nodes;
+			int core = 0;
+			for (DWORD offset = 0; offset < size; offset += info->Size) {
+				info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data() + offset);
+				if (info->Relationship == RelationNumaNode) {
+					nodes.push_back(std::make_pair(info->NumaNode.GroupMask, int(info->NumaNode.NodeNumber)));
+				}
+				else if (info->Relationship == RelationProcessorCore) {
+					int smt = 0;
+					for (WORD g = 0; g < info->Processor.GroupCount; g++) {
+						const GROUP_AFFINITY& mask = info->Processor.GroupMask[g];
+						for (int bit = 0; bit < int(sizeof(KAFFINITY) * 8); bit++) {
+							if (!(mask.Mask & (KAFFINITY(1) << bit))) continue;
+							CpuInfo cpu = { bit, int(mask.Group), core, 0, smt++ };
+							cpus.push_back(cpu);
+						}
+					}
+					core++;
+				}
+			}
+			for (auto& cpu : cpus)
+				for (auto& node : nodes)
+					if (node.first.Group == cpu.group && (node.first.Mask & (KAFFINITY(1) << cpu.id)))
+						cpu.node = node.second;
+			return cpus;
+		}
+
+		void PinThread(HANDLE thread, const CpuInfo& cpu) {
+			GROUP_AFFINITY affinity;
+			std::memset(&affinity, 0, sizeof(affinity));
+			affinity.Group = WORD(cpu.group);
+			affinity.Mask = KAFFINITY(1) << cpu.id;
+			SetThreadGroupAffinity(thread, &affinity, nullptr);
+		}
+#else
+		bool ReadInt(const std::string& path, int& value) {
+			std::ifstream in(path);
+			return bool(in >> value);
+		}
+
+		/// <summary>
+		/// Parses a cpu list like "0-3,8,10-11".
+		/// </summary>
+		std::vector<int> ReadCpuList(const std::string& path) {
+			std::vector<int> ids;
+			std::ifstream in(path);
+			std::string range;
+			while (std::getline(in, range, ',')) {
+				int first, last;
+				char dash;
+				std::istringstream s(range);
+				if (!(s >> first)) continue;
+				last = (s >> dash >> last) ? last : first;
+				for (int id = first; id <= last; id++) ids.push_back(id);
+			}
+			return ids;
+		}
+
+		/// <summary>
+		/// Logical processors the process may run on, with their core &amp; node from sysfs.
+		/// </summary>
+		std::vector<CpuInfo> DetectTopology() {
+			std::vector<CpuInfo> cpus;
+			cpu_set_t allowed;
+			CPU_ZERO(&allowed);
+			if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+				return cpus;
+			std::map<int, int> nodeOf;
+			for (int node = 0; node < 1024; node++) {
+				std::vector<int> ids = ReadCpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+				if (ids.empty() && node > 0) break;
+				for (int id : ids) nodeOf[id] = node;
+			}
+			std::map<std::pair<int, int>, int> coreIds;		// (package, core id) -> core
+			std::map<int, int> siblings;						// core -> logical processors seen
+			for (int id = 0; id < CPU_SETSIZE; id++) {
+				if (!CPU_ISSET(id, &allowed)) continue;
+				std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+				int package = 0, coreId = id;
+				ReadInt(topology + "physical_package_id", package);
+				ReadInt(topology + "core_id", coreId);
+				auto key = std::make_pair(package, coreId);
+				if (!coreIds.count(key)) {
+					int core = int(coreIds.size());
+					coreIds[key] = core;
+				}
+				int core = coreIds[key];
+				CpuInfo cpu = { id, 0, core, nodeOf.count(id) ? nodeOf[id] : 0, siblings[core]++ };
+				cpus.push_back(cpu);
+			}
+			return cpus;
+		}
+
+		void PinThread(pthread_t thread, const CpuInfo& cpu) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu.id, &set);
+			pthread_setaffinity_np(thread, sizeof(set), &set);
+		}
+#endif
+
+		/// <summary>
+		/// One thread per physical core first, the cores of the nodes interleaved, then the SMT siblings.
+		/// </summary>
+		void SortForPinning(std::vector<CpuInfo>& cpus) {
+			std::map<int, int> rankInNode;
+			std::stable_sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+				return a.node != b.node ? a.node < b.node : a.core < b.core;
+			});
+			std::map<std::pair<int, int>, int> coreRank;		// rank of the core within its node
+			for (auto& cpu : cpus) {
+				auto key = std::make_pair(cpu.node, cpu.core);
+				if (!coreRank.count(key)) coreRank[key] = rankInNode[cpu.node]++;
+			}
+			std::stable_sort(cpus.begin(), cpus.end(), [&](const CpuInfo& a, const CpuInfo& b) {
+				int ra = coreRank[std::make_pair(a.node, a.core)], rb = coreRank[std::make_pair(b.node, b.core)];
+				if (a.smt != b.smt) return a.smt < b.smt;
+				if (ra != rb) return ra < rb;
+				return a.node < b.node;
+			});
+		}
+	}
+
+	TaskSystem& TaskSystem::Instance() {
+		std::lock_guard<std::mutex> lock(instanceLock);
+		if (!instance)
+			instance.reset(new TaskSystem(instanceOptions));
+		return *instance;
+	}
+
+	void TaskSystem::Configure(const Options& options) {
+		std::lock_guard<std::mutex> lock(instanceLock);
+		instanceOptions = options;
+	}
+
+	int TaskSystem::CurrentWorker() {
+		return currentWorker;
+	}
+
+	TaskSystem::TaskSystem(const Options& options) : pending_(0), sleeping_(0), shutdown_(false) {
+		cpus_ = DetectTopology();
+		SortForPinning(cpus_);
+		int logical = cpus_.empty() ? int(std::thread::hardware_concurrency()) : int(cpus_.size());
+		int threads = options.threads > 0 ? options.threads : Math::Max(1, logical - 1);
+
+		// the extra queue takes the tasks of the threads outside of the pool
+		for (int i = 0; i <= threads; i++)
+			queues_.push_back(std::unique_ptr<Queue>(new Queue));
+		// the waiting thread usually runs on the first processor, workers take the next ones
+		for (int i = 0; i < threads; i++)
+			if (!cpus_.empty()) queues_[i]->node = cpus_[(i + 1) % cpus_.size()].node;
+		for (int i = 0; i <= threads; i++) {
+			Queue& q = *queues_[i];
+			for (int v = 1; v <= threads; v++) {
+				int victim = (i + v) % (threads + 1);
+				q.victims.push_back(victim);
+			}
+			// victims of the same node first, the order is otherwise kept to spread the thieves
+			std::stable_partition(q.victims.begin(), q.victims.end(), [&](int v) { return queues_[v]->node == q.node; });
+		}
+
+		for (int i = 0; i < threads; i++) {
+			workers_.emplace_back(&TaskSystem::Work, this, i);
+			if (options.pin && !cpus_.empty())
+				PinThread(workers_.back().native_handle(), cpus_[(i + 1) % cpus_.size()]);
+		}
+	}
+
+	TaskSystem::~TaskSystem() {
+		{
+			std::lock_guard<std::mutex> lock(sleep_lock_);
+			shutdown_ = true;
+		}
+		wake_.notify_all();
+		for (auto& worker : workers_)
+			worker.join();
+	}
+
+	void TaskSystem::Submit(Task&& task) {
+		int worker = currentWorker >= 0 ? currentWorker : int(workers_.size());
+		Queue& q = *queues_[worker];
+		{
+			std::lock_guard<std::mutex> lock(q.lock);
+			q.tasks.push_back(std::move(task));
+		}
+		pending_++;
+		// only pay for the wake up if somebody sleeps
+		std::lock_guard<std::mutex> lock(sleep_lock_);
+		if (sleeping_ > 0) wake_.notify_one();
+	}
+
+	bool TaskSystem::Pop(int worker, Task& task) {
+		Queue& q = *queues_[worker];
+		std::lock_guard<std::mutex> lock(q.lock);
+		if (q.tasks.empty()) return false;
+		task = std::move(q.tasks.back());
+		q.tasks.pop_back();
+		return true;
+	}
+
+	bool TaskSystem::Steal(int worker, Task& task) {
+		for (int victim : queues_[worker]->victims) {
+			Queue& q = *queues_[victim];
+			std::lock_guard<std::mutex> lock(q.lock);
+			if (q.tasks.empty()) continue;
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	bool TaskSystem::RunOne(int worker) {
+		if (pending_ == 0) return false;
+		Task task;
+		if (!Pop(worker, task) && !Steal(worker, task))
+			return false;
+		pending_--;
+		Execute(task);
+		return true;
+	}
+
+	void TaskSystem::Execute(Task& task) {
+		TaskGroup *group = task.group;
+		try {
+			task.func();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(group->error_lock_);
+			if (!group->error_) group->error_ = std::current_exception();
+		}
+		// the group may be destroyed right after the last decrement
+		group->pending_.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	void TaskSystem::Work(int worker) {
+		currentWorker = worker;
+		while (true) {
+			if (RunOne(worker)) continue;
+			// spin a little before sleeping, tasks often come in bursts
+			bool found = false;
+			for (int i = 0; i < 64 && !found; i++) {
+				std::this_thread::yield();
+				found = pending_ > 0;
+			}
+			if (found) continue;
+			std::unique_lock<std::mutex> lock(sleep_lock_);
+			sleeping_++;
+			wake_.wait(lock, [this] { return shutdown_ || pending_ > 0; });
+			sleeping_--;
+			if (shutdown_) return;
+		}
+	}
+
+	TaskGroup::~TaskGroup() {
+		// the tasks reference the group, it can't go away before them
+		while (pending_ > 0)
+			if (!system_.RunOne(TaskSystem::CurrentWorker() >= 0 ? TaskSystem::CurrentWorker() : int(system_.workers_.size())))
+				std::this_thread::yield();
+	}
+
+	void TaskGroup::Run(TaskSystem::Func func) {
+		pending_++;
+		TaskSystem::Task task;
+		task.func = std::move(func);
+		task.group = this;
+		system_.Submit(std::move(task));
+	}
+
+	void TaskGroup::Wait() {
+		int worker = TaskSystem::CurrentWorker() >= 0 ? TaskSystem::CurrentWorker() : int(system_.workers_.size());
+		while (pending_.load(std::memory_order_acquire) > 0)
+			if (!system_.RunOne(worker))
+				std::this_thread::yield();
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(error_lock_);
+			std::swap(error, error_);
+		}
+		if (error)
+			std::rethrow_exception(error);
+	}
+}
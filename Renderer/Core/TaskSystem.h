@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TX {
+	class TaskGroup;
+
+	/// <summary>
+	/// Logical processor of the machine, as seen by the task system.
+	/// </summary>
+	struct CpuInfo {
+		int id;					// index of the logical processor, within its group on Windows
+		int group;				// processor group on Windows, 0 elsewhere
+		int core;				// physical core, shared by SMT siblings
+		int node;				// NUMA node
+		int smt;				// 0 for the first thread of a core, 1+ for its siblings
+	};
+
+	/// <summary>
+	/// Pool of workers running fork/join tasks, shared by the scene build, the loaders and the renderer.
+	/// Every worker owns a deque: it pushes &amp; pops its own tasks at the back (depth first, cache warm)
+	/// while idle workers steal from the front of the others (the biggest pieces of work), trying the ones of their NUMA node first.
+	/// Threads waiting for a TaskGroup run pending tasks meanwhile, so tasks may wait for nested tasks without deadlocking.
+	/// Workers are pinned one per physical core first, SMT siblings last, spread over the NUMA nodes.
+	/// </summary>
+	class TaskSystem {
+	public:
+		typedef std::function<void()> Func;
+
+		struct Options {
+			int threads = 0;		// workers, 0 for one less than the logical processors as the waiting thread helps
+			bool pin = true;		// pin every worker to a logical processor
+		};
+
+		/// <summary>
+		/// The shared pool, started on first use.
+		/// </summary>
+		static TaskSystem& Instance();
+		/// <summary>
+		/// Sets the options of the shared pool, only effective before its first use.
+		/// </summary>
+		static void Configure(const Options& options);
+
+		explicit TaskSystem(const Options& options);
+		TaskSystem(const TaskSystem&) = delete;
+		TaskSystem& operator = (const TaskSystem&) = delete;
+		~TaskSystem();
+
+		/// <summary>
+		/// Number of threads running tasks, the workers plus the waiting thread.
+		/// </summary>
+		inline int Concurrency() const { return int(workers_.size()) + 1; }
+		/// <summary>
+		/// Logical processors in pinning order.
+		/// </summary>
+		inline const std::vector<CpuInfo>& Topology() const { return cpus_; }
+
+		/// <summary>
+		/// Index of the worker running the calling thread, -1 for other threads.
+		/// </summary>
+		static int CurrentWorker();
+	private:
+		friend class TaskGroup;
+		struct Task {
+			Func func;
+			TaskGroup *group;
+		};
+		/// <summary>
+		/// Deque of a worker, on its own cache line.
+		/// </summary>
+		struct alignas(64) Queue {
+			std::mutex lock;
+			std::deque<Task> tasks;
+			std::vector<int> victims;		// other queues in stealing order
+			int node = 0;
+		};
+
+		void Submit(Task&& task);
+		/// <summary>
+		/// Runs one task, from the own queue of the calling worker first.
+		/// </summary>
+		/// <returns> False if there was nothing to run </returns>
+		bool RunOne(int worker);
+		bool Pop(int worker, Task& task);
+		bool Steal(int worker, Task& task);
+		void Work(int worker);
+		void Execute(Task& task);
+	private:
+		std::vector<CpuInfo> cpus_;
+		std::vector<std::unique_ptr<Queue>> queues_;	// one per worker, the last one for the other threads
+		std::vector<std::thread> workers_;
+		std::atomic<int> pending_;		// tasks queued & not started
+
+		std::mutex sleep_lock_;
+		std::condition_variable wake_;
+		int sleeping_;
+		bool shutdown_;
+	};
+
+	/// <summary>
+	/// Set of tasks that can be waited for together, the first exception thrown by one of them is rethrown by Wait().
+	/// </summary>
+	class TaskGroup {
+	public:
+		explicit TaskGroup(TaskSystem& system = TaskSystem::Instance()) : system_(system), pending_(0) {}
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator = (const TaskGroup&) = delete;
+		~TaskGroup();
+
+		void Run(TaskSystem::Func func);
+		/// <summary>
+		/// Runs pending tasks until the ones of the group are done.
+		/// </summary>
+		void Wait();
+	private:
+		friend class TaskSystem;
+		TaskSystem& system_;
+		std::atomic<int> pending_;
+		std::mutex error_lock_;
+		std::exception_ptr error_;
+	};
+
+	/// <summary>
+	/// Calls body(begin, end) on consecutive ranges covering [begin, end) in parallel, returns when all are done.
+	/// </summary>
+	/// <param name="grain"> Minimum size of a range, 0 to split into a few ranges per thread </param>
+	template<typename Body>
+	void ParallelFor(size_t begin, size_t end, const Body& body, size_t grain = 0) {
+		if (end <= begin) return;
+		TaskSystem& system = TaskSystem::Instance();
+		if (grain == 0)
+			grain = (end - begin + 4 * system.Concurrency() - 1) / (4 * system.Concurrency());
+		if (grain == 0) grain = 1;
+		if (end - begin <= grain) {
+			body(begin, end);
+			return;
+		}
+		// ranges are split in halves, so thieves take the biggest pieces first.
+		// split outlives the group: if body throws here, the group still runs the queued ranges when it goes away
+		std::function<void(size_t, size_t)> split;
+		TaskGroup group(system);
+		split = [&](size_t b, size_t e) {
+			while (e - b > grain) {
+				size_t mid = b + (e - b) / 2;
+				group.Run([&split, mid, e] { split(mid, e); });
+				e = mid;
+			}
+			body(b, e);
+		};
+		split(begin, end);
+		group.Wait();
+	}
+}
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+
+#include "txbase/scene/camera.h"
+
+#include "TileKernel.h"
+#include "RendererConfig.h"
+#include "Accumulator.h"
+#include "Core/Scene.h"
+
+namespace TX {
+	namespace {
+		/// <summary>
+		/// Instantiated for every final class of tracer so the per pixel calls are bound at compile time,
+		/// and once for the base class, which goes through the virtual functions.
+		/// The sampler is always called through its base class: the tracers draw most dimensions through PixelSample.
+		/// </summary>
+		template<typename T>
+		int TraceTile(const TilePass& p, const RenderTile& tile){
+			T& tracer = static_cast<T&>(*p.tracer);
+			const Sampler& sampler = *p.sampler;
+			const uint64_t sequence = uint64_t(p.pass) << 1 | 1;
+			auto GenerateRay = [&](int x, int y, PixelSample& sample, Ray *ray){
+				// the position in the pixel is the first group, taken from the sampler directly
+				sample = sampler.StartPixel(x, y, p.pass, p.seed);
+				float offset[2];
+				sampler.Generate(sample, 0, 2, offset);
+				sample.Skip(1);
+				p.camera->GenerateRay(ray, x + offset[0], y + offset[1]);
+			};
+			if (tracer.Batched()){
+				// the whole tile is traced at once
+				RayBatch& batch = *p.batch;
+				batch.Clear();
+				batch.SetCancel(p.cancel);
+				for (uint offset : *p.offsets){
+					int x = tile.xmin + (offset & 0xffff);
+					int y = tile.ymin + (offset >> 16);
+					if (x >= tile.xmax || y >= tile.ymax) continue;
+					int i = batch.Add(x, y, RandomStream::PixelSeed(x, y, p.seed), sequence);
+					GenerateRay(x, y, batch.Samples(i), &batch.GetRay(i));
+				}
+				if (p.cancel.Canceled()) return 0;
+				tracer.Trace(p.scene, batch);
+				// the tracer gives up on the batch as soon as the pass is canceled
+				if (p.cancel.Canceled()) return 0;
+				for (int i = 0; i < batch.Size(); i++)
+					p.accum->Commit(batch.X(i) - p.film_x, batch.Y(i) - p.film_y, batch.GetColor(i));
+				return batch.Size();
+			}
+			PixelSample sample;
+			Ray ray;
+			Color c;
+			int samples = 0;
+			for (uint offset : *p.offsets){
+				int x = tile.xmin + (offset & 0xffff);
+				int y = tile.ymin + (offset >> 16);
+				if (x >= tile.xmax || y >= tile.ymax) continue;
+				if (p.cancel.Canceled()) break;
+				GenerateRay(x, y, sample, &ray);
+				p.random->Seed(RandomStream::PixelSeed(x, y, p.seed), sequence);
+				RayTracer::TraceAs(tracer, p.scene, ray, sample, *p.random, &c);
+				p.accum->Commit(x - p.film_x, y - p.film_y, c);
+				samples++;
+			}
+			return samples;
+		}
+	}
+
+	TileKernel SelectTileKernel(const RendererConfig& config){
+		if (!config.static_dispatch)
+			return &TraceTile<RayTracer>;
+		switch (config.tracer_t){
+		case RenderMethod::DirectLighting:			return &TraceTile<DirectLighting>;
+		case RenderMethod::PathTracing:				return &TraceTile<PathTracing>;
+		case RenderMethod::WavefrontPathTracing:	return &TraceTile<WavefrontPathTracing>;
+		case RenderMethod::ResampledDirectLighting:	return &TraceTile<ResampledDirectLighting>;
+		default:
+			throw "unimplemented";
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "Synchronizer.h"
+
+namespace TX {
+	class Scene;
+	class Camera;
+	class Accumulator;
+
+	/// <summary>
+	/// What a worker needs to render the tiles of one sample pass, the same for the Renderer and the RenderQueue.
+	/// The tracer &amp; sampler must have been made from the config the kernel is picked with.
+	/// </summary>
+	struct TilePass {
+		const Scene *scene;
+		const Camera *camera;
+		RayTracer *tracer;
+		const Sampler *sampler;
+		const std::vector<uint> *offsets;	// pixels of a tile in the order they are traced
+		RandomStream *random;
+		RayBatch *batch;
+		Accumulator *accum;
+		int film_x, film_y;					// position of the accumulator in the frame
+		uint64_t seed;
+		int pass;
+		CancelToken cancel;
+	};
+
+	/// <summary>
+	/// Renders one sample of every pixel of the tile into the accumulator, stops as soon as the pass is canceled.
+	/// </summary>
+	/// <returns> Number of samples committed, meaningless once canceled </returns>
+	typedef int (*TileKernel)(const TilePass& pass, const RenderTile& tile);
+
+	/// <summary>
+	/// Picks the kernel instantiated for the final class of the tracer of the config,
+	/// or the one calling it through its base class if the config turns static dispatch off.
+	/// </summary>
+	TileKernel SelectTileKernel(const RendererConfig& config);
+}
@@ -7,9 +7,11 @@
 #include "Core/Scene.h"
 
 namespace TX{
+	const size_t DirectLighting::MAX_EXHAUSTIVE_LIGHTS = 16;
+
 	DirectLighting::DirectLighting(int maxdepth) : RayTracer(maxdepth){}
 
-	Color DirectLighting::Li(const Scene *scene, const Ray& ray, int depth, const CameraSample& samplebuf){
+	Color DirectLighting::Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample){
 		if (depth < 0)
 			return Color::BLACK;
 		LocalGeo geom;
@@ -18,13 +20,21 @@ namespace TX{
 			scene->PostIntersect(ray, geom);
 			geom.ComputeDifferentials(ray);
 
-			for (auto light = scene->lights.begin(); light < scene->lights.end(); light++){
-				color += EstimateDirect(scene, ray, geom, light->get(), &Sample(), &Sample());
+			if (scene->lights.size() <= MAX_EXHAUSTIVE_LIGHTS){
+				for (auto light = scene->lights.begin(); light < scene->lights.end(); light++){
+					color += EstimateDirect(scene, ray, geom, light->get(), &Sample(), &Sample());
+				}
+			}
+			else {
+				// too many lights to visit all of them, pick one per sample
+				Sample lightsample = sample.Get3D();
+				Sample bsdfsample = sample.Get3D();
+				color += SampleOneLight(scene, ray, geom, &lightsample, &bsdfsample);
 			}
 
 			if (depth >= 0){
-				color += TraceSpecularReflect(scene, ray, geom, depth - 1, samplebuf);
-				color += TraceSpecularTransmit(scene, ray, geom, depth - 1, samplebuf);
+				color += TraceSpecularReflect(scene, ray, geom, depth - 1, sample);
+				color += TraceSpecularTransmit(scene, ray, geom, depth - 1, sample);
 			}
 		}
 		else {
@@ -33,8 +43,4 @@ namespace TX{
 		}
 		return color;
 	}
-
-	void DirectLighting::BakeSamples(const Scene *scene, const CameraSample *samplebuf){
-		return;
-	}
 }
@@ -4,13 +4,14 @@
 #include <vector>
 
 namespace TX{
-	class DirectLighting : public RayTracer {
+	class DirectLighting final : public RayTracer {
+		friend class RayTracer;
 	public:
 		DirectLighting(int maxdepth = 5);
 		~DirectLighting(){}
-
-		void BakeSamples(const Scene *scene, const CameraSample *samplebuf);
 	protected:
-		Color Li(const Scene *scene, const Ray& ray, int depth, const CameraSample& samplebuf);
+		Color Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample);
+	private:
+		static const size_t MAX_EXHAUSTIVE_LIGHTS;		// above, the light BVH picks one light per sample
 	};
 }
@@ -10,13 +10,9 @@
 namespace TX{
 	const int PathTracing::SAMPLE_DEPTH = 3;
 
-	PathTracing::PathTracing(int maxdepth) : RayTracer(maxdepth){
-		light_samples_.resize(maxdepth);
-		bsdf_samples_.resize(maxdepth);
-		scatter_samples_.resize(maxdepth);
-	}
+	PathTracing::PathTracing(int maxdepth) : RayTracer(maxdepth){}
 
-	Color PathTracing::Li(const Scene *scene, const Ray& ray, int ignoreddepth, const CameraSample& samplebuf){
+	Color PathTracing::Li(const Scene *scene, const Ray& ray, int ignoreddepth, PixelSample& sample){
 		Color Le, L, pathThroughput = Color::WHITE;
 		Vec3 wo, wi;
 		float pdf;
@@ -24,11 +20,10 @@ namespace TX{
 		Ray pathRay;
 		LocalGeo geom;
 
-		auto countLights = scene->lights.size();
 		bool specBounce = true;
 
 		pathRay = ray;
-		const Sample *lightsample, *bsdfsample, *scattersample;
+		Sample lightsample, bsdfsample, scattersample;
 
 		for (int bounce = 0; bounce < maxdepth_; ++bounce){
 			if (scene->Intersect(pathRay, geom)){
@@ -36,6 +31,10 @@ namespace TX{
 				geom.ComputeDifferentials(pathRay);
 
 				wo = -pathRay.dir;
+				// taken whether used or not, so the dimensions of a bounce do not depend on the previous ones
+				lightsample = sample.Get3D();
+				bsdfsample = sample.Get3D();
+				scattersample = sample.Get3D();
 
 				// Emit radiance if the intersection is emitter
 				if (specBounce){
@@ -43,14 +42,9 @@ namespace TX{
 					L += pathThroughput * Le;
 				}
 
-				if (!geom.bsdf->IsSpecular()){
-					lightsample = light_samples_[bounce](samplebuf);
-					bsdfsample = bsdf_samples_[bounce](samplebuf);
-					int lightIdx = (int)Math::Min(lightsample->w * countLights, countLights - 1);
-					L += pathThroughput * EstimateDirect(scene, pathRay, geom, scene->lights[lightIdx].get(), lightsample, bsdfsample);
-				}
-				scattersample = scatter_samples_[bounce](samplebuf);
-				Color f = geom.bsdf->SampleDirect(wo, geom, *scattersample, &wi, &pdf, BSDF_ALL, &sampled);
+				if (!geom.bsdf->IsSpecular())
+					L += pathThroughput * SampleOneLight(scene, pathRay, geom, &lightsample, &bsdfsample);
+				Color f = geom.bsdf->SampleDirect(wo, geom, scattersample, &wi, &pdf, BSDF_ALL, &sampled);
 				if (f == Color::BLACK || pdf == 0.f)
 					break;
 				specBounce = (sampled & BSDF_SPECULAR) != 0;
@@ -75,13 +69,4 @@ namespace TX{
 		}
 		return L;
 	}
-
-	void PathTracing::BakeSamples(const Scene *scene, const CameraSample *samplebuf){
-		for (auto i = 0; i < maxdepth_; ++i)
-		{
-			light_samples_[i].RequestSamples(1, samplebuf);
-			bsdf_samples_[i].RequestSamples(1, samplebuf);
-			scatter_samples_[i].RequestSamples(1, samplebuf);
-		}
-	}
 }
@@ -4,17 +4,17 @@
 #include "Core/RayTracer.h"
 
 namespace TX{
-	class PathTracing : public RayTracer {
+	class PathTracing final : public RayTracer {
+		friend class RayTracer;
 	public:
 		PathTracing(int maxdepth = 6);
 		~PathTracing(){}
-		void BakeSamples(const Scene *scene, const CameraSample *samplebuf);
 	protected:
-		Color Li(const Scene *scene, const Ray& ray, int depth, const CameraSample& samplebuf);
+		/// <summary>
+		/// Every bounce that hits takes three groups of sample dimensions: light, BSDF &amp; scattering.
+		/// </summary>
+		Color Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample);
 	private:
 		static const int SAMPLE_DEPTH;
-		std::vector<SampleOffset> light_samples_;
-		std::vector<SampleOffset> bsdf_samples_;
-		std::vector<SampleOffset> scatter_samples_;
 	};
 }
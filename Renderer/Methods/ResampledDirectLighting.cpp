@@ -0,0 +1,214 @@
+#include "stdafx.h"
+#include "txbase/math/sample.h"
+
+#include "ResampledDirectLighting.h"
+#include "Core/Intersection.h"
+#include "Core/BSDF.h"
+#include "Core/Scene.h"
+#include "Core/Light.h"
+#include "Accelerators/LightBVH.h"
+
+namespace TX{
+	const int ResampledDirectLighting::REUSE_RADIUS = 8;
+
+	ResampledDirectLighting::ResampledDirectLighting(int maxdepth, int candidates, int neighbors)
+		: RayTracer(maxdepth), candidates_(Math::Max(1, candidates)), neighbors_(Math::Max(0, neighbors)){}
+
+	bool ResampledDirectLighting::Reservoir::Update(const Light *light, const Vec3& point, const Vec3& normal, float target, float weight, float u){
+		wsum += weight;
+		if (weight > 0.f && u * wsum < weight){
+			this->light = light;
+			this->point = point;
+			this->normal = normal;
+			this->target = target;
+			return true;
+		}
+		return false;
+	}
+
+	float ResampledDirectLighting::Target(const LocalGeo& geom, const Vec3& wo, const Light *light, const Vec3& point, const Vec3& normal, Color *contribution, Ray *shadowray){
+		Ray lightray;
+		Color lightcolor;
+		float geometry;
+		if (light->IsDelta()){
+			Sample unused;
+			float pdf;
+			light->SampleDirect(geom.point, &unused, &lightray, &lightcolor, &pdf);
+			geometry = 1.f;
+		}
+		else {
+			const Vec3 d = point - geom.point;
+			const float dist2 = Math::Dot(d, d);
+			lightray.SetSegment(geom.point, point);
+			static_cast<const AreaLight *>(light)->Emit(point, normal, -lightray.dir, &lightcolor);
+			// solid angle at the shading point to area of the light
+			geometry = dist2 > 0.f ? Math::AbsDot(normal, lightray.dir) / dist2 : 0.f;
+		}
+		if (lightcolor == Color::BLACK || !(geometry > 0.f))
+			return 0.f;
+		Color c = geom.bsdf->Eval(lightray.dir, wo, geom, BSDFType(BSDF_ALL & ~BSDF_SPECULAR)) * lightcolor *
+			(Math::AbsDot(lightray.dir, geom.normal) * geometry);
+		if (contribution) *contribution = c;
+		if (shadowray) *shadowray = lightray;
+		return Math::Max(0.f, c.Luminance());
+	}
+
+	void ResampledDirectLighting::Candidates(const Scene *scene, const LocalGeo& geom, const Vec3& wo, RandomStream& rng, Reservoir *reservoir) const{
+		const LightBVH& lights = scene->GetLightBVH();
+		for (int i = 0; i < candidates_; i++){
+			reservoir->M++;
+			Sample sample;
+			float u = rng.Float();
+			sample.u = rng.Float();
+			sample.v = rng.Float();
+			float pick_pmf;
+			const Light *light = lights.Sample(geom.point, geom.normal, u, &pick_pmf, &sample.w);
+			if (!light)
+				continue;
+			// source pdf of the candidate: the pick times, for area lights, the pdf of the point per area
+			Vec3 point, normal;
+			float pdf = pick_pmf;
+			if (!light->IsDelta()){
+				float area_pdf;
+				static_cast<const AreaLight *>(light)->SamplePoint(geom.point, &sample, &point, &normal, &area_pdf);
+				pdf *= area_pdf;
+			}
+			float target = pdf > 0.f ? Target(geom, wo, light, point, normal) : 0.f;
+			float weight = target > 0.f ? target / pdf : 0.f;
+			reservoir->Update(light, point, normal, target, weight, rng.Float());
+		}
+		reservoir->W = reservoir->target > 0.f ? reservoir->wsum / (reservoir->M * reservoir->target) : 0.f;
+	}
+
+	Color ResampledDirectLighting::Shade(const Scene *scene, const LocalGeo& geom, const Vec3& wo, const Reservoir& reservoir){
+		if (!reservoir.light || reservoir.W == 0.f)
+			return Color::BLACK;
+		Color contribution;
+		Ray shadowray;
+		if (Target(geom, wo, reservoir.light, reservoir.point, reservoir.normal, &contribution, &shadowray) == 0.f || scene->Occlude(shadowray))
+			return Color::BLACK;
+		return contribution * reservoir.W;
+	}
+
+	Color ResampledDirectLighting::Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample){
+		if (depth < 0)
+			return Color::BLACK;
+		LocalGeo geom;
+		Color color, Le;
+		if (scene->Intersect(ray, geom)){
+			scene->PostIntersect(ray, geom);
+			geom.ComputeDifferentials(ray);
+			geom.Emit(-ray.dir, &Le);
+			color += Le;
+
+			if (!geom.bsdf->IsSpecular()){
+				Reservoir reservoir;
+				Candidates(scene, geom, -ray.dir, *rng_, &reservoir);
+				color += Shade(scene, geom, -ray.dir, reservoir);
+			}
+			color += TraceSpecularReflect(scene, ray, geom, depth - 1, sample);
+			color += TraceSpecularTransmit(scene, ray, geom, depth - 1, sample);
+		}
+		else {
+			// TODO environment map
+			color = Color(ray.dir.x, ray.dir.y, ray.dir.z) * 0.5f + 0.5f;
+		}
+		return color;
+	}
+
+	void ResampledDirectLighting::Trace(const Scene *scene, RayBatch& batch){
+		const int n = batch.Size();
+		if (n == 0) return;
+		hits_.resize(n);
+		rngs_.resize(n);
+		shaded_.assign(n, 0);
+		reservoirs_.assign(n, Reservoir());
+		reused_.assign(n, Reservoir());
+
+		// pixels of the tile, to find the neighbors
+		int xmin = batch.X(0), ymin = batch.Y(0), xmax = xmin, ymax = ymin;
+		for (int i = 1; i < n; i++){
+			xmin = Math::Min(xmin, batch.X(i)); xmax = Math::Max(xmax, batch.X(i));
+			ymin = Math::Min(ymin, batch.Y(i)); ymax = Math::Max(ymax, batch.Y(i));
+		}
+		const int width = xmax - xmin + 1, height = ymax - ymin + 1;
+		pixel_index_.assign(width * height, -1);
+		for (int i = 0; i < n; i++)
+			pixel_index_[(batch.Y(i) - ymin) * width + batch.X(i) - xmin] = i;
+
+		// primary hits, emission, specular chains & the reservoirs of every pixel
+		Color Le;
+		for (int i = 0; i < n; i++){
+			if (batch.Canceled()) return;
+			const Ray& ray = batch.GetRay(i);
+			LocalGeo& geom = hits_[i];
+			Color& color = batch.GetColor(i);
+			rngs_[i] = RandomStream(batch.Seed(i), batch.Sequence(i));
+			rng_ = &rngs_[i];
+			color = Color::BLACK;
+			if (scene->Intersect(ray, geom)){
+				scene->PostIntersect(ray, geom);
+				geom.ComputeDifferentials(ray);
+				geom.Emit(-ray.dir, &Le);
+				color += Le;
+				if (!geom.bsdf->IsSpecular()){
+					shaded_[i] = 1;
+					Candidates(scene, geom, -ray.dir, rngs_[i], &reservoirs_[i]);
+				}
+				color += TraceSpecularReflect(scene, ray, geom, maxdepth_ - 1, batch.Samples(i));
+				color += TraceSpecularTransmit(scene, ray, geom, maxdepth_ - 1, batch.Samples(i));
+			}
+			else {
+				color = Color(ray.dir.x, ray.dir.y, ray.dir.z) * 0.5f + 0.5f;
+			}
+		}
+
+		// spatial reuse, every pixel resamples its reservoir with those of close pixels of similar geometry
+		std::vector<int> used;
+		for (int i = 0; i < n; i++){
+			if (batch.Canceled()) return;
+			if (!shaded_[i]) continue;
+			const LocalGeo& geom = hits_[i];
+			const Vec3 wo = -batch.GetRay(i).dir;
+			const float dist = Math::Dist(batch.GetRay(i).origin, geom.point);
+			RandomStream& rng = rngs_[i];
+			Reservoir& r = reused_[i];
+
+			const Reservoir& own = reservoirs_[i];
+			r.Update(own.light, own.point, own.normal, own.target, own.target * own.W * own.M, rng.Float());
+			r.M += own.M;
+			used.assign(1, i);
+			for (int k = 0; k < neighbors_; k++){
+				int x = batch.X(i) + int((rng.Float() * 2.f - 1.f) * REUSE_RADIUS) - xmin;
+				int y = batch.Y(i) + int((rng.Float() * 2.f - 1.f) * REUSE_RADIUS) - ymin;
+				if (x < 0 || x >= width || y < 0 || y >= height) continue;
+				int j = pixel_index_[y * width + x];
+				if (j < 0 || j == i || !shaded_[j]) continue;
+				if (Math::Dot(geom.normal, hits_[j].normal) < 0.9f ||
+					Math::Abs(Math::Dist(batch.GetRay(j).origin, hits_[j].point) - dist) > 0.1f * dist)
+					continue;
+				// W of the neighbor is per area of the light like the target here, the sample needs no change of measure
+				const Reservoir& q = reservoirs_[j];
+				float target = q.light ? Target(geom, wo, q.light, q.point, q.normal) : 0.f;
+				r.Update(q.light, q.point, q.normal, target, target * q.W * q.M, rng.Float());
+				r.M += q.M;
+				used.push_back(j);
+			}
+
+			// only the pixels that could have produced the kept sample count in the normalization
+			int Z = 0;
+			if (r.light){
+				for (int j : used)
+					if (j == i || Target(hits_[j], -batch.GetRay(j).dir, r.light, r.point, r.normal) > 0.f)
+						Z += reservoirs_[j].M;
+			}
+			r.W = r.target > 0.f && Z > 0 ? r.wsum / (Z * r.target) : 0.f;
+		}
+
+		// one shadow ray per pixel
+		for (int i = 0; i < n && !batch.Canceled(); i++){
+			if (shaded_[i])
+				batch.GetColor(i) += Shade(scene, hits_[i], -batch.GetRay(i).dir, reused_[i]);
+		}
+	}
+}
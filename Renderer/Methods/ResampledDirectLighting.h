@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include "txbase/math/sample.h"
+#include "Core/RayTracer.h"
+#include "Core/Intersection.h"
+
+namespace TX{
+	class Light;
+
+	/// <summary>
+	/// Direct lighting with resampled importance sampling: many light samples are drawn per shading point
+	/// without shadow rays, one of them is kept in proportion to its unshadowed contribution
+	/// and only that one is tested for visibility.
+	/// Traced per tile, the reservoirs of a tile can also be combined with those of close pixels
+	/// with similar geometry before the visibility test (spatial reuse).
+	/// Samples of area lights are points on the light, with their target &amp; pdf w.r.t. the area of the light,
+	/// so a sample &amp; its weight mean the same at every shading point and need no change of measure when reused.
+	/// </summary>
+	class ResampledDirectLighting final : public RayTracer {
+		friend class RayTracer;
+	public:
+		/// <param name="candidates"> Light samples drawn per shading point </param>
+		/// <param name="neighbors"> Reservoirs of other pixels combined per pixel, 0 disables the spatial reuse </param>
+		ResampledDirectLighting(int maxdepth = 5, int candidates = 32, int neighbors = 0);
+		~ResampledDirectLighting(){}
+
+		using RayTracer::Trace;
+		void Trace(const Scene *scene, RayBatch& batch);
+		bool Batched() const { return neighbors_ > 0; }
+	protected:
+		Color Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample);
+	private:
+		/// <summary>
+		/// Light sample kept out of a stream of weighted candidates.
+		/// For area lights the point on the light is stored, any shading point evaluates that same point.
+		/// Delta lights have a single point, only the light is used.
+		/// </summary>
+		struct Reservoir {
+			const Light *light = nullptr;
+			Vec3 point, normal;		// on an area light
+			float target = 0.f;		// unshadowed luminance of the kept sample at the shading point of the owner
+			float wsum = 0.f;
+			int M = 0;				// number of candidates seen
+			float W = 0.f;			// weight of the kept sample, stands in for 1 / pdf w.r.t. the area of the light
+
+			bool Update(const Light *light, const Vec3& point, const Vec3& normal, float target, float weight, float u);
+		};
+
+		/// <summary>
+		/// Unshadowed contribution of a point of a light to a shading point, per area of the light.
+		/// Delta lights ignore the point, their contribution is per light.
+		/// </summary>
+		/// <returns> Its luminance, the target function of the resampling </returns>
+		static float Target(const LocalGeo& geom, const Vec3& wo, const Light *light, const Vec3& point, const Vec3& normal, Color *contribution = nullptr, Ray *shadowray = nullptr);
+		/// <summary>
+		/// Resamples the candidates of one shading point.
+		/// </summary>
+		void Candidates(const Scene *scene, const LocalGeo& geom, const Vec3& wo, RandomStream& rng, Reservoir *reservoir) const;
+		/// <summary>
+		/// Traces the shadow ray of the kept sample.
+		/// </summary>
+		static Color Shade(const Scene *scene, const LocalGeo& geom, const Vec3& wo, const Reservoir& reservoir);
+	private:
+		const int candidates_;
+		const int neighbors_;
+		static const int REUSE_RADIUS;		// in pixels
+
+		// per pixel state of the tile being traced
+		std::vector<LocalGeo> hits_;
+		std::vector<RandomStream> rngs_;
+		std::vector<char> shaded_;			// the hit has a diffuse/glossy BSDF and gets a reservoir
+		std::vector<Reservoir> reservoirs_, reused_;
+		std::vector<int> pixel_index_;		// index in the batch of the pixels of the tile, -1 for none
+	};
+}
@@ -0,0 +1,294 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "txbase/math/sample.h"
+
+#include "WavefrontPathTracing.h"
+#include "Core/Intersection.h"
+#include "Core/Scene.h"
+#include "Core/BSDF.h"
+#include "Accelerators/LightBVH.h"
+
+namespace TX{
+	const int WavefrontPathTracing::SAMPLE_DEPTH = 3;
+
+	WavefrontPathTracing::WavefrontPathTracing(int maxdepth, bool sortShading) : RayTracer(maxdepth), sort_shading_(sortShading){}
+
+	void WavefrontPathTracing::Trace(const Scene *scene, RayBatch& batch){
+		pool_.Resize(batch.Size());
+		for (int i = 0; i < batch.Size(); i++)
+			pool_.Start(i, batch.GetRay(i), batch.Samples(i), RandomStream(batch.Seed(i), batch.Sequence(i)));
+		TracePool(scene, batch.Cancel());
+		for (int i = 0; i < batch.Size(); i++)
+			batch.GetColor(i) = pool_.Radiance(i);
+	}
+
+	Color WavefrontPathTracing::Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample){
+		pool_.Resize(1);
+		pool_.Start(0, ray, sample, *rng_);
+		TracePool(scene);
+		*rng_ = pool_.rngs[0];
+		sample = pool_.samples[0];
+		return pool_.Radiance(0);
+	}
+
+	void WavefrontPathTracing::TracePool(const Scene *scene, const CancelToken& cancel){
+		for (int bounce = 0; bounce < maxdepth_ && !pool_.active.empty() && !cancel.Canceled(); ++bounce){
+			Extend(scene);
+			Shade(scene);
+			Connect(scene);
+			Update(bounce);
+		}
+	}
+
+	void WavefrontPathTracing::Extend(const Scene *scene){
+		PathPool& p = pool_;
+		p.hit.clear();
+		for (uint path : p.active){
+			if (scene->Intersect(p.rays[path], p.hits[path]))
+				p.hit.push_back(path);
+			else if (p.specular[path]){
+				// TODO environment light
+				p.radiance_r[path] += p.throughput_r[path] * p.background_r[path];
+				p.radiance_g[path] += p.throughput_g[path] * p.background_g[path];
+				p.radiance_b[path] += p.throughput_b[path] * p.background_b[path];
+			}
+		}
+		for (uint path : p.hit){
+			scene->PostIntersect(p.rays[path], p.hits[path]);
+			p.hits[path].ComputeDifferentials(p.rays[path]);
+		}
+
+		// group the paths by material, BSDFs of the same kind next to each other
+		if (sort_shading_){
+			std::sort(p.hit.begin(), p.hit.end(), [&p](uint a, uint b){
+				const BSDF *ba = p.hits[a].bsdf, *bb = p.hits[b].bsdf;
+				if (ba->GetKind() != bb->GetKind()) return ba->GetKind() < bb->GetKind();
+				if (ba != bb) return ba < bb;
+				return a < b;
+			});
+		}
+	}
+
+	void WavefrontPathTracing::Shade(const Scene *scene){
+		PathPool& p = pool_;
+		shadow_.Clear();
+		mis_.Clear();
+		p.scattered.clear();
+
+		// one dispatch per run of hits with the same kind of BSDF, a single run per kind once sorted
+		const uint *begin = p.hit.data(), *hitend = begin + p.hit.size();
+		while (begin != hitend){
+			const BSDF::Kind kind = p.hits[*begin].bsdf->GetKind();
+			const uint *end = begin + 1;
+			while (end != hitend && p.hits[*end].bsdf->GetKind() == kind)
+				++end;
+			switch (kind){
+			case BSDF::Kind::Diffuse:	ShadeRun<Diffuse>(scene, begin, end); break;
+			case BSDF::Kind::Mirror:	ShadeRun<Mirror>(scene, begin, end); break;
+			default:					ShadeRun<Dielectric>(scene, begin, end); break;
+			}
+			begin = end;
+		}
+	}
+
+	template<typename T>
+	void WavefrontPathTracing::ShadeRun(const Scene *scene, const uint *begin, const uint *end){
+		PathPool& p = pool_;
+		Color Le;
+		Vec3 wi;
+		float pdf;
+		BSDFType sampled;
+
+		for (const uint *it = begin; it != end; ++it){
+			const uint path = *it;
+			const LocalGeo& geom = p.hits[path];
+			const T& bsdf = static_cast<const T&>(*geom.bsdf);
+			const Ray& ray = p.rays[path];
+			const Vec3 wo = -ray.dir;
+			PixelSample& sample = p.samples[path];
+			const Sample lightsample = sample.Get3D();
+			const Sample bsdfsample = sample.Get3D();
+			const Sample scattersample = sample.Get3D();
+
+			// Emit radiance if the intersection is emitter
+			if (p.specular[path]){
+				geom.Emit(wo, &Le);
+				p.AddRadiance(path, p.Throughput(path) * Le);
+			}
+
+			if (!bsdf.IsSpecular())
+				QueueDirect(scene, path, ray, geom, bsdf, &lightsample, &bsdfsample);
+
+			Color f = bsdf.SampleDirect(wo, geom, scattersample, &wi, &pdf, BSDF_ALL, &sampled);
+			if (f == Color::BLACK || pdf == 0.f)
+				continue;
+			p.specular[path] = (sampled & BSDF_SPECULAR) != 0;
+			f *= Math::AbsDot(wi, geom.normal) / pdf;
+			p.scatter_r[path] = f.r;
+			p.scatter_g[path] = f.g;
+			p.scatter_b[path] = f.b;
+			p.scattered.push_back(path);
+			// the hit point is still needed by the queued rays, the new ray only replaces the old one
+			p.rays[path] = Ray(geom.point, wi);
+		}
+	}
+
+	template<typename T>
+	void WavefrontPathTracing::QueueDirect(const Scene *scene, uint path, const Ray& ray, const LocalGeo& geom, const T& bsdf, const Sample *lightsample, const Sample *bsdfsample){
+		// same estimate as RayTracer::SampleOneLight, with the visibility tests left to Connect()
+		const Vec3 wo = -ray.dir;
+		const Color throughput = pool_.Throughput(path);
+		float pick_pmf;
+		Sample sample = *lightsample;
+		const Light *light = scene->GetLightBVH().Sample(geom.point, geom.normal, lightsample->w, &pick_pmf, &sample.w);
+		if (!light)
+			return;
+		Ray lightray;
+		float light_pdf, bsdf_pdf;
+		Color lightcolor, surfacecolor;
+
+		// sample the picked light with multiple importance sampling
+		light->SampleDirect(geom.point, &sample, &lightray, &lightcolor, &light_pdf);
+		if (light_pdf > 0.f && lightcolor != Color::BLACK){
+			surfacecolor = bsdf.Eval(lightray.dir, wo, geom, BSDFType(BSDF_ALL & ~BSDF_SPECULAR));
+			if (surfacecolor != Color::BLACK){
+				Color color;
+				if (light->IsDelta())
+					color = surfacecolor * lightcolor * (Math::AbsDot(lightray.dir, geom.normal) / pick_pmf);
+				else{
+					light_pdf *= pick_pmf;
+					bsdf_pdf = bsdf.Pdf(wo, lightray.dir, geom);
+					color = surfacecolor * lightcolor * (Math::AbsDot(lightray.dir, geom.normal) / light_pdf * PowerHeuristic(1, light_pdf, 1, bsdf_pdf));
+				}
+				shadow_.Push(path, lightray, throughput * color);
+			}
+		}
+
+		// sample bsdf with multiple importance sampling
+		Vec3 wi;
+		surfacecolor = bsdf.SampleDirect(wo, geom, *bsdfsample, &wi, &bsdf_pdf, BSDFType(BSDF_ALL & ~BSDF_SPECULAR));
+		if (bsdf_pdf > 0.f && surfacecolor != Color::BLACK){
+			mis_.Push(path, Ray(geom.point, wi), geom.point, geom.normal, bsdf_pdf,
+				throughput * surfacecolor * (Math::AbsDot(wi, geom.normal) / bsdf_pdf));
+		}
+	}
+
+	void WavefrontPathTracing::Connect(const Scene *scene){
+		PathPool& p = pool_;
+
+		// shadow rays
+		const size_t shadowCount = shadow_.rays.size();
+		shadow_.visible.resize(shadowCount);
+		for (size_t i = 0; i < shadowCount; i++)
+			shadow_.visible[i] = !scene->Occlude(shadow_.rays[i]);
+		for (size_t i = 0; i < shadowCount; i++){
+			const float v = shadow_.visible[i];
+			const uint path = shadow_.paths[i];
+			p.radiance_r[path] += v * shadow_.r[i];
+			p.radiance_g[path] += v * shadow_.g[i];
+			p.radiance_b[path] += v * shadow_.b[i];
+		}
+
+		// rays sampled from the BSDFs, they count when they hit an area light
+		const LightBVH& lights = scene->GetLightBVH();
+		LocalGeo geom_light;
+		Color lightcolor;
+		for (size_t i = 0; i < mis_.rays.size(); i++){
+			const Ray& lightray = mis_.rays[i];
+			if (!scene->Intersect(lightray, geom_light) || !geom_light.prim->GetAreaLight())
+				continue;
+			scene->PostIntersect(lightray, geom_light);
+			geom_light.Emit(-lightray.dir, &lightcolor);
+			if (lightcolor != Color::BLACK){
+				float light_pdf = geom_light.prim->Pdf(geom_light.triId, mis_.origins[i], lightray.dir) *
+					lights.Pmf(mis_.origins[i], mis_.normals[i], geom_light.prim->GetAreaLight());
+				Color weight(mis_.r[i], mis_.g[i], mis_.b[i]);
+				p.AddRadiance(mis_.paths[i], weight * lightcolor * PowerHeuristic(1, mis_.bsdf_pdfs[i], 1, light_pdf));
+			}
+		}
+	}
+
+	void WavefrontPathTracing::Update(int bounce){
+		PathPool& p = pool_;
+		for (uint path : p.scattered){
+			p.throughput_r[path] *= p.scatter_r[path];
+			p.throughput_g[path] *= p.scatter_g[path];
+			p.throughput_b[path] *= p.scatter_b[path];
+		}
+
+		// Russian Roulette, the survivors are the live paths of the next bounce
+		p.active.clear();
+		for (uint path : p.scattered){
+			if (bounce > SAMPLE_DEPTH){
+				float probContinue = Math::Min(1.f, p.Throughput(path).Luminance());
+				if (p.rngs[path].Float() > probContinue)
+					continue;
+				p.throughput_r[path] /= probContinue;
+				p.throughput_g[path] /= probContinue;
+				p.throughput_b[path] /= probContinue;
+			}
+			p.active.push_back(path);
+		}
+		// keep the memory accesses of the next bounce in order
+		std::sort(p.active.begin(), p.active.end());
+	}
+
+	void WavefrontPathTracing::PathPool::Resize(uint size){
+		rays.resize(size);
+		hits.resize(size);
+		samples.resize(size);
+		rngs.resize(size);
+		for (auto v : { &throughput_r, &throughput_g, &throughput_b, &radiance_r, &radiance_g, &radiance_b,
+			&background_r, &background_g, &background_b, &scatter_r, &scatter_g, &scatter_b })
+			v->resize(size);
+		specular.resize(size);
+		active.clear();
+	}
+
+	void WavefrontPathTracing::PathPool::Start(uint path, const Ray& ray, const PixelSample& sample, const RandomStream& rng){
+		rays[path] = ray;
+		samples[path] = sample;
+		rngs[path] = rng;
+		throughput_r[path] = throughput_g[path] = throughput_b[path] = 1.f;
+		radiance_r[path] = radiance_g[path] = radiance_b[path] = 0.f;
+		background_r[path] = ray.dir.x * 0.5f + 0.5f;
+		background_g[path] = ray.dir.y * 0.5f + 0.5f;
+		background_b[path] = ray.dir.z * 0.5f + 0.5f;
+		specular[path] = true;
+		active.push_back(path);
+	}
+
+	void WavefrontPathTracing::ShadowQueue::Clear(){
+		rays.clear();
+		paths.clear();
+		r.clear(); g.clear(); b.clear();
+	}
+
+	void WavefrontPathTracing::ShadowQueue::Push(uint path, const Ray& ray, const Color& contribution){
+		rays.push_back(ray);
+		paths.push_back(path);
+		r.push_back(contribution.r);
+		g.push_back(contribution.g);
+		b.push_back(contribution.b);
+	}
+
+	void WavefrontPathTracing::MisQueue::Clear(){
+		rays.clear();
+		paths.clear();
+		origins.clear();
+		normals.clear();
+		bsdf_pdfs.clear();
+		r.clear(); g.clear(); b.clear();
+	}
+
+	void WavefrontPathTracing::MisQueue::Push(uint path, const Ray& ray, const Vec3& origin, const Vec3& normal, float bsdfPdf, const Color& weight){
+		rays.push_back(ray);
+		paths.push_back(path);
+		origins.push_back(origin);
+		normals.push_back(normal);
+		bsdf_pdfs.push_back(bsdfPdf);
+		r.push_back(weight.r);
+		g.push_back(weight.g);
+		b.push_back(weight.b);
+	}
+}
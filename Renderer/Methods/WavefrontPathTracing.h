@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include "txbase/math/sample.h"
+#include "Core/RayTracer.h"
+#include "Core/Intersection.h"
+
+namespace TX{
+	/// <summary>
+	/// Path tracer working on a whole batch of paths at once instead of one path at a time.
+	/// Every bounce goes through the same stages over the pool of live paths:
+	/// - extend: intersect all the path rays, add the background of the missed ones
+	/// - shade: paths grouped by kind of BSDF, each run of a kind is shaded by code specialized for it,
+	///   samples the lights &amp; the BSDFs and queues the rays needed for direct lighting
+	/// - connect: trace the queued shadow &amp; MIS rays in bulk and add what gets through
+	/// - update: throughputs &amp; russian roulette as plain loops over arrays
+	/// Gives the same estimate as PathTracing.
+	/// </summary>
+	class WavefrontPathTracing final : public RayTracer {
+		friend class RayTracer;
+	public:
+		/// <param name="sortShading"> Sort the hits by BSDF before shading, off leaves them in path order </param>
+		WavefrontPathTracing(int maxdepth = 6, bool sortShading = true);
+		~WavefrontPathTracing(){}
+
+		using RayTracer::Trace;
+		void Trace(const Scene *scene, RayBatch& batch);
+		bool Batched() const { return true; }
+	protected:
+		/// <summary>
+		/// Single paths (e.g. the preview pass) go through the pool as a batch of one.
+		/// </summary>
+		Color Li(const Scene *scene, const Ray& ray, int depth, PixelSample& sample);
+	private:
+		/// <summary>
+		/// State of the paths, one entry per path of the batch. The shading state is stored
+		/// as structure of arrays, rays &amp; hits stay whole since the scene works on those.
+		/// </summary>
+		struct PathPool {
+			std::vector<Ray> rays;
+			std::vector<LocalGeo> hits;
+			std::vector<PixelSample> samples;		// dimensions are taken in the same order as PathTracing
+			std::vector<RandomStream> rngs;
+			std::vector<float> throughput_r, throughput_g, throughput_b;
+			std::vector<float> radiance_r, radiance_g, radiance_b;
+			std::vector<float> background_r, background_g, background_b;	// seen when a specular chain escapes
+			std::vector<float> scatter_r, scatter_g, scatter_b;		// f * |cos| / pdf of the sampled direction
+			std::vector<char> specular;		// the last bounce was specular, emission is not counted by direct lighting
+			std::vector<uint> active;		// live paths
+			std::vector<uint> hit;			// live paths that hit something this bounce
+			std::vector<uint> scattered;	// paths of hit that sampled a new direction
+
+			void Resize(uint size);
+			void Start(uint path, const Ray& ray, const PixelSample& sample, const RandomStream& rng);
+			inline Color Radiance(uint path) const { return Color(radiance_r[path], radiance_g[path], radiance_b[path]); }
+			inline void AddRadiance(uint path, const Color& c) {
+				radiance_r[path] += c.r;
+				radiance_g[path] += c.g;
+				radiance_b[path] += c.b;
+			}
+			inline Color Throughput(uint path) const { return Color(throughput_r[path], throughput_g[path], throughput_b[path]); }
+		};
+
+		/// <summary>
+		/// Light sample waiting for its shadow ray, the contribution already includes the throughput.
+		/// </summary>
+		struct ShadowQueue {
+			std::vector<Ray> rays;
+			std::vector<uint> paths;
+			std::vector<float> r, g, b;
+			std::vector<char> visible;
+			void Clear();
+			void Push(uint path, const Ray& ray, const Color& contribution);
+		};
+
+		/// <summary>
+		/// BSDF sample of the direct lighting, counts if the ray hits an area light.
+		/// The shading point is kept for the pdf of picking that light.
+		/// </summary>
+		struct MisQueue {
+			std::vector<Ray> rays;
+			std::vector<uint> paths;
+			std::vector<Vec3> origins;
+			std::vector<Vec3> normals;
+			std::vector<float> bsdf_pdfs;
+			std::vector<float> r, g, b;
+			void Clear();
+			void Push(uint path, const Ray& ray, const Vec3& origin, const Vec3& normal, float bsdfPdf, const Color& weight);
+		};
+
+		/// <summary>
+		/// Traces the paths of the pool, stops between bounces once canceled.
+		/// </summary>
+		void TracePool(const Scene *scene, const CancelToken& cancel = CancelToken());
+		void Extend(const Scene *scene);
+		void Shade(const Scene *scene);
+		/// <summary>
+		/// Shades the hits [begin, end), whose BSDFs are all of class T.
+		/// </summary>
+		template<typename T>
+		void ShadeRun(const Scene *scene, const uint *begin, const uint *end);
+		template<typename T>
+		void QueueDirect(const Scene *scene, uint path, const Ray& ray, const LocalGeo& geom, const T& bsdf, const Sample *lightsample, const Sample *bsdfsample);
+		void Connect(const Scene *scene);
+		void Update(int bounce);
+	private:
+		static const int SAMPLE_DEPTH;
+		const bool sort_shading_;
+
+		PathPool pool_;
+		ShadowQueue shadow_;
+		MisQueue mis_;
+	};
+}
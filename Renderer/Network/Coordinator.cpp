@@ -0,0 +1,179 @@
+#include "stdafx.h"
+
+#include "txbase/image/film.h"
+
+#include "Coordinator.h"
+
+namespace TX {
+	namespace Net {
+		Coordinator::Coordinator(const RendererConfig& config, Film& film, IProgressMonitor *monitor, int unitSize, int passesPerUnit)
+			: config_(config), film_(film), monitor_(monitor), remaining_(0), stopped_(false), port_(0) {
+			assert(unitSize > 0 && passesPerUnit > 0);
+			max_result_ = sizeof(ResultMessage) + sizeof(Accumulator::Pixel) * unitSize * unitSize;
+			film_.Resize(config_.width, config_.height);
+			film_.Clear();
+			accum_.Resize(config_.width, config_.height);
+
+			// all the regions get their first passes before any of them is refined further
+			RenderRegion frame = config_.crop.Clip(config_.width, config_.height);
+			uint id = 0;
+			for (int pass = 0; pass < config_.samples_per_pixel; pass += passesPerUnit) {
+				for (int y = frame.ymin; y < frame.ymax; y += unitSize) {
+					for (int x = frame.xmin; x < frame.xmax; x += unitSize) {
+						UnitMessage unit;
+						unit.id = id++;
+						unit.xmin = x;
+						unit.ymin = y;
+						unit.xmax = Math::Min(x + unitSize, frame.xmax);
+						unit.ymax = Math::Min(y + unitSize, frame.ymax);
+						unit.pass_begin = pass;
+						unit.pass_end = Math::Min(pass + passesPerUnit, config_.samples_per_pixel);
+						queue_.push_back(unit);
+					}
+				}
+			}
+			remaining_ = int(queue_.size());
+			if (monitor_) monitor_->Reset(float(remaining_));
+		}
+
+		Coordinator::~Coordinator() {
+			Stop();
+			for (auto& t : connections_)
+				if (t.joinable()) t.join();
+		}
+
+		bool Coordinator::Run(uint16_t port, int timeout) {
+			listener_ = Socket::Listen(port);
+			if (!listener_.Valid())
+				return false;
+			{
+				// read by Stop() & the last Merge() to unblock Accept()
+				std::lock_guard<std::mutex> lock(lock_);
+				port_ = port;
+			}
+			while (true) {
+				{
+					std::lock_guard<std::mutex> lock(lock_);
+					if (stopped_ || remaining_ == 0) break;
+				}
+				Socket connection = listener_.Accept();
+				{
+					std::lock_guard<std::mutex> lock(lock_);
+					if (stopped_ || remaining_ == 0) break;
+				}
+				if (!connection.Valid()) break;
+				connections_.push_back(std::thread(&Coordinator::Serve, this, std::move(connection), timeout));
+			}
+			listener_.Close();
+			for (auto& t : connections_)
+				t.join();
+			connections_.clear();
+
+			std::lock_guard<std::mutex> lock(lock_);
+			if (monitor_ && remaining_ == 0) monitor_->Finish();
+			return remaining_ == 0;
+		}
+
+		void Coordinator::Stop() {
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				stopped_ = true;
+			}
+			changed_.notify_all();
+			WakeListener();
+		}
+
+		void Coordinator::WakeListener() {
+			uint16_t port;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				port = port_;
+			}
+			if (port != 0)
+				Socket::Connect("127.0.0.1", port);
+		}
+
+		void Coordinator::Serve(Socket connection, int timeout) {
+			MessageHeader header;
+			std::vector<char> payload;
+			// a peer that never says hello must not keep Run() from returning either
+			connection.SetTimeout(timeout);
+			if (!Receive(connection, header, payload) || header.type != MessageType::Hello || payload.size() != sizeof(HelloMessage) ||
+				reinterpret_cast<const HelloMessage *>(payload.data())->version != PROTOCOL_VERSION)
+				return;
+
+			FrameMessage frame;
+			frame.width = config_.width;
+			frame.height = config_.height;
+			frame.tracer = int32_t(config_.tracer_t);
+			frame.maxdepth = config_.tracer_maxdepth;
+			frame.sampler = int32_t(config_.sampler_t);
+			frame.ris_candidates = config_.ris_candidates;
+			frame.ris_neighbors = config_.ris_neighbors;
+			frame.seed = config_.seed;
+			if (!Send(connection, MessageType::Frame, &frame, sizeof(frame)))
+				return;
+
+			UnitMessage unit;
+			while (NextUnit(unit)) {
+				bool received = Send(connection, MessageType::Unit, &unit, sizeof(unit)) &&
+					Receive(connection, header, payload, max_result_) && header.type == MessageType::Result;
+				const ResultMessage *result = reinterpret_cast<const ResultMessage *>(payload.data());
+				int width = unit.xmax - unit.xmin, height = unit.ymax - unit.ymin;
+				if (!received || payload.size() != sizeof(ResultMessage) + sizeof(Accumulator::Pixel) * width * height ||
+					result->id != unit.id || result->width != width || result->height != height) {
+					// the worker is gone or misbehaving, someone else has to render the unit
+					Requeue(unit);
+					return;
+				}
+				Merge(unit, reinterpret_cast<const Accumulator::Pixel *>(payload.data() + sizeof(ResultMessage)));
+			}
+			Send(connection, MessageType::Done, nullptr, 0);
+		}
+
+		bool Coordinator::NextUnit(UnitMessage& unit) {
+			std::unique_lock<std::mutex> lock(lock_);
+			// units in flight may still come back to the queue
+			changed_.wait(lock, [this] { return stopped_ || remaining_ == 0 || !queue_.empty(); });
+			if (stopped_ || remaining_ == 0)
+				return false;
+			unit = queue_.front();
+			queue_.pop_front();
+			return true;
+		}
+
+		void Coordinator::Requeue(const UnitMessage& unit) {
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				queue_.push_front(unit);
+			}
+			changed_.notify_one();
+		}
+
+		void Coordinator::Merge(const UnitMessage& unit, const Accumulator::Pixel *pixels) {
+			bool done;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				int width = unit.xmax - unit.xmin;
+				Accumulator::Pixel *dst = accum_.Pixels();
+				for (int y = unit.ymin; y < unit.ymax; y++) {
+					for (int x = unit.xmin; x < unit.xmax; x++) {
+						const Accumulator::Pixel& src = pixels[(y - unit.ymin) * width + x - unit.xmin];
+						Accumulator::Pixel& p = dst[y * accum_.Width() + x];
+						p.r += src.r;
+						p.g += src.g;
+						p.b += src.b;
+						p.w += src.w;
+					}
+				}
+				accum_.Resolve(film_.Pixels(), unit.ymin, unit.ymax);
+				done = --remaining_ == 0;
+			}
+			if (monitor_) monitor_->UpdateInc();
+			if (done) {
+				changed_.notify_all();
+				WakeListener();
+			}
+		}
+	}
+}
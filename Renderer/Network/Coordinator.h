@@ -0,0 +1,76 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "Core/RendererConfig.h"
+#include "Core/Accumulator.h"
+#include "Protocol.h"
+
+namespace TX {
+	class Film;
+
+	namespace Net {
+		/// <summary>
+		/// Splits a frame into work units of (region, sample passes) and hands them out to remote workers.
+		/// Units of a worker that disconnects or times out are handed out again,
+		/// the results are merged into the film as they come in.
+		/// </summary>
+		class Coordinator {
+		public:
+			/// <param name="unitSize"> Size of the square region of a work unit in pixels </param>
+			/// <param name="passesPerUnit"> Number of sample passes of a work unit </param>
+			Coordinator(const RendererConfig& config, Film& film, IProgressMonitor *monitor = nullptr,
+				int unitSize = 128, int passesPerUnit = 16);
+			~Coordinator();
+
+			/// <summary>
+			/// Seconds a worker is given by default to answer, generous enough for a unit of the default size.
+			/// </summary>
+			static const int DEFAULT_TIMEOUT = 300;
+
+			/// <summary>
+			/// Serves the workers connecting to the port until the frame is done.
+			/// </summary>
+			/// <param name="timeout"> Seconds a worker is given to return a unit before it is considered lost and its unit
+			/// handed out again, 0 to wait forever: a worker that hangs then stalls the frame </param>
+			/// <returns> False if the port can't be opened or the coordinator has been stopped </returns>
+			bool Run(uint16_t port, int timeout = DEFAULT_TIMEOUT);
+			/// <summary>
+			/// Cancels Run(), can be called from any thread.
+			/// </summary>
+			void Stop();
+
+			inline const Accumulator& Accumulation() const { return accum_; }
+		private:
+			void Serve(Socket connection, int timeout);
+			/// <summary>
+			/// Waits for a unit to render.
+			/// </summary>
+			/// <returns> False once the frame is done or the coordinator has been stopped </returns>
+			bool NextUnit(UnitMessage& unit);
+			void Requeue(const UnitMessage& unit);
+			void Merge(const UnitMessage& unit, const Accumulator::Pixel *pixels);
+			/// <summary>
+			/// Unblocks the listener with a dummy connection, closing it from another thread isn't portable.
+			/// </summary>
+			void WakeListener();
+		private:
+			RendererConfig config_;
+			Film& film_;
+			IProgressMonitor *monitor_;
+			Accumulator accum_;
+			size_t max_result_;			// payload of the result of a full unit
+
+			std::mutex lock_;
+			std::condition_variable changed_;
+			std::deque<UnitMessage> queue_;
+			int remaining_;				// number of units not merged yet
+			bool stopped_;
+			Socket listener_;
+			uint16_t port_;				// 0 until listening
+			std::vector<std::thread> connections_;
+		};
+	}
+}
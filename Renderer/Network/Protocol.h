@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Socket.h"
+
+namespace TX {
+	namespace Net {
+		/// <summary>
+		/// Messages between a coordinator and its render workers. Structs are sent as is,
+		/// so all the processes are expected to run on hosts of the same endianness.
+		///
+		/// worker                      coordinator
+		///   Hello       -------&gt;
+		///               &lt;-------      Frame
+		///               &lt;-------      Unit         \
+		///   Result      -------&gt;                   } until the frame is done
+		///               &lt;-------      Done
+		/// </summary>
+		enum class MessageType : uint32_t {
+			Hello,
+			Frame,
+			Unit,
+			Result,
+			Done
+		};
+
+		const uint32_t PROTOCOL_VERSION = 2;
+		/// <summary>
+		/// Bound on the payload of the messages without trailing data, the structs below are all smaller.
+		/// </summary>
+		const size_t MAX_MESSAGE_SIZE = 256;
+
+		struct MessageHeader {
+			MessageType type;
+			uint32_t size;			// bytes of payload following the header
+		};
+
+		struct HelloMessage {
+			uint32_t version;
+		};
+
+		/// <summary>
+		/// Settings of the frame that affect the samples, everything else is left to the worker.
+		/// </summary>
+		struct FrameMessage {
+			int32_t width, height;
+			int32_t tracer;
+			int32_t maxdepth;
+			int32_t sampler;
+			int32_t ris_candidates, ris_neighbors;		// ResampledDirectLighting
+			uint64_t seed;
+		};
+
+		/// <summary>
+		/// Sample passes [pass_begin, pass_end) of the pixels inside the region.
+		/// </summary>
+		struct UnitMessage {
+			uint32_t id;
+			int32_t xmin, ymin, xmax, ymax;
+			int32_t pass_begin, pass_end;
+		};
+
+		/// <summary>
+		/// Followed by the raw accumulated sums of the region, row by row.
+		/// </summary>
+		struct ResultMessage {
+			uint32_t id;
+			int32_t width, height;
+		};
+
+		inline bool Send(Socket& socket, MessageType type, const void *payload, size_t size, const void *data = nullptr, size_t dataSize = 0) {
+			MessageHeader header = { type, uint32_t(size + dataSize) };
+			return socket.SendAll(&header, sizeof(header)) &&
+				(size == 0 || socket.SendAll(payload, size)) &&
+				(dataSize == 0 || socket.SendAll(data, dataSize));
+		}
+
+		/// <param name="maxSize"> Largest payload expected, a peer announcing more is dropped before anything is allocated </param>
+		inline bool Receive(Socket& socket, MessageHeader& header, std::vector<char>& payload, size_t maxSize = MAX_MESSAGE_SIZE) {
+			if (!socket.RecvAll(&header, sizeof(header)) || header.size > maxSize)
+				return false;
+			payload.resize(header.size);
+			return header.size == 0 || socket.RecvAll(payload.data(), header.size);
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#include "stdafx.h"
+
+#include "txbase/image/film.h"
+#include "txbase/scene/camera.h"
+
+#include "RemoteWorker.h"
+#include "Protocol.h"
+#include "Core/Renderer.h"
+
+namespace TX {
+	namespace Net {
+		RemoteWorker::RemoteWorker(const RendererConfig& config, const Scene& scene, Camera& camera)
+			: config_(config), scene_(scene), camera_(camera) {
+			// units are rendered into a film of their own size
+			config_.crop_film = true;
+			config_.preview_scale = 1;
+			config_.resume = false;
+			config_.checkpoint_path.clear();
+			config_.priority_regions.clear();
+			film_ = std::make_unique<Film>(FilterType::GaussianFilter);
+		}
+		RemoteWorker::~RemoteWorker() {}
+
+		bool RemoteWorker::Run(const std::string& host, uint16_t port) {
+			Socket connection = Socket::Connect(host, port);
+			if (!connection.Valid())
+				return false;
+			HelloMessage hello = { PROTOCOL_VERSION };
+			MessageHeader header;
+			std::vector<char> payload;
+			if (!Send(connection, MessageType::Hello, &hello, sizeof(hello)) ||
+				!Receive(connection, header, payload) || header.type != MessageType::Frame || payload.size() != sizeof(FrameMessage))
+				return false;
+
+			const FrameMessage frame = *reinterpret_cast<const FrameMessage *>(payload.data());
+			config_.width = frame.width;
+			config_.height = frame.height;
+			config_.tracer_t = static_cast<RenderMethod>(frame.tracer);
+			config_.tracer_maxdepth = frame.maxdepth;
+			config_.sampler_t = static_cast<SamplerType>(frame.sampler);
+			config_.ris_candidates = frame.ris_candidates;
+			config_.ris_neighbors = frame.ris_neighbors;
+			config_.seed = frame.seed;
+			if (!renderer_)
+				renderer_ = std::make_unique<Renderer>(config_, scene_, camera_, *film_);
+			renderer_->Resize(frame.width, frame.height);
+
+			while (Receive(connection, header, payload)) {
+				if (header.type == MessageType::Done)
+					return true;
+				if (header.type != MessageType::Unit || payload.size() != sizeof(UnitMessage))
+					return false;
+				const UnitMessage unit = *reinterpret_cast<const UnitMessage *>(payload.data());
+				config_.crop = RenderRegion(unit.xmin, unit.ymin, unit.xmax, unit.ymax);
+				config_.first_pass = unit.pass_begin;
+				config_.samples_per_pixel = unit.pass_end;
+				renderer_->NewTask();
+				renderer_->Wait();
+
+				const Accumulator& accum = renderer_->Accumulation();
+				ResultMessage result = { unit.id, accum.Width(), accum.Height() };
+				if (!Send(connection, MessageType::Result, &result, sizeof(result),
+					accum.Pixels(), sizeof(Accumulator::Pixel) * accum.Width() * accum.Height()))
+					return false;
+			}
+			return false;
+		}
+	}
+}
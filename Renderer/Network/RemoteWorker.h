@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "Core/RendererConfig.h"
+
+namespace TX {
+	class Scene;
+	class Camera;
+	class Film;
+	class Renderer;
+
+	namespace Net {
+		/// <summary>
+		/// Renders the work units of a coordinator with all the cores of this machine.
+		/// The scene has to be the same one the coordinator's frame was set up with.
+		/// </summary>
+		class RemoteWorker {
+		public:
+			/// <param name="config"> Local settings such as the tile size, the frame settings come from the coordinator </param>
+			RemoteWorker(const RendererConfig& config, const Scene& scene, Camera& camera);
+			~RemoteWorker();
+
+			/// <summary>
+			/// Connects to the coordinator and renders units until the frame is done.
+			/// </summary>
+			/// <returns> False if the connection failed or was lost before the end of the frame </returns>
+			bool Run(const std::string& host, uint16_t port);
+		private:
+			RendererConfig config_;
+			const Scene& scene_;
+			Camera& camera_;
+			std::unique_ptr<Film> film_;
+			std::unique_ptr<Renderer> renderer_;
+		};
+	}
+}
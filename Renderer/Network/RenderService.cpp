@@ -0,0 +1,487 @@
+#include "stdafx.h"
+
+#include "txbase/image/film.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "RenderService.h"
+#include "Core/ImageWriter.h"
+
+namespace TX {
+	namespace Net {
+		namespace {
+			const size_t MAX_REQUEST_SIZE = 8192;
+			const int MAX_TILE_SIZE = 1024;
+			const size_t MAX_EVENTS = 4096;		// per job, older tile events are dropped for slow readers
+			const char *BOUNDARY = "frame";
+
+			struct Request {
+				std::string method;
+				std::string path;
+				std::map<std::string, std::string> params;
+			};
+
+			std::string UrlDecode(const std::string& s) {
+				std::string out;
+				for (size_t i = 0; i < s.size(); i++) {
+					if (s[i] == '+') out += ' ';
+					else if (s[i] == '%' && i + 2 < s.size()) {
+						out += char(std::strtol(s.substr(i + 1, 2).c_str(), nullptr, 16));
+						i += 2;
+					}
+					else out += s[i];
+				}
+				return out;
+			}
+
+			/// <summary>
+			/// Reads the request line &amp; headers, the body is ignored.
+			/// </summary>
+			bool ReadRequest(Socket& connection, Request& request) {
+				std::string data;
+				char buf[1024];
+				while (data.find("\r\n\r\n") == std::string::npos) {
+					size_t received = connection.Recv(buf, sizeof(buf));
+					if (received == 0 || data.size() + received > MAX_REQUEST_SIZE) return false;
+					data.append(buf, received);
+				}
+				std::istringstream line(data.substr(0, data.find("\r\n")));
+				std::string target;
+				if (!(line >> request.method >> target)) return false;
+
+				size_t query = target.find('?');
+				request.path = target.substr(0, query);
+				if (query == std::string::npos) return true;
+				std::istringstream params(target.substr(query + 1));
+				std::string param;
+				while (std::getline(params, param, '&')) {
+					size_t eq = param.find('=');
+					if (eq == std::string::npos) request.params[UrlDecode(param)] = "";
+					else request.params[UrlDecode(param.substr(0, eq))] = UrlDecode(param.substr(eq + 1));
+				}
+				return true;
+			}
+
+			void SendResponse(Socket& connection, int status, const char *reason, const char *contentType, const void *body, size_t size) {
+				char header[256];
+				int length = std::snprintf(header, sizeof(header),
+					"HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %d\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n",
+					status, reason, contentType, int(size));
+				if (connection.SendAll(header, length) && size > 0)
+					connection.SendAll(body, size);
+			}
+
+			void SendJson(Socket& connection, const std::string& json, int status = 200, const char *reason = "OK") {
+				SendResponse(connection, status, reason, "application/json", json.data(), json.size());
+			}
+
+			void SendError(Socket& connection, int status, const char *reason) {
+				SendJson(connection, std::string("{\"error\": \"") + reason + "\"}", status, reason);
+			}
+
+			/// <summary>
+			/// Headers of a response streamed until the connection is closed.
+			/// </summary>
+			bool SendStreamHeader(Socket& connection, const std::string& contentType) {
+				std::string header = "HTTP/1.1 200 OK\r\nContent-Type: " + contentType +
+					"\r\nCache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n";
+				return connection.SendAll(header.data(), header.size());
+			}
+
+			bool Param(const std::map<std::string, std::string>& params, const char *name, float& value) {
+				auto it = params.find(name);
+				if (it == params.end()) return false;
+				value = float(std::atof(it->second.c_str()));
+				return true;
+			}
+
+			bool Param(const std::map<std::string, std::string>& params, const char *name, int& value) {
+				auto it = params.find(name);
+				if (it == params.end()) return false;
+				value = std::atoi(it->second.c_str());
+				return true;
+			}
+
+			std::string Format(const char *format, ...) {
+				char buf[512];
+				va_list args;
+				va_start(args, format);
+				std::vsnprintf(buf, sizeof(buf), format, args);
+				va_end(args);
+				return buf;
+			}
+
+			std::string JobStatus(const RenderJob& job, const IProgressMonitor& monitor) {
+				const RendererConfig& config = job.Config();
+				float elapsed = job.ElapsedTime();
+				const char *state = job.Canceled() ? "canceled" : job.Done() ? "done" : "running";
+				return Format("{\"id\": %u, \"state\": \"%s\", \"width\": %d, \"height\": %d, \"spp\": %d, \"priority\": %d, "
+					"\"progress\": %.4f, \"version\": %u, \"elapsed\": %.3f, \"remaining\": %.3f, \"samples\": %llu, \"samples_per_second\": %.0f}",
+					job.Id(), state, config.width, config.height, config.samples_per_pixel, job.Priority(),
+					job.Progress(), job.Version(), elapsed, monitor.InProgress() ? monitor.RemainingTime() : 0.f,
+					(unsigned long long)job.Samples(), elapsed > 0.f ? job.Samples() / elapsed : 0.f);
+			}
+		}
+
+		RenderService::RenderService(RenderQueue& queue, const RendererConfig& defaults, const std::vector<Transform>& views, int retainedJobs)
+			: queue_(queue), defaults_(defaults), views_(views), retained_jobs_(Math::Max(0, retainedJobs)), requests_(0), forgotten_samples_(0), stopped_(false), port_(0) {}
+
+		RenderService::~RenderService() {
+			Stop();
+			for (auto& t : connections_)
+				if (t.second.joinable()) t.second.join();
+			// the jobs render into the films of the entries
+			for (auto& entry : entries_) {
+				queue_.Cancel(entry.second->job);
+				entry.second->job->Wait();
+			}
+		}
+
+		bool RenderService::Run(uint16_t port) {
+			listener_ = Socket::Listen(port, 16, true);
+			if (!listener_.Valid())
+				return false;
+			{
+				// Stop() only wakes the listener once it knows the port
+				std::lock_guard<std::mutex> lock(lock_);
+				port_ = port;
+			}
+			uint64_t next = 0;
+			while (!Stopped()) {
+				Socket connection = listener_.Accept();
+				if (Stopped() || !connection.Valid()) break;
+				// the threads of the connections closed since the last one are done or about to be
+				std::vector<uint64_t> finished;
+				{
+					std::lock_guard<std::mutex> lock(lock_);
+					finished.swap(finished_);
+					Evict();
+				}
+				for (uint64_t id : finished) {
+					connections_[id].join();
+					connections_.erase(id);
+				}
+				uint64_t id = next++;
+				connections_[id] = std::thread(&RenderService::Connect, this, id, std::move(connection));
+			}
+			listener_.Close();
+			for (auto& t : connections_)
+				t.second.join();
+			connections_.clear();
+			finished_.clear();
+			return true;
+		}
+
+		void RenderService::Stop() {
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				if (stopped_) return;
+				stopped_ = true;
+				// event streams notice right away
+				for (auto& entry : entries_)
+					entry.second->event_added.notify_all();
+			}
+			WakeListener();
+		}
+
+		bool RenderService::Stopped() {
+			std::lock_guard<std::mutex> lock(lock_);
+			return stopped_;
+		}
+
+		void RenderService::WakeListener() {
+			uint16_t port;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				port = port_;
+			}
+			if (port != 0)
+				Socket::Connect("127.0.0.1", port);
+		}
+
+		std::shared_ptr<RenderService::Entry> RenderService::Find(uint id) {
+			std::lock_guard<std::mutex> lock(lock_);
+			auto it = entries_.find(id);
+			return it == entries_.end() ? nullptr : it->second;
+		}
+
+		void RenderService::Connect(uint64_t id, Socket connection) {
+			Serve(std::move(connection));
+			std::lock_guard<std::mutex> lock(lock_);
+			finished_.push_back(id);
+		}
+
+		void RenderService::Evict() {
+			int finished = 0;
+			std::vector<uint> evicted;
+			// newest first, the ids grow with the submissions
+			for (auto it = entries_.rbegin(); it != entries_.rend(); ++it)
+				if (it->second->job->Done() && ++finished > retained_jobs_)
+					evicted.push_back(it->first);
+			for (uint id : evicted) {
+				forgotten_samples_ += entries_[id]->job->Samples();
+				entries_.erase(id);
+			}
+		}
+
+		void RenderService::Serve(Socket connection) {
+			Request request;
+			connection.SetTimeout(10);
+			if (!ReadRequest(connection, request)) return;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				requests_++;
+			}
+
+			// split /jobs/<id>/<resource>
+			std::vector<std::string> parts;
+			std::istringstream path(request.path);
+			std::string part;
+			while (std::getline(path, part, '/'))
+				if (!part.empty()) parts.push_back(part);
+
+			float exposure = 1.f, interval = 0.5f;
+			Param(request.params, "exposure", exposure);
+			Param(request.params, "interval", interval);
+			interval = Math::Clamp(interval, 0.05f, 60.f);
+
+			if (parts.size() == 1 && parts[0] == "render") {
+				if (request.method != "POST") SendError(connection, 405, "Method Not Allowed");
+				else Submit(connection, request.params);
+			}
+			else if (parts.size() == 1 && parts[0] == "metrics") {
+				SendMetrics(connection);
+			}
+			else if (parts.size() == 1 && parts[0] == "jobs") {
+				std::vector<std::shared_ptr<Entry>> entries;
+				{
+					std::lock_guard<std::mutex> lock(lock_);
+					for (auto& entry : entries_) entries.push_back(entry.second);
+				}
+				std::string json = "[";
+				for (size_t i = 0; i < entries.size(); i++)
+					json += (i ? ", " : "") + JobStatus(*entries[i]->job, entries[i]->monitor);
+				SendJson(connection, json + "]");
+			}
+			else if (parts.size() >= 2 && parts.size() <= 3 && parts[0] == "jobs") {
+				uint id = uint(std::strtoul(parts[1].c_str(), nullptr, 10));
+				std::shared_ptr<Entry> entry = Find(id);
+				const std::string resource = parts.size() == 3 ? parts[2] : "";
+				if (!entry) SendError(connection, 404, "Not Found");
+				else if (resource.empty() && request.method == "DELETE") {
+					queue_.Cancel(entry->job);
+					entry->job->Wait();
+					{
+						std::lock_guard<std::mutex> lock(lock_);
+						if (entries_.erase(id))
+							forgotten_samples_ += entry->job->Samples();
+					}
+					entry->event_added.notify_all();
+					SendJson(connection, JobStatus(*entry->job, entry->monitor));
+				}
+				else if (resource.empty()) SendStatus(connection, entry);
+				else if (resource == "image.png") SendImage(connection, entry, exposure);
+				else if (resource == "stream.png") StreamImages(connection, entry, exposure, interval);
+				else if (resource == "events") StreamEvents(connection, entry, interval);
+				else SendError(connection, 404, "Not Found");
+			}
+			else {
+				SendError(connection, 404, "Not Found");
+			}
+		}
+
+		void RenderService::Submit(Socket& connection, const std::map<std::string, std::string>& params) {
+			RendererConfig config = defaults_;
+			int priority = 0, view = 0;
+			Param(params, "width", config.width);
+			Param(params, "height", config.height);
+			Param(params, "spp", config.samples_per_pixel);
+			Param(params, "depth", config.tracer_maxdepth);
+			Param(params, "tile", config.tile_size);
+			Param(params, "priority", priority);
+			Param(params, "view", view);
+			// jobs running at once can't share one segment, so only the request names it
+			config.shared_film.clear();
+			auto shared = params.find("shared");
+			if (shared != params.end()) config.shared_film = shared->second;
+			auto seed = params.find("seed");
+			if (seed != params.end()) config.seed = std::strtoull(seed->second.c_str(), nullptr, 10);
+			auto method = params.find("method");
+			if (method != params.end()) {
+				if (method->second == "path") config.tracer_t = RenderMethod::PathTracing;
+				else if (method->second == "wavefront") config.tracer_t = RenderMethod::WavefrontPathTracing;
+				else if (method->second == "direct") config.tracer_t = RenderMethod::DirectLighting;
+				else if (method->second == "restir") config.tracer_t = RenderMethod::ResampledDirectLighting;
+				else return SendError(connection, 400, "Bad Request");
+			}
+			auto sampler = params.find("sampler");
+			if (sampler != params.end()) {
+				if (sampler->second == "random") config.sampler_t = SamplerType::Random;
+				else if (sampler->second == "sobol") config.sampler_t = SamplerType::Sobol;
+				else if (sampler->second == "halton") config.sampler_t = SamplerType::Halton;
+				else if (sampler->second == "bluenoise") config.sampler_t = SamplerType::BlueNoise;
+				else return SendError(connection, 400, "Bad Request");
+			}
+			// the pixel order of a tile is a table of tile_size^2 entries
+			if (config.width <= 0 || config.height <= 0 || config.width > 16384 || config.height > 16384 ||
+				config.samples_per_pixel <= 0 || config.tracer_maxdepth < 1 || config.tile_size <= 0 || config.tile_size > MAX_TILE_SIZE ||
+				config.tile_size > Math::Max(config.width, config.height) || view < 0 || size_t(view) >= views_.size())
+				return SendError(connection, 400, "Bad Request");
+
+			Transform transform = views_[view];
+			auto camera = params.find("camera");
+			if (camera != params.end()) {
+				float v[6];
+				if (std::sscanf(camera->second.c_str(), "%f,%f,%f,%f,%f,%f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6)
+					return SendError(connection, 400, "Bad Request");
+				transform.SetPosition(Vec3(v[0], v[1], v[2]));
+				transform.SetRotation(Quaternion::Euler(v[3] * Math::PI / 180.f, v[4] * Math::PI / 180.f, v[5] * Math::PI / 180.f));
+			}
+
+			auto entry = std::make_shared<Entry>();
+			entry->film = std::make_unique<Film>(FilterType::GaussianFilter);
+			Entry *events = entry.get();
+			auto onTile = [events](const RenderJob&, const RenderTile& tile, int pass) {
+				std::string event = Format("event: tile\ndata: {\"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d, \"pass\": %d}\n\n",
+					tile.xmin, tile.ymin, tile.xmax - tile.xmin, tile.ymax - tile.ymin, pass);
+				{
+					std::lock_guard<std::mutex> lock(events->event_lock);
+					events->events.push_back(std::move(event));
+					if (events->events.size() > MAX_EVENTS) {
+						events->events.pop_front();
+						events->first_event++;
+					}
+				}
+				events->event_added.notify_all();
+			};
+			{
+				// registered before the first tile can be rendered
+				std::lock_guard<std::mutex> lock(lock_);
+				if (stopped_) return SendError(connection, 503, "Service Unavailable");
+				Evict();
+				entry->job = queue_.Submit(transform, config, *entry->film, priority, &entry->monitor, onTile);
+				entries_[entry->job->Id()] = entry;
+			}
+			SendJson(connection, Format("{\"id\": %u}", entry->job->Id()), 201, "Created");
+		}
+
+		void RenderService::SendStatus(Socket& connection, const std::shared_ptr<Entry>& entry) {
+			SendJson(connection, JobStatus(*entry->job, entry->monitor));
+		}
+
+		void RenderService::SendImage(Socket& connection, const std::shared_ptr<Entry>& entry, float exposure) {
+			std::vector<uint8_t> png;
+			bool encoded;
+			{
+				std::lock_guard<std::mutex> lock(entry->image_lock);
+				entry->job->Resolve();
+				Film& film = *entry->film;
+				encoded = ImageWriter::EncodePNG(png, film.Pixels(), film.Width(), film.Height(), exposure);
+			}
+			if (!encoded) return SendError(connection, 500, "Internal Server Error");
+			SendResponse(connection, 200, "OK", "image/png", png.data(), png.size());
+		}
+
+		void RenderService::StreamImages(Socket& connection, const std::shared_ptr<Entry>& entry, float exposure, float interval) {
+			if (!SendStreamHeader(connection, std::string("multipart/x-mixed-replace; boundary=") + BOUNDARY))
+				return;
+			std::vector<uint8_t> png;
+			uint sent = uint(-1);
+			while (!Stopped()) {
+				// the last image is sent once the job is done
+				bool done = entry->job->Done();
+				uint version = entry->job->Version();
+				if (version != sent) {
+					{
+						std::lock_guard<std::mutex> lock(entry->image_lock);
+						entry->job->Resolve();
+						Film& film = *entry->film;
+						if (!ImageWriter::EncodePNG(png, film.Pixels(), film.Width(), film.Height(), exposure)) return;
+					}
+					std::string header = Format("--%s\r\nContent-Type: image/png\r\nContent-Length: %d\r\n\r\n", BOUNDARY, int(png.size()));
+					if (!connection.SendAll(header.data(), header.size()) ||
+						!connection.SendAll(png.data(), png.size()) ||
+						!connection.SendAll("\r\n", 2))
+						return;
+					sent = version;
+				}
+				if (done) break;
+				std::this_thread::sleep_for(std::chrono::duration<float>(interval));
+			}
+			std::string end = Format("--%s--\r\n", BOUNDARY);
+			connection.SendAll(end.data(), end.size());
+		}
+
+		void RenderService::StreamEvents(Socket& connection, const std::shared_ptr<Entry>& entry, float interval) {
+			if (!SendStreamHeader(connection, "text/event-stream"))
+				return;
+			uint64_t next = 0;
+			uint imageVersion = 0;
+			auto lastImage = std::chrono::steady_clock::now();
+			std::vector<std::string> pending;
+			while (true) {
+				bool done = entry->job->Done();
+				{
+					std::unique_lock<std::mutex> lock(entry->event_lock);
+					if (!done && next >= entry->first_event + entry->events.size())
+						entry->event_added.wait_for(lock, std::chrono::duration<float>(interval));
+					next = Math::Max(next, entry->first_event);
+					for (; next < entry->first_event + entry->events.size(); next++)
+						pending.push_back(entry->events[size_t(next - entry->first_event)]);
+				}
+				auto now = std::chrono::steady_clock::now();
+				uint version = entry->job->Version();
+				// the image is announced at most once per interval, clients fetch image.png
+				if (version != imageVersion && (done || std::chrono::duration<float>(now - lastImage).count() >= interval)) {
+					pending.push_back(Format("event: image\ndata: {\"version\": %u, \"progress\": %.4f}\n\n", version, entry->job->Progress()));
+					imageVersion = version;
+					lastImage = now;
+				}
+				if (done)
+					pending.push_back("event: done\ndata: " + JobStatus(*entry->job, entry->monitor) + "\n\n");
+				for (auto& event : pending)
+					if (!connection.SendAll(event.data(), event.size())) return;
+				pending.clear();
+				if (done || Stopped() || !Find(entry->job->Id())) return;
+			}
+		}
+
+		void RenderService::SendMetrics(Socket& connection) {
+			std::vector<std::shared_ptr<Entry>> entries;
+			uint64_t requests, samples;
+			{
+				std::lock_guard<std::mutex> lock(lock_);
+				for (auto& entry : entries_) entries.push_back(entry.second);
+				requests = requests_;
+				samples = forgotten_samples_;
+			}
+			int running = 0;
+			std::string jobs;
+			for (auto& entry : entries) {
+				const RenderJob& job = *entry->job;
+				float elapsed = job.ElapsedTime();
+				bool done = job.Done();
+				running += !done;
+				samples += job.Samples();
+				jobs += Format("raytracer_job_progress{job=\"%u\"} %.4f\n", job.Id(), job.Progress());
+				jobs += Format("raytracer_job_monitor_progress{job=\"%u\"} %.4f\n", job.Id(), entry->monitor.Progress());
+				jobs += Format("raytracer_job_elapsed_seconds{job=\"%u\"} %.3f\n", job.Id(), elapsed);
+				jobs += Format("raytracer_job_remaining_seconds{job=\"%u\"} %.3f\n", job.Id(), done ? 0.f : entry->monitor.RemainingTime());
+				jobs += Format("raytracer_job_samples_total{job=\"%u\"} %llu\n", job.Id(), (unsigned long long)job.Samples());
+				jobs += Format("raytracer_job_samples_per_second{job=\"%u\"} %.0f\n", job.Id(), elapsed > 0.f ? job.Samples() / elapsed : 0.f);
+			}
+			std::string text =
+				"# TYPE raytracer_requests_total counter\n" + Format("raytracer_requests_total %llu\n", (unsigned long long)requests) +
+				"# TYPE raytracer_threads gauge\n" + Format("raytracer_threads %d\n", queue_.ThreadCount()) +
+				"# TYPE raytracer_jobs gauge\n" + Format("raytracer_jobs{state=\"running\"} %d\n", running) +
+				Format("raytracer_jobs{state=\"finished\"} %d\n", int(entries.size()) - running) +
+				"# HELP raytracer_samples_total Camera samples traced by all the jobs, one primary ray each\n"
+				"# TYPE raytracer_samples_total counter\n" + Format("raytracer_samples_total %llu\n", (unsigned long long)samples) +
+				jobs;
+			SendResponse(connection, 200, "OK", "text/plain; version=0.0.4", text.data(), text.size());
+		}
+	}
+}
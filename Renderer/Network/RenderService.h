@@ -0,0 +1,108 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Core/RendererConfig.h"
+#include "Core/RenderQueue.h"
+#include "Socket.h"
+
+namespace TX {
+	class Film;
+
+	namespace Net {
+		/// <summary>
+		/// Local HTTP front end of a RenderQueue, for dashboards & scripts.
+		/// Only accepts connections from this machine, every response closes its connection.
+		/// Jobs stay until deleted, except finished ones beyond the most recent few, which are forgotten with their films.
+		///
+		///   POST   /render?width=&amp;height=&amp;spp=&amp;depth=&amp;method=path|wavefront|direct|restir&amp;sampler=random|sobol|halton|bluenoise&amp;seed=&amp;tile=&amp;priority=&amp;view=&amp;camera=x,y,z,rx,ry,rz&amp;shared=
+		///                                    queues a job, replies {"id": n}, shared names the shared memory segment the job publishes its passes to
+		///   GET    /jobs                     status of all the jobs
+		///   GET    /jobs/&lt;id&gt;                status of a job: progress, monitor values, samples/s
+		///   DELETE /jobs/&lt;id&gt;                cancels &amp; forgets a job
+		///   GET    /jobs/&lt;id&gt;/image.png      image resolved from the samples so far, ?exposure=
+		///   GET    /jobs/&lt;id&gt;/stream.png     multipart stream of PNG images until the job is done, ?exposure=&amp;interval=
+		///   GET    /jobs/&lt;id&gt;/events         server-sent events: "tile" for every tile, "image" when the image changed, "done"
+		///   GET    /metrics                  counters in the Prometheus text format
+		/// </summary>
+		class RenderService {
+		public:
+			/// <param name="defaults"> Config of the jobs, overridden by the parameters of each request </param>
+			/// <param name="views"> Cameras of the scene, picked by the view parameter </param>
+			/// <param name="retainedJobs"> Finished jobs kept along with their films, older ones are forgotten </param>
+			RenderService(RenderQueue& queue, const RendererConfig& defaults, const std::vector<Transform>& views, int retainedJobs = 8);
+			/// <summary>
+			/// Cancels the jobs still running.
+			/// </summary>
+			~RenderService();
+
+			/// <summary>
+			/// Serves the requests on the port until stopped.
+			/// </summary>
+			/// <returns> False if the port can't be opened </returns>
+			bool Run(uint16_t port);
+			/// <summary>
+			/// Cancels Run(), can be called from any thread.
+			/// </summary>
+			void Stop();
+		private:
+			/// <summary>
+			/// A job along with its film &amp; the events not consumed yet.
+			/// </summary>
+			struct Entry {
+				std::shared_ptr<RenderJob> job;
+				std::unique_ptr<Film> film;
+				ProgressMonitor monitor;
+				std::mutex image_lock;				// held while the film is resolved &amp; encoded
+
+				std::mutex event_lock;
+				std::condition_variable event_added;
+				std::deque<std::string> events;		// most recent tile events
+				uint64_t first_event = 0;			// sequence number of events.front()
+			};
+
+			/// <summary>
+			/// Thread of a connection, marks itself as finished so that Run() can join it.
+			/// </summary>
+			void Connect(uint64_t id, Socket connection);
+			void Serve(Socket connection);
+			void Submit(Socket& connection, const std::map<std::string, std::string>& params);
+			void SendStatus(Socket& connection, const std::shared_ptr<Entry>& entry);
+			void SendImage(Socket& connection, const std::shared_ptr<Entry>& entry, float exposure);
+			void StreamImages(Socket& connection, const std::shared_ptr<Entry>& entry, float exposure, float interval);
+			void StreamEvents(Socket& connection, const std::shared_ptr<Entry>& entry, float interval);
+			void SendMetrics(Socket& connection);
+			std::shared_ptr<Entry> Find(uint id);
+			/// <summary>
+			/// Forgets the oldest finished jobs beyond the retention limit, with the lock held.
+			/// </summary>
+			void Evict();
+			bool Stopped();
+			/// <summary>
+			/// Unblocks the listener with a dummy connection, closing it from another thread isn't portable.
+			/// </summary>
+			void WakeListener();
+		private:
+			RenderQueue& queue_;
+			const RendererConfig defaults_;
+			const std::vector<Transform> views_;
+			const int retained_jobs_;
+
+			std::mutex lock_;
+			std::map<uint, std::shared_ptr<Entry>> entries_;
+			uint64_t requests_;
+			uint64_t forgotten_samples_;						// samples of the jobs no longer listed, keeps the total from going down
+			bool stopped_;
+			Socket listener_;
+			uint16_t port_;				// 0 until listening
+			std::map<uint64_t, std::thread> connections_;		// accessed by the thread of Run() only
+			std::vector<uint64_t> finished_;					// connections whose thread is about to exit
+		};
+	}
+}
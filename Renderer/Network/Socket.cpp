@@ -0,0 +1,170 @@
+// Compiled without the precompiled header: winsock2.h has to come before any windows.h
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+
+#include "Socket.h"
+
+namespace TX {
+	namespace Net {
+		namespace {
+#ifdef _WIN32
+			typedef SOCKET NativeSocket;
+			typedef int IOSize;
+			const NativeSocket INVALID = INVALID_SOCKET;
+			inline void CloseNative(NativeSocket s) { closesocket(s); }
+
+			struct WinsockInit {
+				WinsockInit() { WSADATA data; WSAStartup(MAKEWORD(2, 2), &data); }
+				~WinsockInit() { WSACleanup(); }
+			};
+			inline void InitNetwork() { static WinsockInit init; }
+#else
+			typedef int NativeSocket;
+			typedef size_t IOSize;
+			const NativeSocket INVALID = -1;
+			inline void CloseNative(NativeSocket s) { ::close(s); }
+			inline void InitNetwork() {}
+#endif
+			inline NativeSocket Native(uintptr_t handle) { return static_cast<NativeSocket>(handle); }
+
+			/// <summary>
+			/// Sends whole messages right away, workers wait for every reply.
+			/// </summary>
+			inline void NoDelay(NativeSocket s) {
+				int flag = 1;
+				setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&flag), sizeof(flag));
+			}
+		}
+
+		Socket::Socket() : handle_(0), valid_(false) {}
+		Socket::Socket(uintptr_t handle) : handle_(handle), valid_(true) {}
+		Socket::Socket(Socket&& ot) : handle_(ot.handle_), valid_(ot.valid_) {
+			ot.valid_ = false;
+		}
+		Socket& Socket::operator = (Socket&& ot) {
+			if (this != &ot) {
+				Close();
+				handle_ = ot.handle_;
+				valid_ = ot.valid_;
+				ot.valid_ = false;
+			}
+			return *this;
+		}
+		Socket::~Socket() {
+			Close();
+		}
+
+		Socket Socket::Listen(uint16_t port, int backlog, bool loopback) {
+			InitNetwork();
+			NativeSocket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			if (s == INVALID) return Socket();
+			int reuse = 1;
+			setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+			sockaddr_in addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(loopback ? INADDR_LOOPBACK : INADDR_ANY);
+			addr.sin_port = htons(port);
+			if (bind(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(s, backlog) != 0) {
+				CloseNative(s);
+				return Socket();
+			}
+			return Socket(static_cast<uintptr_t>(s));
+		}
+
+		Socket Socket::Connect(const std::string& host, uint16_t port) {
+			InitNetwork();
+			addrinfo hints, *result = nullptr;
+			std::memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_protocol = IPPROTO_TCP;
+			if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+				return Socket();
+
+			NativeSocket s = INVALID;
+			for (addrinfo *p = result; p; p = p->ai_next) {
+				s = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+				if (s == INVALID) continue;
+				if (connect(s, p->ai_addr, static_cast<int>(p->ai_addrlen)) == 0) break;
+				CloseNative(s);
+				s = INVALID;
+			}
+			freeaddrinfo(result);
+			if (s == INVALID) return Socket();
+			NoDelay(s);
+			return Socket(static_cast<uintptr_t>(s));
+		}
+
+		Socket Socket::Accept() {
+			if (!valid_) return Socket();
+			NativeSocket s = accept(Native(handle_), nullptr, nullptr);
+			if (s == INVALID) return Socket();
+			NoDelay(s);
+			return Socket(static_cast<uintptr_t>(s));
+		}
+
+		bool Socket::SendAll(const void *data, size_t size) {
+			const char *ptr = static_cast<const char *>(data);
+			while (valid_ && size > 0) {
+#ifdef MSG_NOSIGNAL
+				auto sent = send(Native(handle_), ptr, IOSize(size), MSG_NOSIGNAL);
+#else
+				auto sent = send(Native(handle_), ptr, IOSize(size), 0);
+#endif
+				if (sent <= 0) return false;
+				ptr += sent;
+				size -= sent;
+			}
+			return valid_;
+		}
+
+		bool Socket::RecvAll(void *data, size_t size) {
+			char *ptr = static_cast<char *>(data);
+			while (valid_ && size > 0) {
+				auto received = recv(Native(handle_), ptr, IOSize(size), 0);
+				if (received <= 0) return false;
+				ptr += received;
+				size -= received;
+			}
+			return valid_;
+		}
+
+		size_t Socket::Recv(void *data, size_t size) {
+			if (!valid_ || size == 0) return 0;
+			auto received = recv(Native(handle_), static_cast<char *>(data), IOSize(size), 0);
+			return received > 0 ? size_t(received) : 0;
+		}
+
+		void Socket::SetTimeout(int seconds) {
+			if (!valid_) return;
+#ifdef _WIN32
+			DWORD timeout = seconds * 1000;
+#else
+			timeval timeout;
+			timeout.tv_sec = seconds;
+			timeout.tv_usec = 0;
+#endif
+			setsockopt(Native(handle_), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+		}
+
+		void Socket::Close() {
+			if (valid_) {
+				CloseNative(Native(handle_));
+				valid_ = false;
+			}
+		}
+	}
+}
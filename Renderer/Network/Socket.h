@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace TX {
+	namespace Net {
+		/// <summary>
+		/// Blocking TCP socket, Winsock on Windows and BSD sockets elsewhere.
+		/// Owns the underlying handle, closed on destruction.
+		/// </summary>
+		class Socket {
+		public:
+			Socket();
+			Socket(Socket&& ot);
+			Socket& operator = (Socket&& ot);
+			Socket(const Socket&) = delete;
+			Socket& operator = (const Socket&) = delete;
+			~Socket();
+
+			/// <summary>
+			/// Creates a socket accepting connections on all the interfaces, or only from this machine.
+			/// </summary>
+			static Socket Listen(uint16_t port, int backlog = 16, bool loopback = false);
+			static Socket Connect(const std::string& host, uint16_t port);
+
+			/// <summary>
+			/// Waits for the next connection, returns an invalid socket on failure.
+			/// </summary>
+			Socket Accept();
+
+			bool SendAll(const void *data, size_t size);
+			bool RecvAll(void *data, size_t size);
+			/// <summary>
+			/// Receives whatever is available, up to the given size.
+			/// </summary>
+			/// <returns> Number of bytes received, 0 if the connection is closed or failed </returns>
+			size_t Recv(void *data, size_t size);
+			/// <summary>
+			/// Makes receiving fail after the given number of seconds without data, 0 to wait forever.
+			/// </summary>
+			void SetTimeout(int seconds);
+			void Close();
+
+			inline bool Valid() const { return valid_; }
+		private:
+			explicit Socket(uintptr_t handle);
+		private:
+			uintptr_t handle_;
+			bool valid_;
+		};
+	}
+}
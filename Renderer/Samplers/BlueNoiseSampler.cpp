@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include <vector>
+#include "BlueNoiseSampler.h"
+#include "SobolSampler.h"
+#include "txbase/math/sample.h"
+
+namespace TX{
+	namespace {
+		/// <summary>
+		/// Tileable blue noise, every pixel holds its rank in the void &amp; cluster order (Ulichney 1993) scaled to [0, 1).
+		/// </summary>
+		class BlueNoiseTile {
+		public:
+			static const int SIZE = 64;
+			static const int COUNT = SIZE * SIZE;
+
+			BlueNoiseTile(){
+				const float sigma = 1.5f;
+				kernel_.resize(COUNT);
+				for (int y = 0; y < SIZE; y++){
+					for (int x = 0; x < SIZE; x++){
+						float dx = float(Math::Min(x, SIZE - x)), dy = float(Math::Min(y, SIZE - y));
+						kernel_[y * SIZE + x] = Math::Exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+					}
+				}
+
+				// initial binary pattern, a tenth of the pixels at random then moved until evenly spread
+				std::vector<char> initial(COUNT, 0);
+				std::vector<float> energy(COUNT, 0.f);
+				const int initialCount = COUNT / 10;
+				RandomStream rng;
+				for (int placed = 0; placed < initialCount;){
+					int p = Math::Min(int(rng.Float() * COUNT), COUNT - 1);
+					if (initial[p]) continue;
+					initial[p] = 1;
+					Splat(energy, p, 1.f);
+					placed++;
+				}
+				for (int i = 0; i < COUNT; i++){
+					int cluster = Find(initial, energy, 1, true);
+					initial[cluster] = 0;
+					Splat(energy, cluster, -1.f);
+					int voids = Find(initial, energy, 0, false);
+					initial[voids] = 1;
+					Splat(energy, voids, 1.f);
+					if (voids == cluster) break;
+				}
+				std::vector<int> rank(COUNT);
+
+				// ranks below the initial pattern, removing the tightest clusters first
+				std::vector<char> pattern = initial;
+				std::vector<float> patternEnergy = energy;
+				for (int r = initialCount - 1; r >= 0; r--){
+					int cluster = Find(pattern, patternEnergy, 1, true);
+					pattern[cluster] = 0;
+					Splat(patternEnergy, cluster, -1.f);
+					rank[cluster] = r;
+				}
+				// up to half of the pixels, filling the largest voids first
+				pattern = initial;
+				for (int r = initialCount; r < COUNT / 2; r++){
+					int voids = Find(pattern, energy, 0, false);
+					pattern[voids] = 1;
+					Splat(energy, voids, 1.f);
+					rank[voids] = r;
+				}
+				// the rest, the minority pixels are now the empty ones, filling their tightest clusters first
+				std::fill(energy.begin(), energy.end(), 0.f);
+				for (int p = 0; p < COUNT; p++)
+					if (!pattern[p]) Splat(energy, p, 1.f);
+				for (int r = COUNT / 2; r < COUNT; r++){
+					int cluster = Find(pattern, energy, 0, true);
+					pattern[cluster] = 1;
+					Splat(energy, cluster, -1.f);
+					rank[cluster] = r;
+				}
+
+				values_.resize(COUNT);
+				for (int p = 0; p < COUNT; p++)
+					values_[p] = (rank[p] + 0.5f) / COUNT;
+				kernel_.clear();
+				kernel_.shrink_to_fit();
+			}
+
+			inline float operator()(int x, int y) const {
+				return values_[(y & (SIZE - 1)) * SIZE + (x & (SIZE - 1))];
+			}
+		private:
+			/// <summary>
+			/// Adds the gaussian of the pixel p, wrapped around the tile, to the energy.
+			/// </summary>
+			void Splat(std::vector<float>& energy, int p, float sign) const {
+				const int px = p % SIZE, py = p / SIZE;
+				for (int y = 0; y < SIZE; y++){
+					const float *row = &kernel_[((y - py) & (SIZE - 1)) * SIZE];
+					for (int x = 0; x < SIZE; x++)
+						energy[y * SIZE + x] += sign * row[(x - px) & (SIZE - 1)];
+				}
+			}
+			/// <summary>
+			/// Pixel with the given value in the pattern of the highest (tightest cluster) or lowest (largest void) energy.
+			/// </summary>
+			static int Find(const std::vector<char>& pattern, const std::vector<float>& energy, char value, bool highest){
+				int best = -1;
+				for (int p = 0; p < COUNT; p++){
+					if (pattern[p] != value) continue;
+					if (best < 0 || (highest ? energy[p] > energy[best] : energy[p] < energy[best]))
+						best = p;
+				}
+				return best;
+			}
+		private:
+			std::vector<float> kernel_;
+			std::vector<float> values_;
+		};
+
+		const BlueNoiseTile& Tile(){
+			static const BlueNoiseTile tile;
+			return tile;
+		}
+	}
+
+	void BlueNoiseSampler::Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const{
+		const BlueNoiseTile& tile = Tile();
+		const uint64_t seed = RandomStream::Hash(sample.seed);
+		// the same points for every pixel, only the rotation differs
+		SobolSampler::ScrambledPoint(uint32_t(sample.index), RandomStream::Hash(seed ^ RandomStream::Hash(group)), dims, out);
+		for (int d = 0; d < dims; d++){
+			uint64_t offset = RandomStream::Hash(seed + 3 * group + d);
+			float v = out[d] + tile(sample.x + int(offset & 0xffff), sample.y + int((offset >> 16) & 0xffff));
+			out[d] = v < 1.f ? v : v - 1.f;
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Core/Sampler.h"
+
+namespace TX{
+	/// <summary>
+	/// Sampler for previews at a few samples per pixel, the error is spread as blue noise over the pixels
+	/// instead of white noise, which the eye averages away much sooner.
+	/// All the pixels share the same Sobol points, rotated per pixel (Cranley-Patterson) by the value
+	/// of a blue noise tile at the pixel, each dimension reading the tile at another offset.
+	/// The tile is generated once with the void &amp; cluster method.
+	/// </summary>
+	class BlueNoiseSampler final : public Sampler {
+	public:
+		BlueNoiseSampler(){}
+		~BlueNoiseSampler(){}
+
+		void Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const;
+	};
+}
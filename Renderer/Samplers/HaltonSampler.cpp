@@ -0,0 +1,52 @@
+#include "stdafx.h"
+#include <vector>
+#include "HaltonSampler.h"
+#include "txbase/math/sample.h"
+
+namespace TX{
+	namespace {
+		/// <summary>
+		/// The first primes, bases of the dimensions. Dimensions past them reuse the bases with other scramblings.
+		/// </summary>
+		std::vector<uint32_t> FirstPrimes(uint32_t limit){
+			std::vector<char> composite(limit, 0);
+			std::vector<uint32_t> primes;
+			for (uint32_t i = 2; i < limit; i++){
+				if (composite[i]) continue;
+				primes.push_back(i);
+				for (uint32_t j = i * i; j < limit; j += i)
+					composite[j] = 1;
+			}
+			return primes;
+		}
+		const std::vector<uint32_t> PRIMES = FirstPrimes(8192);
+		const float ONE_MINUS_EPSILON = 0.99999994f;
+
+		float ScrambledRadicalInverse(uint32_t base, uint64_t a, uint64_t seed){
+			const double invBase = 1.0 / base;
+			double invBaseM = 1.0;
+			uint64_t reversed = 0;
+			uint64_t node = seed;		// identifies the digits seen so far
+			// as many digits as a float resolves, the zero digits past the index are scrambled too
+			while (invBaseM > 1e-8){
+				uint64_t next = a / base;
+				uint32_t digit = uint32_t(a - next * base);
+				uint32_t shifted = uint32_t((digit + RandomStream::Hash(node) % base) % base);
+				node = RandomStream::Hash(node ^ ((digit + 1) * 0x9e3779b97f4a7c15ULL));
+				reversed = reversed * base + shifted;
+				invBaseM *= invBase;
+				a = next;
+			}
+			return Math::Min(float(reversed * invBaseM), ONE_MINUS_EPSILON);
+		}
+	}
+
+	void HaltonSampler::Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const{
+		const uint32_t first = group == 0 ? 0 : 3 * group - 1;
+		for (int d = 0; d < dims; d++){
+			const uint32_t dim = first + d;
+			const uint32_t base = PRIMES[dim % PRIMES.size()];
+			out[d] = ScrambledRadicalInverse(base, uint64_t(sample.index), RandomStream::Hash(sample.pixel_seed ^ RandomStream::Hash(dim)));
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Core/Sampler.h"
+
+namespace TX{
+	/// <summary>
+	/// Halton points, dimension i is the radical inverse in the i-th prime base, with Owen scrambling
+	/// restricted to a random shift of every digit, seeded by the pixel, the dimension &amp; the digits above it.
+	/// The position in the pixel takes bases 2 &amp; 3, the next groups the next bases three at a time,
+	/// so the first bounces get the best distributed dimensions.
+	/// The sequence index is the sample index of the pixel.
+	/// </summary>
+	class HaltonSampler final : public Sampler {
+	public:
+		HaltonSampler(){}
+		~HaltonSampler(){}
+
+		void Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const;
+	};
+}
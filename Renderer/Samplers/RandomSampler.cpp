@@ -3,13 +3,10 @@
 #include "txbase/math/sample.h"
 
 namespace TX{
-	void RandomSampler::GetSamples(CameraSample *sample){
-		sample->x = rng.Float();
-		sample->y = rng.Float();
-		for (int i = 0; i < sample->bufsize; i++){
-			sample->buffer[i].u = rng.Float();
-			sample->buffer[i].v = rng.Float();
-			sample->buffer[i].w = rng.Float();
-		}
+	void RandomSampler::Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const{
+		// hashes of the coordinates of the dimension, no generator to seed for the few numbers of a group
+		const uint64_t key = RandomStream::Hash(sample.pixel_seed ^ RandomStream::Hash(uint64_t(uint32_t(sample.index)) << 32 | group));
+		for (int d = 0; d < dims; d++)
+			out[d] = (uint32_t(RandomStream::Hash(key + d)) >> 8) * (1.f / 16777216.f);
 	}
 }
@@ -3,13 +3,11 @@
 #include "Core/Sampler.h"
 
 namespace TX{
-	class RandomSampler : public Sampler {
+	class RandomSampler final : public Sampler {
 	public:
 		RandomSampler(){}
 		~RandomSampler(){}
 
-		void GetSamples(CameraSample *sample);
-	private:
-		RNG rng;
+		void Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const;
 	};
 }
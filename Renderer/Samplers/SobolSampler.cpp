@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "SobolSampler.h"
+#include "txbase/math/sample.h"
+
+namespace TX{
+	namespace {
+		/// <summary>
+		/// Direction numbers of the first three dimensions of Sobol (primitive polynomials 1, x + 1, x^2 + x + 1).
+		/// </summary>
+		struct SobolDirections {
+			uint32_t v[3][32];
+			SobolDirections(){
+				for (int k = 0; k < 32; k++)
+					v[0][k] = 1u << (31 - k);
+				v[1][0] = 1u << 31;
+				for (int k = 1; k < 32; k++)
+					v[1][k] = v[1][k - 1] ^ (v[1][k - 1] >> 1);
+				v[2][0] = 1u << 31;
+				v[2][1] = 3u << 30;
+				for (int k = 2; k < 32; k++)
+					v[2][k] = v[2][k - 2] ^ (v[2][k - 2] >> 2) ^ v[2][k - 1];
+			}
+		};
+		const SobolDirections DIRECTIONS;
+
+		inline uint32_t Sobol(uint32_t index, int dim){
+			uint32_t x = 0;
+			for (int bit = 0; index; bit++, index >>= 1)
+				if (index & 1) x ^= DIRECTIONS.v[dim][bit];
+			return x;
+		}
+
+		inline uint32_t ReverseBits(uint32_t x){
+			x = (x << 16) | (x >> 16);
+			x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+			x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+			x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+			x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+			return x;
+		}
+
+		/// <summary>
+		/// Owen scrambling of the bits of x from the most significant one, after Laine &amp; Karras and Burley:
+		/// the hash below only lets every bit depend on the lower ones, hence the reversals.
+		/// </summary>
+		inline uint32_t NestedUniformScramble(uint32_t x, uint32_t seed){
+			x = ReverseBits(x);
+			x += seed;
+			x ^= x * 0x6c50b47cu;
+			x ^= x * 0xb82f1e52u;
+			x ^= x * 0xc7afe638u;
+			x ^= x * 0x8d22f6e6u;
+			return ReverseBits(x);
+		}
+	}
+
+	void SobolSampler::Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const{
+		ScrambledPoint(uint32_t(sample.index), RandomStream::Hash(sample.pixel_seed ^ RandomStream::Hash(group)), dims, out);
+	}
+
+	void SobolSampler::ScrambledPoint(uint32_t index, uint64_t seed, int dims, float *out){
+		// shuffling the index decorrelates the sequences of different seeds while keeping each one stratified
+		index = NestedUniformScramble(index, uint32_t(seed));
+		for (int d = 0; d < dims; d++){
+			uint32_t x = NestedUniformScramble(Sobol(index, d), uint32_t(RandomStream::Hash(seed + d + 1)));
+			out[d] = (x >> 8) * (1.f / 16777216.f);
+		}
+	}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Core/Sampler.h"
+
+namespace TX{
+	/// <summary>
+	/// Sobol points with Owen scrambling (hash-based nested uniform scrambling).
+	/// Every group of dimensions of a PixelSample is its own 3D Sobol sequence, shuffled &amp; scrambled with a seed of the pixel &amp; the group.
+	/// The sequence index is the sample index of the pixel, so every power of two samples of a pixel
+	/// are stratified whichever thread or pass rendered them.
+	/// </summary>
+	class SobolSampler final : public Sampler {
+	public:
+		SobolSampler(){}
+		~SobolSampler(){}
+
+		void Generate(const PixelSample& sample, uint32_t group, int dims, float *out) const;
+
+		/// <summary>
+		/// First dims (up to 3) coordinates of the point of a shuffled &amp; scrambled 3D Sobol sequence.
+		/// </summary>
+		static void ScrambledPoint(uint32_t index, uint64_t seed, int dims, float *out);
+	};
+}
@@ -0,0 +1,252 @@
+#include "stdafx.h"
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "txbase/math/transform.h"
+#include "txbase/scene/camera.h"
+
+#include "Core/BSDF.h"
+#include "Core/Scene.h"
+#include "Core/Primitive.h"
+#include "Core/Light.h"
+#include "Core/SceneMesh.h"
+#include "Core/MeshBlob.h"
+#include "Core/ParallelObjLoader.h"
+#include "Core/TaskSystem.h"
+#include "Accelerators/BVH.h"
+#include "Lights/DirectionalLight.h"
+#include "Lights/PointLight.h"
+
+#include "SceneFile.h"
+
+namespace TX {
+	namespace {
+		/// <summary>
+		/// Tokens of the current line with the position for error messages.
+		/// </summary>
+		class LineReader {
+		public:
+			LineReader(const std::string& path, int line, std::istringstream& tokens)
+				: path_(path), line_(line), tokens_(tokens) {}
+
+			std::runtime_error Error(const std::string& message) const {
+				return std::runtime_error(path_ + ":" + std::to_string(line_) + ": " + message);
+			}
+			bool Next(std::string& token) {
+				return bool(tokens_ >> token);
+			}
+			std::string Word(const char *what) {
+				std::string token;
+				if (!Next(token)) throw Error(std::string("expected ") + what);
+				return token;
+			}
+			float Float() {
+				std::string token = Word("a number");
+				char *end;
+				float v = std::strtof(token.c_str(), &end);
+				if (*end != '\0') throw Error("expected a number instead of '" + token + "'");
+				return v;
+			}
+			Vec3 Vector() {
+				float x = Float(), y = Float(), z = Float();
+				return Vec3(x, y, z);
+			}
+			Color RGB() {
+				float r = Float(), g = Float(), b = Float();
+				return Color(r, g, b);
+			}
+			/// <summary>
+			/// Reads a number if there is one left on the line.
+			/// </summary>
+			bool OptionalFloat(float& v) {
+				auto pos = tokens_.tellg();
+				std::string token;
+				char *end;
+				if (Next(token)) {
+					v = std::strtof(token.c_str(), &end);
+					if (*end == '\0') return true;
+				}
+				tokens_.clear();
+				tokens_.seekg(pos);
+				return false;
+			}
+		private:
+			const std::string& path_;
+			int line_;
+			std::istringstream& tokens_;
+		};
+
+		inline float Radians(float degrees) { return degrees * Math::PI / 180.f; }
+
+		/// <summary>
+		/// Applies a transform keyword, returns false if the keyword is something else.
+		/// </summary>
+		bool ApplyTransform(const std::string& keyword, LineReader& reader, Transform& transform) {
+			if (keyword == "translate") {
+				transform.Translate(reader.Vector());
+			}
+			else if (keyword == "rotate") {
+				float angle = reader.Float();
+				transform.Rotate(Quaternion::AngleAxis(Radians(angle), reader.Vector()));
+			}
+			else if (keyword == "euler") {
+				Vec3 angles = reader.Vector();
+				transform.Rotate(Quaternion::Euler(Radians(angles.x), Radians(angles.y), Radians(angles.z)));
+			}
+			else if (keyword == "scale") {
+				Vec3 s = reader.Vector();
+				transform.Scale(s.x, s.y, s.z);
+			}
+			else {
+				return false;
+			}
+			return true;
+		}
+
+		std::string Directory(const std::string& path) {
+			size_t slash = path.find_last_of("/\\");
+			return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+		}
+	}
+
+	std::shared_ptr<Scene> SceneFile::Load(const std::string& path, Camera& camera, std::vector<Transform> *views) {
+		std::ifstream in(path);
+		if (!in)
+			throw std::runtime_error("cannot open scene " + path);
+		const std::string dir = Directory(path);
+
+		std::shared_ptr<Scene> scene(new Scene(std::make_unique<BVH>()));
+		std::map<std::string, std::shared_ptr<BSDF>> materials;
+		std::map<std::string, std::shared_ptr<SceneMesh>> meshes;
+		std::vector<Transform> cameras;
+		TaskGroup loads;		// mesh files are read while the rest of the scene is parsed
+
+		std::string text;
+		for (int line = 1; std::getline(in, text); line++) {
+			size_t comment = text.find('#');
+			if (comment != std::string::npos) text.resize(comment);
+			std::istringstream tokens(text);
+			LineReader reader(path, line, tokens);
+			std::string statement, keyword;
+			if (!reader.Next(statement)) continue;
+
+			if (statement == "camera") {
+				Transform transform;
+				while (reader.Next(keyword))
+					if (!ApplyTransform(keyword, reader, transform))
+						throw reader.Error("unknown camera setting '" + keyword + "'");
+				cameras.push_back(transform);
+			}
+			else if (statement == "material") {
+				std::string name = reader.Word("a material name");
+				std::string type = reader.Word("a material type");
+				std::shared_ptr<BSDF> bsdf;
+				if (type == "diffuse") {
+					bsdf = std::make_shared<Diffuse>(reader.RGB());
+				}
+				else if (type == "mirror") {
+					float r, g, b;
+					if (reader.OptionalFloat(r)) { g = reader.Float(); b = reader.Float(); bsdf = std::make_shared<Mirror>(Color(r, g, b)); }
+					else bsdf = std::make_shared<Mirror>();
+				}
+				else if (type == "dielectric") {
+					float r, g, b, ior;
+					if (reader.OptionalFloat(r)) {
+						g = reader.Float(); b = reader.Float();
+						if (reader.OptionalFloat(ior)) bsdf = std::make_shared<Dielectric>(Color(r, g, b), ior);
+						else bsdf = std::make_shared<Dielectric>(Color(r, g, b));
+					}
+					else bsdf = std::make_shared<Dielectric>();
+				}
+				else {
+					throw reader.Error("unknown material type '" + type + "'");
+				}
+				materials[name] = bsdf;
+			}
+			else if (statement == "mesh") {
+				std::string name = reader.Word("a mesh name");
+				std::string type = reader.Word("a mesh type");
+				auto mesh = std::make_shared<SceneMesh>();
+				float size;
+				if (type == "file" || type == "obj") {
+					std::string file = dir + reader.Word(type == "file" ? "a mesh file" : "an obj file");
+					std::string where = path + ":" + std::to_string(line) + ": ";
+					loads.Run([=] {
+						try {
+							if (type == "file")
+								MeshBlob::Load(file, *mesh);
+							else
+								ParallelObjLoader::Load(file, *mesh);
+						}
+						catch (const std::exception& ex) { throw std::runtime_error(where + ex.what()); }
+						if (mesh->indices.empty()) throw std::runtime_error(where + "mesh file without faces");
+					});
+				}
+				else if (type == "sphere") {
+					if (reader.OptionalFloat(size)) mesh->LoadSphere(size);
+					else mesh->LoadSphere();
+				}
+				else if (type == "plane") {
+					if (reader.OptionalFloat(size)) mesh->LoadPlane(size);
+					else mesh->LoadPlane();
+				}
+				else {
+					throw reader.Error("unknown mesh type '" + type + "'");
+				}
+				meshes[name] = mesh;
+			}
+			else if (statement == "primitive") {
+				std::string meshName = reader.Word("a mesh name");
+				std::string materialName = reader.Word("a material name");
+				auto mesh = meshes.find(meshName);
+				auto material = materials.find(materialName);
+				if (mesh == meshes.end()) throw reader.Error("unknown mesh '" + meshName + "'");
+				if (material == materials.end()) throw reader.Error("unknown material '" + materialName + "'");
+				loads.Wait();
+
+				std::shared_ptr<Primitive> prim(new Primitive(*mesh->second, material->second));
+				bool emissive = false;
+				Color intensity;
+				while (reader.Next(keyword)) {
+					if (keyword == "light") {
+						emissive = true;
+						intensity = reader.RGB();
+					}
+					else if (!ApplyTransform(keyword, reader, prim->transform)) {
+						throw reader.Error("unknown primitive setting '" + keyword + "'");
+					}
+				}
+				scene->AddPrimitive(prim);
+				if (emissive)
+					scene->AddLight(std::make_shared<AreaLight>(intensity, prim));
+			}
+			else if (statement == "pointlight") {
+				Color intensity = reader.RGB();
+				Vec3 position = reader.Vector();
+				float radius;
+				if (reader.OptionalFloat(radius))
+					scene->AddLight(std::make_shared<PointLight>(intensity, radius, position));
+				else
+					scene->AddLight(std::make_shared<PointLight>(intensity, 10.f, position));
+			}
+			else if (statement == "directionallight") {
+				Color intensity = reader.RGB();
+				scene->AddLight(std::make_shared<DirectionalLight>(intensity, reader.Vector()));
+			}
+			else {
+				throw reader.Error("unknown statement '" + statement + "'");
+			}
+			if (reader.Next(keyword))
+				throw reader.Error("unexpected '" + keyword + "'");
+		}
+
+		loads.Wait();
+		if (!cameras.empty())
+			camera.transform = cameras.front();
+		if (views)
+			*views = cameras;
+		scene->Construct();
+		return scene;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace TX {
+	class Scene;
+	class Camera;
+	class Transform;
+
+	/// <summary>
+	/// Text scene description, one statement per line, '#' starts a comment.
+	/// Angles are in degrees, paths are relative to the scene file.
+	///
+	///   camera [transform...]
+	///   material &lt;name&gt; diffuse &lt;r g b&gt;
+	///   material &lt;name&gt; mirror [r g b]
+	///   material &lt;name&gt; dielectric [r g b [ior]]
+	///   mesh &lt;name&gt; file &lt;path.mesh&gt;        binary mesh blob, see MeshBlob
+	///   mesh &lt;name&gt; obj &lt;path.obj&gt;          all the shapes merged, see ParallelObjLoader
+	///   mesh &lt;name&gt; sphere [radius]
+	///   mesh &lt;name&gt; plane [size]
+	///   primitive &lt;mesh&gt; &lt;material&gt; [transform...] [light &lt;r g b&gt;]
+	///   pointlight &lt;r g b&gt; &lt;x y z&gt; [radius]
+	///   directionallight &lt;r g b&gt; &lt;x y z&gt;
+	///
+	/// Transforms are applied in the order they are written:
+	///   translate &lt;x y z&gt; | rotate &lt;angle&gt; &lt;x y z&gt; | euler &lt;x y z&gt; | scale &lt;x y z&gt;
+	/// </summary>
+	class SceneFile {
+	public:
+		/// <summary>
+		/// Builds the scene, places the camera at the first view of the file.
+		/// Throws a std::runtime_error pointing at the offending line if the file is invalid.
+		/// </summary>
+		/// <param name="views"> Receives the transforms of all the cameras of the file if not null </param>
+		static std::shared_ptr<Scene> Load(const std::string& path, Camera& camera, std::vector<Transform> *views = nullptr);
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace TX {
+	class Scene;
+	class Camera;
+	class Transform;
+
+	/// <summary>
+	/// Built-in scenes, shared by the viewer and the render workers so that every process renders the same thing.
+	/// </summary>
+	namespace Scenes {
+		/// <summary>
+		/// Three teapots in a box lit by an area light, the scene of the sample image.
+		/// The scene is constructed and the camera placed, but not resized.
+		/// </summary>
+		std::shared_ptr<Scene> Teapots(Camera& camera);
+
+		/// <summary>
+		/// Builds a scene by name, or from a scene description if the name is a path ending in ".scene".
+		/// </summary>
+		/// <param name="views"> Receives the cameras of a scene description if not null </param>
+		/// <returns> nullptr if there is no such scene </returns>
+		std::shared_ptr<Scene> Load(const std::string& name, Camera& camera, std::vector<Transform> *views = nullptr);
+	}
+}
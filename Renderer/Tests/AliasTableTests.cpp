@@ -0,0 +1,56 @@
+#include "CppUnitTest.h"
+#include <vector>
+#include "stdafx.h"
+#include "Core/AliasTable.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace TX {
+	TEST_CLASS(AliasTableTests) {
+	public:
+		TEST_METHOD(PmfIsTheNormalizedWeight) {
+			const std::vector<float> weights = { 1.f, 0.f, 3.f, 4.f };
+			AliasTable table(weights);
+			Assert::AreEqual(4u, table.Size());
+			for (uint i = 0; i < table.Size(); i++)
+				Assert::AreEqual(weights[i] / 8.f, table.Pmf(i), 1e-6f);
+		}
+
+		TEST_METHOD(SamplingFollowsTheWeights) {
+			// a regular grid of u hits every bucket equally often, so the counts are exact up to the grid step
+			const std::vector<float> weights = { 1.f, 0.f, 3.f, 4.f, 0.5f, 7.5f };
+			AliasTable table(weights);
+			const int count = 1 << 16;
+			std::vector<int> hits(weights.size(), 0);
+			for (int k = 0; k < count; k++) {
+				float pmf;
+				uint i = table.Sample((k + 0.5f) / count, &pmf);
+				Assert::IsTrue(i < table.Size());
+				Assert::AreEqual(table.Pmf(i), pmf);
+				hits[i]++;
+			}
+			Assert::AreEqual(0, hits[1]);
+			for (uint i = 0; i < table.Size(); i++)
+				Assert::AreEqual(table.Pmf(i), float(hits[i]) / count, 1e-3f);
+		}
+
+		TEST_METHOD(SingleEntry) {
+			AliasTable table(std::vector<float>{ 2.f });
+			float pmf = 0.f;
+			Assert::AreEqual(0u, table.Sample(0.f, &pmf));
+			Assert::AreEqual(1.f, pmf);
+			Assert::AreEqual(0u, table.Sample(0.999999f));
+		}
+
+		TEST_METHOD(RejectsTablesWithoutPositiveWeight) {
+			bool thrown = false;
+			try {
+				AliasTable table(std::vector<float>{ 0.f, 0.f });
+			}
+			catch (const char *) {
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+		}
+	};
+}
@@ -0,0 +1,117 @@
+#include "CppUnitTest.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "stdafx.h"
+#include "Core/Checkpoint.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace TX {
+	TEST_CLASS(CheckpointTests) {
+	public:
+		TEST_METHOD_CLEANUP(RemoveFile) {
+			std::remove(PATH);
+		}
+
+		TEST_METHOD(RoundTrip) {
+			Checkpoint::State state = Describe();
+			Accumulator accum;
+			Fill(state, accum);
+			Checkpoint checkpoint;
+			Assert::IsTrue(checkpoint.Save(PATH, state, accum));
+			checkpoint.Wait();
+
+			// the passes & the seed are what the render continues from, they don't have to be expected
+			Checkpoint::State expected = state;
+			expected.passes = 0;
+			expected.seed = 0;
+			Checkpoint::State loaded;
+			Accumulator restored;
+			Assert::IsTrue(Checkpoint::Load(PATH, expected, loaded, restored));
+			Assert::IsTrue(loaded.Matches(state));
+			Assert::AreEqual(state.passes, loaded.passes);
+			Assert::IsTrue(state.seed == loaded.seed);
+			Assert::AreEqual(state.width, restored.Width());
+			Assert::AreEqual(state.height, restored.Height());
+			const Accumulator::Pixel *a = accum.Pixels(), *b = restored.Pixels();
+			for (int i = 0; i < state.width * state.height; i++) {
+				Assert::AreEqual(a[i].r, b[i].r);
+				Assert::AreEqual(a[i].g, b[i].g);
+				Assert::AreEqual(a[i].b, b[i].b);
+				Assert::AreEqual(a[i].w, b[i].w);
+			}
+		}
+
+		TEST_METHOD(RejectsAnotherRender) {
+			Checkpoint::State state = Describe();
+			Accumulator accum;
+			Fill(state, accum);
+			Checkpoint checkpoint;
+			Assert::IsTrue(checkpoint.Save(PATH, state, accum));
+			checkpoint.Wait();
+
+			Checkpoint::State expected = state;
+			expected.ris_candidates++;
+			AssertRejected(expected);
+			expected = state;
+			expected.width++;
+			AssertRejected(expected);
+		}
+
+		TEST_METHOD(RejectsATruncatedFile) {
+			Checkpoint::State state = Describe();
+			Accumulator accum;
+			Fill(state, accum);
+			Checkpoint checkpoint;
+			Assert::IsTrue(checkpoint.Save(PATH, state, accum));
+			checkpoint.Wait();
+
+			std::vector<char> bytes;
+			{
+				std::ifstream in(PATH, std::ios::binary);
+				bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			}
+			{
+				std::ofstream out(PATH, std::ios::binary | std::ios::trunc);
+				out.write(bytes.data(), bytes.size() - sizeof(Accumulator::Pixel));
+			}
+			AssertRejected(state);
+		}
+	private:
+		static Checkpoint::State Describe() {
+			Checkpoint::State state;
+			state.width = state.frame_width = 13;
+			state.height = state.frame_height = 7;
+			state.passes = 5;
+			state.samples_per_pixel = 16;
+			state.seed = 42;
+			for (int i = 0; i < 16; i++)
+				state.view[i] = (i % 5 == 0) ? 1.f : 0.f;
+			state.max_depth = 5;
+			state.ris_candidates = 32;
+			state.scene = 7;
+			return state;
+		}
+
+		static void Fill(const Checkpoint::State& state, Accumulator& accum) {
+			accum.Resize(state.width, state.height);
+			Accumulator::Pixel *p = accum.Pixels();
+			for (int i = 0; i < state.width * state.height; i++)
+				p[i] = { 0.1f * i, 0.2f * i, 0.3f * i, float(state.passes) };
+		}
+
+		static void AssertRejected(const Checkpoint::State& expected) {
+			Checkpoint::State loaded;
+			Accumulator restored;
+			Assert::IsFalse(Checkpoint::Load(PATH, expected, loaded, restored));
+			// nothing is allocated for a checkpoint that doesn't fit
+			Assert::AreEqual(0, restored.Width());
+			Assert::AreEqual(0, loaded.passes);
+		}
+
+		static const char *const PATH;
+	};
+	const char *const CheckpointTests::PATH = "CheckpointTests.ckpt";
+}
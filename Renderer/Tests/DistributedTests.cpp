@@ -0,0 +1,81 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "stdafx.h"
+#include "txbase/image/film.h"
+#include "txbase/scene/camera.h"
+#include "Core/Renderer.h"
+#include "Network/Coordinator.h"
+#include "Network/RemoteWorker.h"
+#include "Scenes/Scenes.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace TX {
+	TEST_CLASS(DistributedTests) {
+	public:
+		TEST_METHOD(WorkersReproduceASingleProcessRender) {
+			RendererConfig config;
+			config.width = 48;
+			config.height = 32;
+			config.samples_per_pixel = 4;
+			config.tile_size = 16;
+			config.preview_scale = 1;
+			config.seed = 1234;
+
+			Camera camera(config.width, config.height);
+			std::shared_ptr<Scene> scene = Scenes::Teapots(camera);
+			camera.transform.UpdateMatrix();
+
+			// the reference, all the passes of the whole frame in this process
+			Film film(FilterType::GaussianFilter);
+			Renderer renderer(config, *scene, camera, film);
+			renderer.Resize(config.width, config.height);
+			renderer.NewTask();
+			renderer.Wait();
+			const Accumulator& expected = renderer.Accumulation();
+
+			// units smaller than the frame & than the passes, so both workers get several of them
+			Film merged(FilterType::GaussianFilter);
+			Net::Coordinator coordinator(config, merged, nullptr, 16, 2);
+			std::atomic<bool> served(false);
+			bool succeeded = false;
+			std::thread server([&] {
+				succeeded = coordinator.Run(PORT, 30);
+				served = true;
+			});
+			std::vector<std::thread> workers;
+			for (int i = 0; i < 2; i++) {
+				workers.push_back(std::thread([&] {
+					Camera view(camera);
+					Net::RemoteWorker worker(config, *scene, view);
+					// the coordinator may not be listening yet, and is gone once the other worker finished the frame
+					while (!served && !worker.Run("127.0.0.1", PORT))
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				}));
+			}
+			for (auto& w : workers)
+				w.join();
+			server.join();
+			Assert::IsTrue(succeeded);
+
+			// the passes of a pixel are summed in another order, only the rounding differs
+			const Accumulator& actual = coordinator.Accumulation();
+			Assert::AreEqual(expected.Width(), actual.Width());
+			Assert::AreEqual(expected.Height(), actual.Height());
+			const Accumulator::Pixel *a = expected.Pixels(), *b = actual.Pixels();
+			for (int i = 0; i < config.width * config.height; i++) {
+				Assert::AreEqual(a[i].w, b[i].w);
+				Assert::AreEqual(a[i].r, b[i].r, 1e-4f * Math::Max(1.f, std::abs(a[i].r)));
+				Assert::AreEqual(a[i].g, b[i].g, 1e-4f * Math::Max(1.f, std::abs(a[i].g)));
+				Assert::AreEqual(a[i].b, b[i].b, 1e-4f * Math::Max(1.f, std::abs(a[i].b)));
+			}
+		}
+	private:
+		static const uint16_t PORT = 47213;
+	};
+}
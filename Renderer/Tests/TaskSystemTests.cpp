@@ -0,0 +1,55 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <stdexcept>
+#include "Core/TaskSystem.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace TX {
+	TEST_CLASS(TaskSystemTests) {
+	public:
+		TEST_METHOD(ParallelForCoversTheRange) {
+			const size_t count = 100000;
+			std::vector<std::atomic<int>> hits(count);
+			for (auto& h : hits) h = 0;
+			ParallelFor(0, count, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) hits[i]++;
+			}, 64);
+			for (size_t i = 0; i < count; i++)
+				Assert::AreEqual(1, hits[i].load());
+		}
+
+		TEST_METHOD(ParallelForThrowingOnTheCallingThread) {
+			// the calling thread runs the first range last, after queuing all the others
+			const size_t count = 1 << 16, grain = 16;
+			std::atomic<size_t> done(0);
+			bool thrown = false;
+			try {
+				ParallelFor(0, count, [&](size_t begin, size_t end) {
+					if (begin == 0) throw std::runtime_error("first range");
+					done += end - begin;
+				}, grain);
+			}
+			catch (const std::runtime_error&) {
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+			// the queued ranges still ran before the exception left ParallelFor
+			Assert::AreEqual(count - grain, done.load());
+		}
+
+		TEST_METHOD(ParallelForThrowingInATask) {
+			const size_t count = 1 << 16;
+			bool thrown = false;
+			try {
+				ParallelFor(0, count, [&](size_t begin, size_t end) {
+					if (end == count) throw std::runtime_error("last range");
+				}, 16);
+			}
+			catch (const std::runtime_error&) {
+				thrown = true;
+			}
+			Assert::IsTrue(thrown);
+		}
+	};
+}
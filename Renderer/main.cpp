@@ -20,6 +20,9 @@
 #include "Lights/DirectionalLight.h"
 #include "Lights/PointLight.h"
 #include "Samplers/RandomSampler.h"
+#include "Scenes/Scenes.h"
+#include "Network/Coordinator.h"
+#include "Network/RemoteWorker.h"
 
 #include "Application/GUIViewer.h"
 
@@ -35,143 +38,97 @@ using namespace TX::UI;
 #pragma warning(disable: 4305)
 #pragma warning(disable: 4018)
 
-void GUIMainMesh() {
+RendererConfig DefaultConfig() {
+	RendererConfig config;
+	//config.tracer_t = TracerType::DirectLighting;
 #ifndef _DEBUG
-	int width = 800;
-	int height = 600;
-#else
-	int width = 320;
-	int height = 240;
-#endif
-	/////////////////////////////////////
-	// Camera
-	shared_ptr<Camera> camera(new Camera(width, height));
-	camera->transform.Rotate(Quaternion::Euler(Math::PI / 2, 0.f, 0.f));
-	camera->transform.Translate(0, 2, 4);
-
-	/////////////////////////////////////////////
-	// Materials
-	shared_ptr<BSDF> diffuse_blue(new Diffuse(Color(0.29, 0.29, 0.53)));
-	shared_ptr<BSDF> diffuse_red(new Diffuse(Color(0.725, 0.26, 0.24)));
-	shared_ptr<BSDF> diffuse_green(new Diffuse(Color(0.2, 0.7, 0.2)));
-	shared_ptr<BSDF> diffuse_yellow(new Diffuse(Color(0.7, 0.6, 0.3)));
-	shared_ptr<BSDF> diffuse_orange(new Diffuse(Color(0.7, 0.4, 0.1)));
-	shared_ptr<BSDF> diffuse_gray(new Diffuse(Color(0.8)));
-	shared_ptr<BSDF> diffuse_black(new Diffuse(Color::BLACK));
-	shared_ptr<BSDF> diffuse_white(new Diffuse(Color::WHITE));
-	shared_ptr<BSDF> mirror(new Mirror);
-	shared_ptr<BSDF> glass(new Dielectric);
-	shared_ptr<BSDF> glass_blue(new Dielectric(Color(0.2, 0.5, 1.0)));
-	shared_ptr<BSDF> glass_green(new Dielectric(Color(0.7, 1.0, 0.8)));
-	shared_ptr<BSDF> glass_red(new Dielectric(Color(1.0, 0.3, 0.3)));
-	shared_ptr<BSDF> glass_purple(new Dielectric(Color(0.8, 0.6, 1.0)));
-
-	///////////////////////////////////////////
-	// Shapes & Primitives
-	SceneMesh sphere;
-#ifdef _DEBUG
-	sphere.LoadSphere(1.f, 4, 1);
+	config.width = 800;
+	config.height = 600;
+	config.samples_per_pixel = 100;
 #else
-	sphere.LoadSphere();
+	config.width = 320;
+	config.height = 240;
+	config.samples_per_pixel = 4;
 #endif
-	SceneMesh plane; plane.LoadPlane();
-
-	// load teapot
-	std::vector<ObjShape> teapot_shapes;
-	std::vector<ObjMaterial> teapot_mat;
-	ObjLoader::Load(teapot_shapes, teapot_mat, "../ObjViewer/teapot.obj", "./");
-	SceneMesh teapot(teapot_shapes.front().mesh);
-
-	int wall_size = 9;
-	shared_ptr<Primitive> w_bottom(new Primitive(plane, diffuse_white));
-	w_bottom->transform.Scale(wall_size, wall_size, 1);
-
-	shared_ptr<Primitive> w_forward(new Primitive(plane, diffuse_white));
-	w_forward->transform.SetRotation(Quaternion::AngleAxis(Math::PI / 2, Vec3::X));
-	w_forward->transform.Translate(0, 0, -wall_size / 2);
-	w_forward->transform.Scale(wall_size, wall_size, 1);
-
-	shared_ptr<Primitive> w_back(new Primitive(plane, diffuse_white));
-	w_back->transform.SetRotation(Quaternion::AngleAxis(-Math::PI / 2, Vec3::X));
-	w_back->transform.Translate(0, 0, -wall_size / 2);
-	w_back->transform.Scale(wall_size, wall_size, 1);
-
-	shared_ptr<Primitive> w_left(new Primitive(plane, diffuse_blue));
-	w_left->transform.SetRotation(Quaternion::AngleAxis(Math::PI / 2, Vec3::Y));
-	w_left->transform.Translate(0, 0, -wall_size / 2);
-	w_left->transform.Scale(wall_size, wall_size, 1);
-
-	shared_ptr<Primitive> w_right(new Primitive(plane, diffuse_yellow));
-	w_right->transform.SetRotation(Quaternion::AngleAxis(-Math::PI / 2, Vec3::Y));
-	w_right->transform.Translate(0, 0, -wall_size / 2);
-	w_right->transform.Scale(wall_size, wall_size, 1);
-
-	shared_ptr<Primitive> w_top(new Primitive(plane, diffuse_white));
-	w_top->transform.SetRotation(Quaternion::AngleAxis(Math::PI, Vec3::Y));
-	w_top->transform.Translate(0, 0, -wall_size / 2);
-	w_top->transform.Scale(wall_size, wall_size, 1);
-
-	shared_ptr<Primitive> ball1(new Primitive(teapot, diffuse_red));
-	ball1->transform.Translate(-2, 0, 2.5);
-	ball1->transform.SetRotation(Quaternion::AngleAxis(Math::PI / 2, Vec3::X));
-	shared_ptr<Primitive> ball2(new Primitive(teapot, glass));
-	ball2->transform.Translate(2.5, 0, 0);
-	ball2->transform.SetRotation(Quaternion::AngleAxis(Math::PI / 2, Vec3::X));
-	ball2->transform.Rotate(Quaternion::AngleAxis(-Math::PI * 0.9, Vec3::Y));
-	ball2->transform.Scale(1.5, 1.5, 1.5);
-	shared_ptr<Primitive> ball3(new Primitive(teapot, mirror));
-	ball3->transform.Translate(-0.5, 0.5, 0);
-	ball3->transform.SetRotation(Quaternion::AngleAxis(Math::PI / 2, Vec3::X));
-	ball3->transform.Scale(2, 2, 2);
-
-	/////////////////////////////////////
-	// Lights
+	config.tracer_maxdepth = 12;
+	config.scene_name = "teapots";
+	return config;
+}
 
-	//shared_ptr<Light> light_main(new PointLight(Color(3), 200, Vec3(0, 0, wall_size / 2 - 0.6)));
-	shared_ptr<Primitive> lamp(new Primitive(plane, diffuse_black));
-	lamp->transform.SetRotation(Quaternion::AngleAxis(Math::PI, Vec3::Y));
-	lamp->transform.Translate(0, 0, -wall_size / 2 + 0.05);
-	lamp->transform.Scale(2, 2, 1);
-	shared_ptr<Light> light_lamp(new AreaLight(Color(9), lamp));
+/// <param name="sharedFilm"> Name of the shared memory segment external viewers read the film from, empty for none </param>
+void GUIMainMesh(const string& sharedFilm = "", bool sharedRaw = false) {
+	RendererConfig config = DefaultConfig();
+	config.preview_scale = 4;
+	config.sampler_t = SamplerType::BlueNoise;		// the first passes are looked at
+	config.shared_film = sharedFilm;
+	config.shared_film_raw = sharedRaw;
 
 	/////////////////////////////////////
 	// Scene
+	shared_ptr<Camera> camera(new Camera(config.width, config.height));
+	shared_ptr<Scene> scene = Scenes::Teapots(*camera);
 	shared_ptr<Film> film(new Film(FilterType::GaussianFilter));
-	shared_ptr<Scene> scene(new Scene(std::make_unique<BVH>()));
-
-	scene->AddPrimitive(w_bottom);
-	scene->AddPrimitive(w_top);
-	scene->AddPrimitive(w_forward);
-	scene->AddPrimitive(w_back);
-	scene->AddPrimitive(w_left);
-	scene->AddPrimitive(w_right);
-
-	scene->AddPrimitive(ball1);
-	scene->AddPrimitive(ball2);
-	scene->AddPrimitive(ball3);
 
-	//scene->AddLight(light_main);
-	scene->AddPrimitive(lamp); scene->AddLight(light_lamp);
-
-	scene->Construct();
-	RendererConfig config;
-	//config.tracer_t = TracerType::DirectLighting;
-	config.width = width;
-	config.height = height;
-#ifndef _DEBUG
-	config.samples_per_pixel = 100;
-#else
-	config.samples_per_pixel = 4;
-#endif
-	config.tracer_maxdepth = 12;
 	GUIViewer gui(config, *scene, *camera, *film);
 	gui.Run();
 }
 
-int main() {
+/// <summary>
+/// Hands out the frame to the workers and saves the merged samples as a checkpoint,
+/// which the viewer can resume from.
+/// </summary>
+/// <param name="timeout"> Seconds a worker has to return a unit before it is handed out to another one </param>
+void CoordinatorMain(uint16_t port, const string& output, int timeout = Net::Coordinator::DEFAULT_TIMEOUT) {
+	RendererConfig config = DefaultConfig();
+	Film film(FilterType::GaussianFilter);
+	ProgressMonitor monitor;
+	Net::Coordinator coordinator(config, film, &monitor);
+	std::printf("Waiting for workers on port %d\n", port);
+	if (!coordinator.Run(port, timeout))
+		throw "failed to serve the render workers";
+
+	// the viewer only resumes from it with the camera the workers rendered with
+	Camera camera(config.width, config.height);
+	Scenes::Teapots(camera);
+	camera.transform.UpdateMatrix();
+	Checkpoint::State state;
+	state.Describe(config, camera);
+	state.width = config.width;
+	state.height = config.height;
+	state.passes = config.samples_per_pixel;
+	state.seed = config.seed;
+	Checkpoint checkpoint;
+	checkpoint.Save(output, state, coordinator.Accumulation());
+	checkpoint.Wait();
+	std::printf("Saved to %s\n", output.c_str());
+}
+
+void WorkerMain(const string& host, uint16_t port) {
+	RendererConfig config = DefaultConfig();
+	config.tile_size = 16;		// units are small, keep all the cores busy
+	shared_ptr<Camera> camera(new Camera(config.width, config.height));
+	shared_ptr<Scene> scene = Scenes::Teapots(*camera);
+	Net::RemoteWorker worker(config, *scene, *camera);
+	if (!worker.Run(host, port))
+		throw "lost the connection to the coordinator";
+}
+
+int main(int argc, char *argv[]) {
 	bool succeeded = false;
 	try {
-		GUIMainMesh();
+		// Renderer --coordinator <port> [checkpoint] [timeout]
+		// Renderer --worker <host> <port>
+		// Renderer --shared-film <name> [raw]
+		string mode = argc > 1 ? argv[1] : "";
+		if (mode == "--coordinator" && argc > 2)
+			CoordinatorMain(uint16_t(std::atoi(argv[2])), argc > 3 ? argv[3] : "render.ckpt",
+				argc > 4 ? std::atoi(argv[4]) : Net::Coordinator::DEFAULT_TIMEOUT);
+		else if (mode == "--worker" && argc > 3)
+			WorkerMain(argv[2], uint16_t(std::atoi(argv[3])));
+		else if (mode == "--shared-film" && argc > 2)
+			GUIMainMesh(argv[2], argc > 3 && string(argv[3]) == "raw");
+		else
+			GUIMainMesh();
 		succeeded = true;
 	}
 	catch (int ex) {